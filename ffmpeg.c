@@ -129,10 +129,10 @@ static int64_t getmaxrss(void);
 static int ifilter_has_all_input_formats(FilterGraph *fg);
 
 static int run_as_daemon  = 0;
-static int nb_frames_dup = 0;
+static atomic_int nb_frames_dup = ATOMIC_VAR_INIT(0);
 static unsigned dup_warning = 1000;
-static int nb_frames_drop = 0;
-static int64_t decode_error_stat[2];
+static atomic_int nb_frames_drop = ATOMIC_VAR_INIT(0);
+static atomic_int_least64_t decode_error_stat[2];
 
 static int want_sdp = 1;
 
@@ -163,6 +163,10 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_output_thread(OutputStream *ost, int drain);
+static void free_output_threads(int drain);
+static void free_decoder_threads(void);
+static int process_input_packet_mt(InputStream *ist, const AVPacket *pkt, int no_eof);
 #endif
 
 /* sub2video hack:
@@ -472,6 +476,11 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_output_threads(0);
+    free_decoder_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -524,6 +533,9 @@ static void ffmpeg_cleanup(int ret)
             avio_closep(&s->pb);
         avformat_free_context(s);
         av_dict_free(&of->opts);
+#if HAVE_PTHREADS
+        pthread_mutex_destroy(&of->mux_lock);
+#endif
 
         av_freep(&output_files[i]);
     }
@@ -669,6 +681,51 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+static void lock_output_file(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    if (of->nb_enc_threads)
+        pthread_mutex_lock(&of->mux_lock);
+#endif
+}
+
+static void unlock_output_file(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    if (of->nb_enc_threads)
+        pthread_mutex_unlock(&of->mux_lock);
+#endif
+}
+
+#if HAVE_PTHREADS
+enum EncoderThreadStatus {
+    ENC_THREAD_RUNNING,
+    ENC_THREAD_FINISHED,        /* the recording time of the stream is reached */
+    ENC_THREAD_MUX_ERROR,       /* a packet could not be written */
+    ENC_THREAD_ERROR,           /* a fatal error */
+};
+#endif
+
+/**
+ * An encoder thread leaves the state shared with the main thread alone and
+ * does not exit the program. Instead it records why it has to stop, and the
+ * main thread acts on it once the thread has ended.
+ *
+ * @return 1 if called from the encoder thread of ost, 0 otherwise
+ */
+static int stop_encoder_thread(OutputStream *ost, int status)
+{
+#if HAVE_PTHREADS
+    /* ost->enc_thread is set before the thread receives its first frame */
+    if (ost->enc_thread_queue && pthread_equal(ost->enc_thread, pthread_self())) {
+        if (ost->enc_thread_status == ENC_THREAD_RUNNING)
+            ost->enc_thread_status = status;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
 static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
@@ -767,6 +824,10 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
+                    if (stop_encoder_thread(ost, ENC_THREAD_ERROR)) {
+                        av_packet_unref(pkt);
+                        return;
+                    }
                     exit_program(1);
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
@@ -798,8 +859,10 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
-        main_return_code = 1;
-        close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        if (!stop_encoder_thread(ost, ENC_THREAD_MUX_ERROR)) {
+            main_return_code = 1;
+            close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        }
     }
     av_packet_unref(pkt);
 }
@@ -808,10 +871,17 @@ static void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
 
+#if HAVE_PTHREADS
+    /* let the encoder thread catch up, sync_opts must be final */
+    free_output_thread(ost, 1);
+#endif
     ost->finished |= ENCODER_FINISHED;
     if (of->shortest) {
         int64_t end = av_rescale_q(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
+        /* read by the encoder threads of the other streams */
+        lock_output_file(of);
         of->recording_time = FFMIN(of->recording_time, end);
+        unlock_output_file(of);
     }
 }
 
@@ -819,6 +889,8 @@ static void output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
 {
     int ret = 0;
 
+    lock_output_file(of);
+
     /* apply the output bitstream filters, if any */
     if (ost->nb_bitstream_filters) {
         int idx;
@@ -869,10 +941,11 @@ static void output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
         write_packet(of, pkt, ost, 0);
 
 finish:
+    unlock_output_file(of);
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
-        if(exit_on_error)
+        if(exit_on_error && !stop_encoder_thread(ost, ENC_THREAD_ERROR))
             exit_program(1);
     }
 }
@@ -880,11 +953,17 @@ finish:
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
+    int64_t recording_time;
 
-    if (of->recording_time != INT64_MAX &&
-        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, of->recording_time,
+    lock_output_file(of);
+    recording_time = of->recording_time;
+    unlock_output_file(of);
+
+    if (recording_time != INT64_MAX &&
+        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, recording_time,
                       AV_TIME_BASE_Q) >= 0) {
-        close_output_stream(ost);
+        if (!stop_encoder_thread(ost, ENC_THREAD_FINISHED))
+            close_output_stream(ost);
         return 0;
     }
     return 1;
@@ -949,7 +1028,8 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     return;
 error:
     av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
-    exit_program(1);
+    if (!stop_encoder_thread(ost, ENC_THREAD_ERROR))
+        exit_program(1);
 }
 
 static void do_subtitle_out(OutputFile *of,
@@ -1043,24 +1123,22 @@ write_frame()
 static void do_video_out(OutputFile *of,
                          OutputStream *ost,
                          AVFrame *next_picture,
-                         double sync_ipts)
+                         double sync_ipts,
+                         AVRational frame_rate)
 {
     int ret, format_video_sync;
     AVPacket pkt;
     AVCodecContext *enc = ost->enc_ctx;
     AVCodecParameters *mux_par = ost->st->codecpar;
-    AVRational frame_rate;
     int nb_frames, nb0_frames, i;
     double delta, delta0;
     double duration = 0;
     int frame_size = 0;
     InputStream *ist = NULL;
-    AVFilterContext *filter = ost->filter->filter;
 
     if (ost->source_index >= 0)
         ist = input_streams[ost->source_index];
 
-    frame_rate = av_buffersink_get_frame_rate(filter);
     if (frame_rate.num > 0 && frame_rate.den > 0)
         duration = 1/(av_q2d(frame_rate) * av_q2d(enc->time_base));
 
@@ -1163,7 +1241,7 @@ static void do_video_out(OutputFile *of,
     ost->last_nb0_frames[0] = nb0_frames;
 
     if (nb0_frames == 0 && ost->last_dropped) {
-        nb_frames_drop++;
+        atomic_fetch_add(&nb_frames_drop, 1);
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
@@ -1171,12 +1249,12 @@ static void do_video_out(OutputFile *of,
     if (nb_frames > (nb0_frames && ost->last_dropped) + (nb_frames > nb0_frames)) {
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
-            nb_frames_drop++;
+            atomic_fetch_add(&nb_frames_drop, 1);
             return;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        atomic_fetch_add(&nb_frames_dup, nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames));
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
-        if (nb_frames_dup > dup_warning) {
+        if (atomic_load(&nb_frames_dup) > dup_warning) {
             av_log(NULL, AV_LOG_WARNING, "More than %d frames duplicated\n", dup_warning);
             dup_warning *= 10;
         }
@@ -1339,7 +1417,9 @@ static void do_video_out(OutputFile *of,
      * But there may be reordering, so we can't throw away frames on encoder
      * flush, we need to limit them here, before they go into encoder.
      */
+    lock_output_file(of);
     ost->frame_number++;
+    unlock_output_file(of);
 
     if (vstats_filename && frame_size)
         do_video_stats(ost, frame_size);
@@ -1356,7 +1436,8 @@ static void do_video_out(OutputFile *of,
     return;
 error:
     av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
-    exit_program(1);
+    if (!stop_encoder_thread(ost, ENC_THREAD_ERROR))
+        exit_program(1);
 }
 
 static double psnr(double d)
@@ -1375,6 +1456,8 @@ static void do_video_stats(OutputStream *ost, int frame_size)
         vstats_file = fopen(vstats_filename, "w");
         if (!vstats_file) {
             perror("fopen");
+            if (stop_encoder_thread(ost, ENC_THREAD_ERROR))
+                return;
             exit_program(1);
         }
     }
@@ -1409,6 +1492,143 @@ static void do_video_stats(OutputStream *ost, int frame_size)
 
 static int init_output_stream(OutputStream *ost, char *error, int error_len);
 
+/**
+ * Encode a frame coming out of the filtergraph of ost, or flush the video
+ * frame rate conversion if frame is NULL.
+ */
+static void encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame,
+                         double float_pts, AVRational frame_rate)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+
+    switch (enc->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!frame) {
+            do_video_out(of, ost, NULL, AV_NOPTS_VALUE, frame_rate);
+            break;
+        }
+        if (!ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
+                    av_ts2str(frame->pts), av_ts2timestr(frame->pts, &enc->time_base),
+                    float_pts,
+                    enc->time_base.num, enc->time_base.den);
+        }
+
+        do_video_out(of, ost, frame, float_pts, frame_rate);
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!frame)
+            break;
+        if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
+            enc->channels != frame->channels) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+            break;
+        }
+        do_audio_out(of, ost, frame);
+        break;
+    default:
+        // TODO support subtitle filters
+        av_assert0(0);
+    }
+}
+
+#if HAVE_PTHREADS
+typedef struct EncoderThreadMessage {
+    AVFrame *frame;             /* NULL to flush */
+    double float_pts;
+    AVRational frame_rate;      /* of the buffersink, which may be reconfigured meanwhile */
+} EncoderThreadMessage;
+
+static void free_encoder_thread_message(void *msg)
+{
+    av_frame_free(&((EncoderThreadMessage *)msg)->frame);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    EncoderThreadMessage msg;
+
+    /* ost->finished was checked when queueing, it is set by the main
+     * thread at EOF while frames are still queued */
+    while (av_thread_message_queue_recv(ost->enc_thread_queue, &msg, 0) >= 0) {
+        encode_frame(of, ost, msg.frame, msg.float_pts, msg.frame_rate);
+        av_frame_free(&msg.frame);
+        if (ost->enc_thread_status != ENC_THREAD_RUNNING) {
+            /* the main thread handles the status when its next frame is refused */
+            av_thread_message_queue_set_err_send(ost->enc_thread_queue, AVERROR_EOF);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* Do in the main thread what the encoder thread of ost stopped for. */
+static void handle_output_thread_status(OutputStream *ost)
+{
+    switch (ost->enc_thread_status) {
+    case ENC_THREAD_FINISHED:
+        close_output_stream(ost);
+        break;
+    case ENC_THREAD_MUX_ERROR:
+        main_return_code = 1;
+        close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        break;
+    case ENC_THREAD_ERROR:
+        exit_program(1);
+    }
+}
+
+static void free_output_thread(OutputStream *ost, int drain)
+{
+    if (!ost->enc_thread_queue)
+        return;
+    if (!drain)
+        av_thread_message_flush(ost->enc_thread_queue);
+    av_thread_message_queue_set_err_recv(ost->enc_thread_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_thread_queue);
+
+    if (drain)
+        handle_output_thread_status(ost);
+}
+
+static void send_frame_to_encoder_thread(OutputStream *ost, AVFrame *frame,
+                                         double float_pts, AVRational frame_rate)
+{
+    EncoderThreadMessage msg = { NULL, float_pts, frame_rate };
+    int ret;
+
+    if (frame) {
+        msg.frame = av_frame_alloc();
+        if (!msg.frame)
+            exit_program(1);
+        av_frame_move_ref(msg.frame, frame);
+    }
+
+    ret = av_thread_message_queue_send(ost->enc_thread_queue, &msg,
+                                       AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret == AVERROR(EAGAIN)) {
+        if (!ost->enc_thread_blocked++)
+            av_log(NULL, AV_LOG_VERBOSE, "Encoder of output stream %d:%d is "
+                   "lagging behind, the queue of %d frames is full\n",
+                   ost->file_index, ost->index, ost->enc_thread_queue_size);
+        ret = av_thread_message_queue_send(ost->enc_thread_queue, &msg, 0);
+    }
+    if (ret < 0) {
+        /* the encoder thread has stopped */
+        av_frame_free(&msg.frame);
+        free_output_thread(ost, 1);
+    }
+}
+#endif
+
 static void finish_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -1492,8 +1712,14 @@ static int reap_filters(int flush)
                     av_log(NULL, AV_LOG_WARNING,
                            "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
                 } else if (flush && ret == AVERROR_EOF) {
-                    if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
-                        do_video_out(of, ost, NULL, AV_NOPTS_VALUE);
+#if HAVE_PTHREADS
+                    if (ost->enc_thread_queue && of->header_written)
+                        send_frame_to_encoder_thread(ost, NULL, AV_NOPTS_VALUE,
+                                                     av_buffersink_get_frame_rate(filter));
+                    else
+#endif
+                    encode_frame(of, ost, NULL, AV_NOPTS_VALUE,
+                                 av_buffersink_get_frame_rate(filter));
                 }
                 break;
             }
@@ -1522,33 +1748,17 @@ static int reap_filters(int flush)
             //if (ost->source_index >= 0)
             //    *filtered_frame= *input_streams[ost->source_index]->decoded_frame; //for me_threshold
 
-            switch (av_buffersink_get_type(filter)) {
-            case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
-                if (debug_ts) {
-                    av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
-                            av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
-                            float_pts,
-                            enc->time_base.num, enc->time_base.den);
-                }
-
-                do_video_out(of, ost, filtered_frame, float_pts);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
-                    enc->channels != filtered_frame->channels) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
+            /* The encoder thread takes over once the muxer is initialized,
+             * until then the stream setup is left to this thread. */
+#if HAVE_PTHREADS
+            if (ost->enc_thread_queue && of->header_written) {
+                send_frame_to_encoder_thread(ost, filtered_frame, float_pts,
+                                             av_buffersink_get_frame_rate(filter));
+                continue;
             }
+#endif
+            encode_frame(of, ost, filtered_frame, float_pts,
+                         av_buffersink_get_frame_rate(filter));
 
             av_frame_unref(filtered_frame);
         }
@@ -1621,6 +1831,9 @@ static void print_final_stats(int64_t total_size)
                        ist->frames_decoded);
                 if (type == AVMEDIA_TYPE_AUDIO)
                     av_log(NULL, AV_LOG_VERBOSE, " (%"PRIu64" samples)", ist->samples_decoded);
+                if (ist->thread_stalls)
+                    av_log(NULL, AV_LOG_VERBOSE, ", %"PRIu64" reference stalls (%0.3fs)",
+                           ist->thread_stalls, ist->thread_stall_time / 1000000.0);
                 av_log(NULL, AV_LOG_VERBOSE, "; ");
             }
 
@@ -1654,6 +1867,11 @@ static void print_final_stats(int64_t total_size)
                     av_log(NULL, AV_LOG_VERBOSE, " (%"PRIu64" samples)", ost->samples_encoded);
                 av_log(NULL, AV_LOG_VERBOSE, "; ");
             }
+#if HAVE_PTHREADS
+            if (ost->enc_thread_blocked)
+                av_log(NULL, AV_LOG_VERBOSE, "encoder queue full %"PRIu64" times; ",
+                       ost->enc_thread_blocked);
+#endif
 
             av_log(NULL, AV_LOG_VERBOSE, "%"PRIu64" packets muxed (%"PRIu64" bytes); ",
                    ost->packets_written, ost->data_size);
@@ -1683,6 +1901,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int64_t total_size;
     AVCodecContext *enc;
     int frame_number, vid, i;
+    int nb_dup, nb_drop;
     double bitrate;
     double speed;
     int64_t pts = INT64_MIN + 1;
@@ -1710,9 +1929,11 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
+    lock_output_file(output_files[0]);
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
         total_size = avio_tell(oc->pb);
+    unlock_output_file(output_files[0]);
 
     buf[0] = '\0';
     vid = 0;
@@ -1721,6 +1942,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         float q = -1;
         ost = output_streams[i];
         enc = ost->enc_ctx;
+        /* the statistics of the stream are updated by its encoder thread, if any */
+        lock_output_file(output_files[ost->file_index]);
         if (!ost->stream_copy)
             q = ost->quality / (float) FF_QP2LAMBDA;
 
@@ -1787,8 +2010,11 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
                                           ost->st->time_base, AV_TIME_BASE_Q));
         if (is_last_report)
-            nb_frames_drop += ost->last_dropped;
+            atomic_fetch_add(&nb_frames_drop, ost->last_dropped);
+        unlock_output_file(output_files[ost->file_index]);
     }
+    nb_dup  = atomic_load(&nb_frames_dup);
+    nb_drop = atomic_load(&nb_frames_drop);
 
     secs = FFABS(pts) / AV_TIME_BASE;
     us = FFABS(pts) % AV_TIME_BASE;
@@ -1824,11 +2050,11 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprintf(&buf_script, "out_time=%02d:%02d:%02d.%06d\n",
                hours, mins, secs, us);
 
-    if (nb_frames_dup || nb_frames_drop)
+    if (nb_dup || nb_drop)
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " dup=%d drop=%d",
-                nb_frames_dup, nb_frames_drop);
-    av_bprintf(&buf_script, "dup_frames=%d\n", nb_frames_dup);
-    av_bprintf(&buf_script, "drop_frames=%d\n", nb_frames_drop);
+                nb_dup, nb_drop);
+    av_bprintf(&buf_script, "dup_frames=%d\n", nb_dup);
+    av_bprintf(&buf_script, "drop_frames=%d\n", nb_drop);
 
     if (speed < 0) {
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf)," speed=N/A");
@@ -2150,20 +2376,59 @@ int guess_input_channel_layout(InputStream *ist)
     return 1;
 }
 
-static void check_decode_result(InputStream *ist, int *got_output, int ret)
+static int in_decoder_thread(InputStream *ist)
+{
+#if HAVE_PTHREADS
+    /* ist->dec_thread is set before the thread receives its first packet */
+    return ist->dec_thread_queue && pthread_equal(ist->dec_thread, pthread_self());
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Called from the decoder thread of ist on a fatal error, instead of
+ * exit_program(). The thread then stops, and the main thread exits when it
+ * next waits for frames or sends a packet.
+ *
+ * @return 1 if called from the decoder thread of ist, 0 otherwise
+ */
+static int stop_decoder_thread(InputStream *ist)
+{
+#if HAVE_PTHREADS
+    if (in_decoder_thread(ist)) {
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_failed = 1;
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+        av_thread_message_queue_set_err_send(ist->dec_thread_queue, AVERROR_EXIT);
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/* In a decoder thread, errors are returned to process_input_packet(). */
+static int check_decode_result(InputStream *ist, int *got_output, int ret)
 {
     if (*got_output || ret<0)
-        decode_error_stat[ret<0] ++;
+        atomic_fetch_add(&decode_error_stat[ret<0], 1);
 
-    if (ret < 0 && exit_on_error)
+    if (ret < 0 && exit_on_error) {
+        if (ist && in_decoder_thread(ist))
+            return ret;
         exit_program(1);
+    }
 
     if (exit_on_error && *got_output && ist) {
         if (ist->decoded_frame->decode_error_flags || (ist->decoded_frame->flags & AV_FRAME_FLAG_CORRUPT)) {
             av_log(NULL, AV_LOG_FATAL, "%s: corrupt decoded frame in stream %d\n", input_files[ist->file_index]->ctx->filename, ist->st->index);
+            if (in_decoder_thread(ist))
+                return AVERROR_INVALIDDATA;
             exit_program(1);
         }
     }
+    return 0;
 }
 
 // Filters can be configured only if the formats of all inputs are known.
@@ -2310,15 +2575,70 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
     return 0;
 }
 
+#if HAVE_PTHREADS
+enum DecoderThreadEventType {
+    DEC_THREAD_FRAME,           /* a decoded frame for the filters */
+    DEC_THREAD_FILTER_EOF,      /* the filter inputs of the stream are finished */
+    DEC_THREAD_FLUSHED,         /* the decoder has been drained */
+};
+
+typedef struct DecoderThreadEvent {
+    enum DecoderThreadEventType type;
+    AVFrame *frame;
+} DecoderThreadEvent;
+
+/* When the queue of events is full, the decoder thread waits for the main
+ * thread to read them. The main thread in turn never blocks on sending a
+ * packet while there are events to read, see send_decoder_thread_packet(). */
+static int post_decoder_thread_event(InputStream *ist,
+                                     enum DecoderThreadEventType type,
+                                     AVFrame *frame)
+{
+    DecoderThreadEvent ev = { type, NULL };
+    int exiting;
+
+    if (frame) {
+        ev.frame = av_frame_alloc();
+        if (!ev.frame)
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(ev.frame, frame);
+    }
+
+    pthread_mutex_lock(&ist->dec_thread_lock);
+    while (av_fifo_space(ist->dec_thread_frames) < sizeof(ev) &&
+           !ist->dec_thread_exiting)
+        pthread_cond_wait(&ist->dec_thread_cond, &ist->dec_thread_lock);
+    exiting = ist->dec_thread_exiting;
+    if (!exiting) {
+        av_fifo_generic_write(ist->dec_thread_frames, &ev, sizeof(ev), NULL);
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+    }
+    pthread_mutex_unlock(&ist->dec_thread_lock);
+
+    /* on exit, the thread only finishes the packet it is decoding */
+    if (exiting)
+        av_frame_free(&ev.frame);
+    return 0;
+}
+#endif
+
 static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
 {
     int i, ret;
-    AVFrame *f;
+    AVFrame *f, *tmp = ist->filter_frame;
+
+#if HAVE_PTHREADS
+    if (ist->dec_thread_queue) {
+        if (in_decoder_thread(ist))
+            return post_decoder_thread_event(ist, DEC_THREAD_FRAME, decoded_frame);
+        tmp = ist->dec_thread_filter_frame;
+    }
+#endif
 
     av_assert1(ist->nb_filters > 0); /* ensure ret is initialized */
     for (i = 0; i < ist->nb_filters; i++) {
         if (i < ist->nb_filters - 1) {
-            f = ist->filter_frame;
+            f = tmp;
             ret = av_frame_ref(f, decoded_frame);
             if (ret < 0)
                 break;
@@ -2363,8 +2683,14 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
         ret = AVERROR_INVALIDDATA;
     }
 
-    if (ret != AVERROR_EOF)
-        check_decode_result(ist, got_output, ret);
+    if (ret != AVERROR_EOF) {
+        err = check_decode_result(ist, got_output, ret);
+        if (err < 0 && ret >= 0) {
+            *decode_failed = 1;
+            av_frame_unref(decoded_frame);
+            return err;
+        }
+    }
 
     if (!*got_output || ret < 0)
         return ret;
@@ -2461,8 +2787,14 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eo
                    ist->st->codecpar->video_delay);
     }
 
-    if (ret != AVERROR_EOF)
-        check_decode_result(ist, got_output, ret);
+    if (ret != AVERROR_EOF) {
+        err = check_decode_result(ist, got_output, ret);
+        if (err < 0 && ret >= 0) {
+            *decode_failed = 1;
+            av_frame_unref(decoded_frame);
+            return err;
+        }
+    }
 
     if (*got_output && ret >= 0) {
         if (ist->dec_ctx->width  != decoded_frame->width ||
@@ -2485,6 +2817,8 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eo
         decoded_frame->top_field_first = ist->top_field_first;
 
     ist->frames_decoded++;
+    ist->thread_stalls     += ist->dec_ctx->thread_stall_count;
+    ist->thread_stall_time += ist->dec_ctx->thread_stall_time;
 
     if (ist->hwaccel_retrieve_data && decoded_frame->format == ist->hwaccel_pix_fmt) {
         err = ist->hwaccel_retrieve_data(ist->dec_ctx, decoded_frame);
@@ -2615,6 +2949,12 @@ out:
 static int send_filter_eof(InputStream *ist)
 {
     int i, ret;
+
+#if HAVE_PTHREADS
+    if (in_decoder_thread(ist))
+        return post_decoder_thread_event(ist, DEC_THREAD_FILTER_EOF, NULL);
+#endif
+
     for (i = 0; i < ist->nb_filters; i++) {
         ret = ifilter_send_eof(ist->filters[i]);
         if (ret < 0)
@@ -2636,6 +2976,12 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
     int eof_reached = 0;
 
     AVPacket avpkt;
+
+#if HAVE_PTHREADS
+    if (ist->dec_thread_queue && !in_decoder_thread(ist))
+        return process_input_packet_mt(ist, pkt, no_eof);
+#endif
+
     if (!ist->saw_first_ts) {
         ist->dts = ist->st->avg_frame_rate.num ? - ist->dec_ctx->has_b_frames * AV_TIME_BASE / av_q2d(ist->st->avg_frame_rate) : 0;
         ist->pts = 0;
@@ -2726,12 +3072,16 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
                 av_log(NULL, AV_LOG_FATAL, "Error while processing the decoded "
                        "data for stream #%d:%d\n", ist->file_index, ist->st->index);
             }
-            if (!decode_failed || exit_on_error)
+            if (!decode_failed || exit_on_error) {
+                if (stop_decoder_thread(ist))
+                    return ret;
                 exit_program(1);
+            }
             break;
         }
 
-        if (got_output)
+        /* set by the main thread when it gets the frame */
+        if (got_output && !in_decoder_thread(ist))
             ist->got_output = 1;
 
         if (!got_output)
@@ -2757,6 +3107,8 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         int ret = send_filter_eof(ist);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
+            if (stop_decoder_thread(ist))
+                return ret;
             exit_program(1);
         }
     }
@@ -2800,6 +3152,193 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
     return !eof_reached;
 }
 
+#if HAVE_PTHREADS
+typedef struct DecoderThreadMessage {
+    AVPacket pkt;
+    int flush;                  /* drain the decoder, pkt is unused */
+    int no_eof;
+} DecoderThreadMessage;
+
+static void free_decoder_thread_message(void *msg)
+{
+    av_packet_unref(&((DecoderThreadMessage *)msg)->pkt);
+}
+
+static void *decoder_thread(void *arg)
+{
+    InputStream *ist = arg;
+    DecoderThreadMessage msg;
+
+    while (av_thread_message_queue_recv(ist->dec_thread_queue, &msg, 0) >= 0) {
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_packets++;
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        if (msg.flush) {
+            while (process_input_packet(ist, NULL, msg.no_eof) > 0)
+                ;
+        } else {
+            process_input_packet(ist, &msg.pkt, 0);
+            av_packet_unref(&msg.pkt);
+        }
+        if (ist->dec_thread_failed)
+            break;
+
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_next_dts = ist->next_dts;
+        ist->dec_thread_dts      = ist->dts;
+        ist->dec_thread_next_pts = ist->next_pts;
+        ist->dec_thread_pts      = ist->pts;
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        if (msg.flush && post_decoder_thread_event(ist, DEC_THREAD_FLUSHED, NULL) < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error while flushing the decoder of "
+                   "stream #%d:%d\n", ist->file_index, ist->st->index);
+            stop_decoder_thread(ist);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* Pass what the decoder thread has output so far on to the filters. While
+ * flushing, wait for it and stop after each frame like process_input_packet()
+ * does. Return 1 if a frame was flushed, 0 otherwise. */
+static int receive_decoder_thread_events(InputStream *ist)
+{
+    DecoderThreadEvent ev;
+    int ret;
+
+    while (1) {
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        while (ist->dec_thread_flushing && !av_fifo_size(ist->dec_thread_frames) &&
+               !ist->dec_thread_failed)
+            pthread_cond_wait(&ist->dec_thread_cond, &ist->dec_thread_lock);
+        if (ist->dec_thread_failed) {
+            /* the error has been logged by the decoder thread */
+            pthread_mutex_unlock(&ist->dec_thread_lock);
+            exit_program(1);
+        }
+        if (!av_fifo_size(ist->dec_thread_frames)) {
+            pthread_mutex_unlock(&ist->dec_thread_lock);
+            return 0;
+        }
+        av_fifo_generic_read(ist->dec_thread_frames, &ev, sizeof(ev), NULL);
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        switch (ev.type) {
+        case DEC_THREAD_FRAME:
+            ist->got_output = 1;
+            ret = send_frame_to_filters(ist, ev.frame);
+            av_frame_unref(ist->dec_thread_filter_frame);
+            av_frame_free(&ev.frame);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Error while processing the decoded "
+                       "data for stream #%d:%d\n", ist->file_index, ist->st->index);
+                exit_program(1);
+            }
+            if (ist->dec_thread_flushing)
+                return 1;
+            break;
+        case DEC_THREAD_FILTER_EOF:
+            if (send_filter_eof(ist) < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
+                exit_program(1);
+            }
+            break;
+        case DEC_THREAD_FLUSHED:
+            ist->dec_thread_flushing = 0;
+            return 0;
+        }
+    }
+}
+
+/* Send a packet to the decoder thread. While the packet queue is full, pass
+ * the frames the decoder thread has output on to the filters, so that it
+ * can go on decoding when the queue of frames is full as well. */
+static int send_decoder_thread_packet(InputStream *ist, DecoderThreadMessage *msg)
+{
+    int packets, ret;
+
+    while (1) {
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        packets = ist->dec_thread_packets;
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        ret = av_thread_message_queue_send(ist->dec_thread_queue, msg,
+                                           AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        /* wait until the decoder thread takes a packet or outputs a frame */
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        while (ist->dec_thread_packets == packets &&
+               !av_fifo_size(ist->dec_thread_frames) && !ist->dec_thread_failed)
+            pthread_cond_wait(&ist->dec_thread_cond, &ist->dec_thread_lock);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+
+        receive_decoder_thread_events(ist);
+    }
+}
+
+static int process_input_packet_mt(InputStream *ist, const AVPacket *pkt, int no_eof)
+{
+    DecoderThreadMessage msg = { { 0 } };
+    int ret;
+
+    if (pkt || !ist->dec_thread_flushing) {
+        if (pkt) {
+            if (av_packet_ref(&msg.pkt, pkt) < 0)
+                exit_program(1);
+        } else {
+            msg.flush  = 1;
+            msg.no_eof = no_eof;
+        }
+
+        ret = send_decoder_thread_packet(ist, &msg);
+        if (ret < 0) {
+            /* AVERROR_EXIT if the decoder thread failed and logged why */
+            if (ret != AVERROR_EXIT)
+                av_log(NULL, AV_LOG_FATAL, "Unable to send packet to the decoder "
+                       "thread: %s\n", av_err2str(ret));
+            av_packet_unref(&msg.pkt);
+            exit_program(1);
+        }
+        /* set only now, send_decoder_thread_packet() must not wait for the
+         * flush to complete */
+        if (!pkt)
+            ist->dec_thread_flushing = 1;
+    }
+
+    ret = receive_decoder_thread_events(ist);
+    return pkt ? 1 : ret;
+}
+#endif
+
+/* the timestamps of ist as seen by the demuxing side */
+static void get_input_stream_timestamps(InputStream *ist, int64_t *next_dts, int64_t *dts,
+                                        int64_t *next_pts, int64_t *pts)
+{
+#if HAVE_PTHREADS
+    if (ist->dec_thread_queue) {
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        *next_dts = ist->dec_thread_next_dts;
+        *dts      = ist->dec_thread_dts;
+        *next_pts = ist->dec_thread_next_pts;
+        *pts      = ist->dec_thread_pts;
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+        return;
+    }
+#endif
+    *next_dts = ist->next_dts;
+    *dts      = ist->dts;
+    *next_pts = ist->next_pts;
+    *pts      = ist->pts;
+}
+
 static void print_sdp(void)
 {
     char sdp[16384];
@@ -2899,6 +3438,73 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
     return *p;
 }
 
+/* Allocate a decoded picture with the room around it that the filters fed
+ * by the stream asked for, so that e.g. pad works in place. */
+static int get_bordered_buffer(InputStream *ist, AVCodecContext *s,
+                               AVFrame *frame, int flags)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int h = frame->height;
+    int aligned_w = frame->width, aligned_h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int border[4], step[4] = { 0 }, align = 1, hmask, vmask, i, ret;
+
+    for (i = 0; i < 4; i++)
+        border[i] = atomic_load(&ist->filter_border[i]);
+
+    if (!(border[0] | border[1] | border[2] | border[3]) || !desc ||
+        desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL |
+                       AV_PIX_FMT_FLAG_PSEUDOPAL | AV_PIX_FMT_FLAG_BITSTREAM))
+        return avcodec_default_get_buffer2(s, frame, flags);
+
+    /* the decoder may write up to the aligned dimensions and needs aligned
+     * data pointers, keep the left room a multiple of the alignment on all
+     * planes */
+    avcodec_align_dimensions2(s, &aligned_w, &aligned_h, linesize_align);
+    for (i = 0; i < 4; i++)
+        align = FFMAX(align, linesize_align[i]);
+    hmask = (1 << desc->log2_chroma_w) - 1;
+    vmask = (1 << desc->log2_chroma_h) - 1;
+    border[0] = FFALIGN(border[0], align << desc->log2_chroma_w);
+    border[1] = (border[1] + vmask) & ~vmask;
+    border[2] = (border[2] + hmask) & ~hmask;
+    /* the right room of the last row is checked after its end */
+    border[3] = (border[3] + !!border[2] + vmask) & ~vmask;
+
+    /* Only the height grows: some decoders (the mpegvideo based ones) fail
+     * when the stride changes after their first frame, which is always
+     * allocated before the filters are configured. */
+    frame->height = border[1] + aligned_h + border[3];
+    ret = avcodec_default_get_buffer2(s, frame, flags);
+    frame->height = h;
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < desc->nb_components; i++)
+        step[desc->comp[i].plane] = FFMAX(step[desc->comp[i].plane],
+                                          desc->comp[i].step);
+
+    /* the horizontal room has to fit in the padding of the lines */
+    for (i = 0; i < 4 && frame->data[i]; i++) {
+        int hshift = i == 1 || i == 2 ? desc->log2_chroma_w : 0;
+
+        if (((border[0] + aligned_w + border[2]) >> hshift) * step[i] >
+            frame->linesize[i])
+            return 0;
+    }
+
+    for (i = 0; i < 4 && frame->data[i]; i++) {
+        int chroma = i == 1 || i == 2;
+        int hshift = chroma ? desc->log2_chroma_w : 0;
+        int vshift = chroma ? desc->log2_chroma_h : 0;
+
+        frame->data[i] += (border[0] >> hshift) * step[i] +
+                          (border[1] >> vshift) * frame->linesize[i];
+    }
+
+    return 0;
+}
+
 static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
 {
     InputStream *ist = s->opaque;
@@ -2906,6 +3512,9 @@ static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
     if (ist->hwaccel_get_buffer && frame->format == ist->hwaccel_pix_fmt)
         return ist->hwaccel_get_buffer(s, frame, flags);
 
+    if (s->codec_type == AVMEDIA_TYPE_VIDEO)
+        return get_bordered_buffer(ist, s, frame, flags);
+
     return avcodec_default_get_buffer2(s, frame, flags);
 }
 
@@ -3813,11 +4422,17 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int limit_reached, frame_number;
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+        if (ost->finished)
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        lock_output_file(of);
+        limit_reached = os->pb && avio_tell(os->pb) >= of->limit_filesize;
+        frame_number  = ost->frame_number;
+        unlock_output_file(of);
+        if (limit_reached)
+            continue;
+        if (frame_number >= ost->max_frames) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
                 close_output_stream(output_streams[of->ost_index + j]);
@@ -3843,10 +4458,17 @@ static OutputStream *choose_output(void)
 
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
-        int64_t opts = ost->st->cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
-                       av_rescale_q(ost->st->cur_dts, ost->st->time_base,
-                                    AV_TIME_BASE_Q);
-        if (ost->st->cur_dts == AV_NOPTS_VALUE)
+        OutputFile    *of = output_files[ost->file_index];
+        int64_t cur_dts, opts;
+
+        /* updated by the muxer, possibly in an encoder thread */
+        lock_output_file(of);
+        cur_dts = ost->st->cur_dts;
+        unlock_output_file(of);
+
+        opts = cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
+               av_rescale_q(cur_dts, ost->st->time_base, AV_TIME_BASE_Q);
+        if (cur_dts == AV_NOPTS_VALUE)
             av_log(NULL, AV_LOG_DEBUG, "cur_dts is invalid (this is harmless if it occurs once at the start per stream)\n");
 
         if (!ost->initialized && !ost->inputs_done)
@@ -4074,6 +4696,152 @@ static int init_input_threads(void)
     return 0;
 }
 
+static void free_output_threads(int drain)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i])
+            free_output_thread(output_streams[i], drain);
+}
+
+static int init_output_threads(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (ost->enc_thread_queue_size <= 0 || !ost->encoding_needed || !ost->filter)
+            continue;
+
+        ret = av_thread_message_queue_alloc(&ost->enc_thread_queue,
+                                            ost->enc_thread_queue_size,
+                                            sizeof(EncoderThreadMessage));
+        if (ret < 0)
+            return ret;
+        av_thread_message_queue_set_free_func(ost->enc_thread_queue,
+                                              free_encoder_thread_message);
+
+        if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_thread_message_queue_free(&ost->enc_thread_queue);
+            return AVERROR(ret);
+        }
+        output_files[ost->file_index]->nb_enc_threads++;
+    }
+    return 0;
+}
+
+static void free_decoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        DecoderThreadEvent ev;
+
+        if (!ist || !ist->dec_thread_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(ist->dec_thread_queue, AVERROR_EOF);
+        av_thread_message_flush(ist->dec_thread_queue);
+        pthread_mutex_lock(&ist->dec_thread_lock);
+        ist->dec_thread_exiting = 1;
+        pthread_cond_broadcast(&ist->dec_thread_cond);
+        pthread_mutex_unlock(&ist->dec_thread_lock);
+        pthread_join(ist->dec_thread, NULL);
+
+        while (av_fifo_size(ist->dec_thread_frames)) {
+            av_fifo_generic_read(ist->dec_thread_frames, &ev, sizeof(ev), NULL);
+            av_frame_free(&ev.frame);
+        }
+        av_fifo_freep(&ist->dec_thread_frames);
+        av_frame_free(&ist->dec_thread_filter_frame);
+        pthread_mutex_destroy(&ist->dec_thread_lock);
+        pthread_cond_destroy(&ist->dec_thread_cond);
+        av_thread_message_queue_free(&ist->dec_thread_queue);
+    }
+}
+
+static int can_decode_in_thread(InputStream *ist)
+{
+    InputFile *f = input_files[ist->file_index];
+    int i;
+
+    /* decoded audio and video always go to filters, either to a complex
+     * filtergraph (DECODING_FOR_FILTER) or to the simple filtergraph of an
+     * encoded output stream (DECODING_FOR_OST) */
+    if (!ist->decoding_needed ||
+        (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+         ist->dec_ctx->codec_type != AVMEDIA_TYPE_AUDIO) ||
+        ist->hwaccel_id != HWACCEL_NONE || f->loop || f->rate_emu)
+        return 0;
+
+    /* stream copy is done along with decoding, from the same timestamps */
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (ost->source_index == f->ist_index + ist->st->index && !ost->encoding_needed)
+            return 0;
+    }
+    return 1;
+}
+
+static int init_decoder_threads(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        if (ist->dec_thread_queue_size <= 0 || !ist->decoding_needed)
+            continue;
+        if (!can_decode_in_thread(ist)) {
+            av_log(NULL, AV_LOG_WARNING, "Input stream #%d:%d cannot be decoded "
+                   "in its own thread, decoding it in the main thread\n",
+                   ist->file_index, ist->st->index);
+            continue;
+        }
+
+        ist->dec_thread_frames       = av_fifo_alloc(ist->dec_thread_queue_size *
+                                                     sizeof(DecoderThreadEvent));
+        ist->dec_thread_filter_frame = av_frame_alloc();
+        if (!ist->dec_thread_frames || !ist->dec_thread_filter_frame) {
+            av_fifo_freep(&ist->dec_thread_frames);
+            av_frame_free(&ist->dec_thread_filter_frame);
+            return AVERROR(ENOMEM);
+        }
+
+        ret = av_thread_message_queue_alloc(&ist->dec_thread_queue,
+                                            ist->dec_thread_queue_size,
+                                            sizeof(DecoderThreadMessage));
+        if (ret < 0) {
+            av_fifo_freep(&ist->dec_thread_frames);
+            av_frame_free(&ist->dec_thread_filter_frame);
+            return ret;
+        }
+        av_thread_message_queue_set_free_func(ist->dec_thread_queue,
+                                              free_decoder_thread_message);
+
+        pthread_mutex_init(&ist->dec_thread_lock, NULL);
+        pthread_cond_init(&ist->dec_thread_cond, NULL);
+        ist->dec_thread_next_dts = ist->next_dts;
+        ist->dec_thread_dts      = ist->dts;
+        ist->dec_thread_next_pts = ist->next_pts;
+        ist->dec_thread_pts      = ist->pts;
+
+        if ((ret = pthread_create(&ist->dec_thread, NULL, decoder_thread, ist))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_fifo_freep(&ist->dec_thread_frames);
+            av_frame_free(&ist->dec_thread_filter_frame);
+            pthread_mutex_destroy(&ist->dec_thread_lock);
+            pthread_cond_destroy(&ist->dec_thread_cond);
+            av_thread_message_queue_free(&ist->dec_thread_queue);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+
 static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 {
     return av_thread_message_queue_recv(f->in_thread_queue, pkt,
@@ -4224,6 +4992,7 @@ static int process_input(int file_index)
     int ret, i, j;
     int64_t duration;
     int64_t pkt_dts;
+    int64_t next_dts, next_pts, ist_dts, ist_pts;
 
     is  = ifile->ctx;
     ret = get_input_packet(ifile, &pkt);
@@ -4291,6 +5060,8 @@ static int process_input(int file_index)
     if (ist->discard)
         goto discard_packet;
 
+    get_input_stream_timestamps(ist, &next_dts, &ist_dts, &next_pts, &ist_pts);
+
     if (exit_on_error && (pkt.flags & AV_PKT_FLAG_CORRUPT)) {
         av_log(NULL, AV_LOG_FATAL, "%s: corrupt input packet in stream %d\n", is->filename, pkt.stream_index);
         exit_program(1);
@@ -4300,8 +5071,8 @@ static int process_input(int file_index)
         av_log(NULL, AV_LOG_INFO, "demuxer -> ist_index:%d type:%s "
                "next_dts:%s next_dts_time:%s next_pts:%s next_pts_time:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
                ifile->ist_index + pkt.stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
-               av_ts2str(ist->next_dts), av_ts2timestr(ist->next_dts, &AV_TIME_BASE_Q),
-               av_ts2str(ist->next_pts), av_ts2timestr(ist->next_pts, &AV_TIME_BASE_Q),
+               av_ts2str(next_dts), av_ts2timestr(next_dts, &AV_TIME_BASE_Q),
+               av_ts2str(next_pts), av_ts2timestr(next_pts, &AV_TIME_BASE_Q),
                av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ist->st->time_base),
                av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ist->st->time_base),
                av_ts2str(input_files[ist->file_index]->ts_offset),
@@ -4313,7 +5084,7 @@ static int process_input(int file_index)
         // Correcting starttime based on the enabled streams
         // FIXME this ideally should be done before the first use of starttime but we do not know which are the enabled streams at that point.
         //       so we instead do it here as part of discontinuity handling
-        if (   ist->next_dts == AV_NOPTS_VALUE
+        if (   next_dts == AV_NOPTS_VALUE
             && ifile->ts_offset == -is->start_time
             && (is->iformat->flags & AVFMT_TS_DISCONT)) {
             int64_t new_start_time = INT64_MAX;
@@ -4376,7 +5147,7 @@ static int process_input(int file_index)
     pkt_dts = av_rescale_q_rnd(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
-        pkt_dts != AV_NOPTS_VALUE && ist->next_dts == AV_NOPTS_VALUE && !copy_ts
+        pkt_dts != AV_NOPTS_VALUE && next_dts == AV_NOPTS_VALUE && !copy_ts
         && (is->iformat->flags & AVFMT_TS_DISCONT) && ifile->last_ts != AV_NOPTS_VALUE) {
         int64_t delta   = pkt_dts - ifile->last_ts;
         if (delta < -1LL*dts_delta_threshold*AV_TIME_BASE ||
@@ -4404,13 +5175,13 @@ static int process_input(int file_index)
     pkt_dts = av_rescale_q_rnd(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
-         pkt_dts != AV_NOPTS_VALUE && ist->next_dts != AV_NOPTS_VALUE &&
+         pkt_dts != AV_NOPTS_VALUE && next_dts != AV_NOPTS_VALUE &&
         !copy_ts) {
-        int64_t delta   = pkt_dts - ist->next_dts;
+        int64_t delta   = pkt_dts - next_dts;
         if (is->iformat->flags & AVFMT_TS_DISCONT) {
             if (delta < -1LL*dts_delta_threshold*AV_TIME_BASE ||
                 delta >  1LL*dts_delta_threshold*AV_TIME_BASE ||
-                pkt_dts + AV_TIME_BASE/10 < FFMAX(ist->pts, ist->dts)) {
+                pkt_dts + AV_TIME_BASE/10 < FFMAX(ist_pts, ist_dts)) {
                 ifile->ts_offset -= delta;
                 av_log(NULL, AV_LOG_DEBUG,
                        "timestamp discontinuity %"PRId64", new offset= %"PRId64"\n",
@@ -4422,15 +5193,15 @@ static int process_input(int file_index)
         } else {
             if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
                  delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
-                av_log(NULL, AV_LOG_WARNING, "DTS %"PRId64", next:%"PRId64" st:%d invalid dropping\n", pkt.dts, ist->next_dts, pkt.stream_index);
+                av_log(NULL, AV_LOG_WARNING, "DTS %"PRId64", next:%"PRId64" st:%d invalid dropping\n", pkt.dts, next_dts, pkt.stream_index);
                 pkt.dts = AV_NOPTS_VALUE;
             }
             if (pkt.pts != AV_NOPTS_VALUE){
                 int64_t pkt_pts = av_rescale_q(pkt.pts, ist->st->time_base, AV_TIME_BASE_Q);
-                delta   = pkt_pts - ist->next_dts;
+                delta   = pkt_pts - next_dts;
                 if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
                      delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
-                    av_log(NULL, AV_LOG_WARNING, "PTS %"PRId64", next:%"PRId64" invalid dropping st:%d\n", pkt.pts, ist->next_dts, pkt.stream_index);
+                    av_log(NULL, AV_LOG_WARNING, "PTS %"PRId64", next:%"PRId64" invalid dropping st:%d\n", pkt.pts, next_dts, pkt.stream_index);
                     pkt.pts = AV_NOPTS_VALUE;
                 }
             }
@@ -4631,6 +5402,10 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_output_threads()) < 0)
+        goto fail;
+    if ((ret = init_decoder_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4670,6 +5445,10 @@ static int transcode(void)
             process_input_packet(ist, NULL, 0);
         }
     }
+#if HAVE_PTHREADS
+    free_decoder_threads();
+    free_output_threads(1);
+#endif
     flush_encoders();
 
     term_exit();
@@ -4803,7 +5582,7 @@ exit_progam()
 int main(int argc, char **argv)
 {
     int i, ret;
-    int64_t ti;
+    int64_t ti, decoded, errors;
 
     init_dynload();
 
@@ -4865,9 +5644,11 @@ int main(int argc, char **argv)
     if (do_benchmark) {
         av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs\n", ti / 1000000.0);
     }
+    decoded = atomic_load(&decode_error_stat[0]);
+    errors  = atomic_load(&decode_error_stat[1]);
     av_log(NULL, AV_LOG_DEBUG, "%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
-           decode_error_stat[0], decode_error_stat[1]);
-    if ((decode_error_stat[0] + decode_error_stat[1]) * max_error_rate < decode_error_stat[1])
+           decoded, errors);
+    if ((decoded + errors) * max_error_rate < errors)
         exit_program(69);
 
     exit_program(received_nb_signals ? 255 : main_return_code);
@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -204,6 +205,8 @@ typedef struct OptionsContext {
     int        nb_filter_scripts;
     SpecifierOpt *reinit_filters;
     int        nb_reinit_filters;
+    SpecifierOpt *dec_thread_queue_size;
+    int        nb_dec_thread_queue_size;
     SpecifierOpt *fix_sub_duration;
     int        nb_fix_sub_duration;
     SpecifierOpt *canvas_sizes;
@@ -214,6 +217,8 @@ typedef struct OptionsContext {
     int        nb_passlogfiles;
     SpecifierOpt *max_muxing_queue_size;
     int        nb_max_muxing_queue_size;
+    SpecifierOpt *enc_thread_queue_size;
+    int        nb_enc_thread_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -353,6 +358,9 @@ typedef struct InputStream {
      * currently video and audio only */
     InputFilter **filters;
     int        nb_filters;
+    /* room around decoded pictures that the filters can use to work in
+     * place, see av_buffersrc_get_border(); read by the decoder threads */
+    atomic_int filter_border[4];
 
     int reinit_filters;
 
@@ -379,11 +387,33 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+    // frame threading stalls of the decoder, see AVCodecContext.thread_stall_count
+    uint64_t thread_stalls;
+    int64_t thread_stall_time;
 
     int64_t *dts_buffer;
     int nb_dts_buffer;
 
     int got_output;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *dec_thread_queue; /* packets to the decoder thread */
+    pthread_t dec_thread;       /* thread decoding this stream */
+    int dec_thread_queue_size;  /* maximum number of queued packets, 0 to decode in the main thread */
+    int dec_thread_flushing;    /* the decoder thread has been asked to flush */
+    AVFrame *dec_thread_filter_frame; /* filter_frame of the main thread */
+
+    /* frames and events from the decoder thread to the main thread, up to
+     * dec_thread_queue_size, and the timestamps above as of the last packet
+     * it has decoded */
+    pthread_mutex_t dec_thread_lock;
+    pthread_cond_t dec_thread_cond;
+    AVFifoBuffer *dec_thread_frames;
+    int64_t dec_thread_next_dts, dec_thread_dts, dec_thread_next_pts, dec_thread_pts;
+    int dec_thread_failed;      /* the decoder thread stopped on a fatal error */
+    int dec_thread_packets;     /* number of packets the decoder thread has taken */
+    int dec_thread_exiting;     /* the queued frames are no longer read */
+#endif
 } InputStream;
 
 typedef struct InputFile {
@@ -547,6 +577,14 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_thread_queue;
+    pthread_t enc_thread;       /* thread encoding and muxing this stream */
+    int enc_thread_queue_size;  /* maximum number of queued frames, 0 to encode in the main thread */
+    uint64_t enc_thread_blocked; /* number of times the queue was full */
+    int enc_thread_status;      /* why the encoder thread stopped, read by the main thread once it is joined */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -560,6 +598,11 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_PTHREADS
+    int nb_enc_threads;         /* number of streams encoded in their own thread */
+    pthread_mutex_t mux_lock;   /* serializes muxing when nb_enc_threads is set */
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -607,6 +650,7 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_complex_parallel;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
@@ -1041,6 +1041,8 @@ int configure_filtergraph(FilterGraph *fg)
             av_opt_set(fg->graph, "threads", e->value, 0);
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
+        if (filter_complex_parallel)
+            fg->graph->thread_type |= AVFILTER_THREAD_GRAPH;
     }
 
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
@@ -1093,6 +1095,18 @@ int configure_filtergraph(FilterGraph *fg)
     if ((ret = avfilter_graph_config(fg->graph, NULL)) < 0)
         goto fail;
 
+    /* let the decoders allocate frames with the room that the filters can use
+     * to process them in place, unless the frames go to several filters */
+    for (i = 0; i < fg->nb_inputs; i++) {
+        InputStream *ist = fg->inputs[i]->ist;
+        int border[4] = { 0 }, j;
+
+        if (ist->nb_filters == 1)
+            av_buffersrc_get_border(fg->inputs[i]->filter, border);
+        for (j = 0; j < 4; j++)
+            atomic_store(&ist->filter_border[j], border[j]);
+    }
+
     /* limit the lists of allowed formats to the ones selected, to
      * make sure they stay the same if the filtergraph is reconfigured later */
     for (i = 0; i < fg->nb_outputs; i++) {
@@ -506,6 +506,201 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Channel element searched by a job of aac_encode_frame()
+ */
+typedef struct ElementJob {
+    ChannelElement *cpe;
+    FFPsyWindowInfo *wi;
+    int tag;
+    int chans;
+    int start_ch;
+    int bitres_alloc;                            ///< bits allocated to each channel by the psy
+    int cutoff;                                  ///< psy cutoff set by the quantizer search
+    int tns_mode, is_mode, pred_mode;
+} ElementJob;
+
+/**
+ * Copy the state the coders read to the contexts of the slice threads,
+ * before they run the jobs of a frame.
+ */
+static void update_thread_contexts(AACEncContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        s->thread_ctx[i]->lambda = s->lambda;
+        s->thread_ctx[i]->psy    = s->psy;
+    }
+}
+
+/**
+ * Get the context with the scratch buffers of a slice thread, updated with
+ * the state the coders read for the channel element.
+ */
+static AACEncContext *get_thread_context(AACEncContext *s, const ElementJob *el,
+                                         int threadnr)
+{
+    AACEncContext *ts = s->nb_thread_ctx ? s->thread_ctx[threadnr] : s;
+
+    ts->psy.bitres.alloc = el->bitres_alloc;
+    ts->cur_type         = el->tag;
+    return ts;
+}
+
+/**
+ * Run the psy model on a channel element and add the bits it targets for the
+ * element to target_bits.
+ */
+static void analyze_element(AVCodecContext *avctx, AACEncContext *s, ElementJob *el,
+                            int *target_bits)
+{
+    ChannelElement *cpe = el->cpe;
+    const float *coeffs[2];
+    int ch, w;
+
+    cpe->common_window = 0;
+    memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
+    memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+    for (ch = 0; ch < el->chans; ch++) {
+        SingleChannelElement *sce = &cpe->ch[ch];
+        coeffs[ch] = sce->coeffs;
+        sce->ics.predictor_present = 0;
+        sce->ics.ltp.present = 0;
+        memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
+        memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
+        memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
+        for (w = 0; w < 128; w++)
+            if (sce->band_type[w] > RESERVED_BT)
+                sce->band_type[w] = 0;
+    }
+    s->psy.bitres.alloc = -1;
+    s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
+    s->psy.model->analyze(&s->psy, el->start_ch, coeffs, el->wi);
+    if (s->psy.bitres.alloc > 0) {
+        /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
+        *target_bits += s->psy.bitres.alloc
+            * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
+        s->psy.bitres.alloc /= el->chans;
+    }
+    el->bitres_alloc = s->psy.bitres.alloc;
+}
+
+/**
+ * Search the quantizers and TNS of a channel element.
+ */
+static int search_element(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    ElementJob *el = (ElementJob *)arg + jobnr;
+    AACEncContext *s = get_thread_context(avctx->priv_data, el, threadnr);
+    ChannelElement *cpe = el->cpe;
+    FFPsyWindowInfo *wi = el->wi;
+    int ch, w;
+
+    for (ch = 0; ch < el->chans; ch++) {
+        s->cur_channel = el->start_ch + ch;
+        if (s->options.pns && s->coder->mark_pns)
+            s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    if (el->chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    for (ch = 0; ch < el->chans; ch++) { /* TNS */
+        SingleChannelElement *sce = &cpe->ch[ch];
+        s->cur_channel = el->start_ch + ch;
+        if (s->options.tns && s->coder->search_for_tns)
+            s->coder->search_for_tns(s, sce);
+        if (s->options.tns && s->coder->apply_tns_filt)
+            s->coder->apply_tns_filt(s, sce);
+        if (sce->tns.present)
+            el->tns_mode = 1;
+    }
+    el->cutoff = s->psy.cutoff;
+    return 0;
+}
+
+static void search_element_pns(AVCodecContext *avctx, AACEncContext *s, ElementJob *el)
+{
+    int ch;
+
+    if (!s->options.pns || !s->coder->search_for_pns)
+        return;
+    for (ch = 0; ch < el->chans; ch++) {
+        s->cur_channel = el->start_ch + ch;
+        s->coder->search_for_pns(s, avctx, &el->cpe->ch[ch]);
+    }
+}
+
+/**
+ * Search the intensity stereo, prediction, mid/side stereo and LTP of a
+ * channel element, after its PNS search.
+ */
+static int search_element_stereo(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    ElementJob *el = (ElementJob *)arg + jobnr;
+    AACEncContext *s = get_thread_context(avctx->priv_data, el, threadnr);
+    ChannelElement *cpe = el->cpe;
+    SingleChannelElement *sce;
+    int ch;
+
+    s->cur_channel = el->start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(s, avctx, cpe);
+        if (cpe->is_mode) el->is_mode = 1;
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < el->chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = el->start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(s, sce);
+            if (cpe->ch[ch].ics.predictor_present) el->pred_mode = 1;
+        }
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(s, cpe);
+        for (ch = 0; ch < el->chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = el->start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(s, sce);
+        }
+        s->cur_channel = el->start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(s, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, el->chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < el->chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = el->start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(s, sce, cpe->common_window);
+            if (sce->ics.ltp.present) el->pred_mode = 1;
+        }
+        s->cur_channel = el->start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(s, cpe);
+    }
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -519,6 +714,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    ElementJob elements[AAC_MAX_CHANNELS];
 
     /* add current frame to queue */
     if (frame) {
@@ -641,115 +837,60 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
+        for (i = 0; i < s->chan_map[0]; i++) {
+            ElementJob *el = &elements[i];
+            el->tag      = s->chan_map[i+1];
+            el->chans    = el->tag == TYPE_CPE ? 2 : 1;
+            el->start_ch = start_ch;
+            el->cpe      = &s->cpe[i];
+            el->wi       = windows + start_ch;
+            el->tns_mode = el->is_mode = el->pred_mode = 0;
+            start_ch += el->chans;
+        }
+
+        if (avctx->frame_number > 1 && !s->options.pred &&
+            !(avctx->flags & AV_CODEC_FLAG_QSCALE)) {
+            /* The channel elements are searched concurrently with slice
+             * threads, except for PNS which draws from a random state shared
+             * by all the channels, so that the output does not depend on the
+             * number of threads. */
+            for (i = 0; i < s->chan_map[0]; i++)
+                analyze_element(avctx, s, &elements[i], &target_bits);
+            update_thread_contexts(s);
+            avctx->execute2(avctx, search_element, elements, NULL, s->chan_map[0]);
+            s->psy.cutoff = elements[s->chan_map[0] - 1].cutoff;
+            for (i = 0; i < s->chan_map[0]; i++)
+                search_element_pns(avctx, s, &elements[i]);
+            update_thread_contexts(s);
+            avctx->execute2(avctx, search_element_stereo, elements, NULL, s->chan_map[0]);
+        } else {
+            /* The quantizer search sets the bandwidth of the psy model, use
+             * it for the following elements of the first frame, and of every
+             * frame with a constant quality, where it is derived from lambda
+             * instead of the bitrate. The common prediction of a CPE reads the
+             * psy bands of the next channel before they are analyzed. */
+            for (i = 0; i < s->chan_map[0]; i++) {
+                analyze_element(avctx, s, &elements[i], &target_bits);
+                update_thread_contexts(s);
+                search_element(avctx, elements, i, 0);
+                s->psy.cutoff = elements[i].cutoff;
+                search_element_pns(avctx, s, &elements[i]);
+                update_thread_contexts(s);
+                search_element_stereo(avctx, elements, i, 0);
+            }
+        }
+
         memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
-            const float *coeffs[2];
-            tag      = s->chan_map[i+1];
-            chans    = tag == TYPE_CPE ? 2 : 1;
-            cpe      = &s->cpe[i];
-            cpe->common_window = 0;
-            memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
-            memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+            ElementJob *el = &elements[i];
+            tag   = el->tag;
+            chans = el->chans;
+            cpe   = el->cpe;
+            tns_mode  |= el->tns_mode;
+            is_mode   |= el->is_mode;
+            pred_mode |= el->pred_mode;
             put_bits(&s->pb, 3, tag);
             put_bits(&s->pb, 4, chan_el_counter[tag]++);
-            for (ch = 0; ch < chans; ch++) {
-                sce = &cpe->ch[ch];
-                coeffs[ch] = sce->coeffs;
-                sce->ics.predictor_present = 0;
-                sce->ics.ltp.present = 0;
-                memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
-                memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
-                memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
-                for (w = 0; w < 128; w++)
-                    if (sce->band_type[w] > RESERVED_BT)
-                        sce->band_type[w] = 0;
-            }
-            s->psy.bitres.alloc = -1;
-            s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
-            s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
-            if (s->psy.bitres.alloc > 0) {
-                /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
-                target_bits += s->psy.bitres.alloc
-                    * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
-                s->psy.bitres.alloc /= chans;
-            }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -763,10 +904,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                 }
             }
             for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
+                s->cur_channel = el->start_ch + ch;
                 encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
             }
-            start_ch += chans;
         }
 
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
@@ -852,6 +992,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_sum / s->lambda_count);
 
@@ -859,6 +1000,11 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
+    for (i = 0; i < s->nb_thread_ctx; i++) {
+        ff_lpc_end(&s->thread_ctx[i]->lpc);
+        av_freep(&s->thread_ctx[i]);
+    }
+    av_freep(&s->thread_ctx);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
@@ -868,6 +1014,15 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     return 0;
 }
 
+av_cold void ff_aac_dsp_init(AACEncContext *s)
+{
+    s->abs_pow34   = abs_pow34_v;
+    s->quant_bands = quantize_bands;
+
+    if (ARCH_X86)
+        ff_aac_dsp_init_x86(s);
+}
+
 static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
 {
     int ret = 0;
@@ -905,6 +1060,37 @@ alloc_fail:
     return AVERROR(ENOMEM);
 }
 
+/**
+ * Allocate the contexts of the slice threads, which hold their own scratch
+ * buffers and quantization cost cache.
+ */
+static av_cold int alloc_thread_contexts(AVCodecContext *avctx, AACEncContext *s)
+{
+    int i, ret;
+
+    /* the elements of a constant quality encode are searched in order */
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) || avctx->thread_count <= 1 ||
+        avctx->flags & AV_CODEC_FLAG_QSCALE)
+        return 0;
+
+    s->thread_ctx = av_mallocz_array(avctx->thread_count, sizeof(*s->thread_ctx));
+    if (!s->thread_ctx)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < avctx->thread_count; i++) {
+        AACEncContext *ts = av_malloc(sizeof(*ts));
+        if (!ts)
+            return AVERROR(ENOMEM);
+        memcpy(ts, s, sizeof(*ts));
+        ts->thread_ctx    = NULL;
+        ts->nb_thread_ctx = 0;
+        s->thread_ctx[s->nb_thread_ctx++] = ts;
+        if ((ret = ff_lpc_init(&ts->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static av_cold void aac_encode_init_tables(void)
 {
     ff_aac_tableinit();
@@ -1030,11 +1216,7 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     ff_lpc_init(&s->lpc, 2*avctx->frame_size, TNS_MAX_ORDER, FF_LPC_TYPE_LEVINSON);
     s->random_state = 0x1f2e3d4c;
 
-    s->abs_pow34   = abs_pow34_v;
-    s->quant_bands = quantize_bands;
-
-    if (ARCH_X86)
-        ff_aac_dsp_init_x86(s);
+    ff_aac_dsp_init(s);
 
     if (HAVE_MIPSDSP)
         ff_aac_coder_init_mips(s);
@@ -1044,6 +1226,9 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
+    if ((ret = alloc_thread_contexts(avctx, s)) < 0)
+        goto fail;
+
     return 0;
 fail:
     aac_encode_end(avctx);
@@ -1089,7 +1274,8 @@ AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
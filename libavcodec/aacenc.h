@@ -134,8 +134,12 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext **thread_ctx;           ///< scratch contexts of the slice threads
+    int nb_thread_ctx;
 } AACEncContext;
 
+void ff_aac_dsp_init(AACEncContext *s);
 void ff_aac_dsp_init_x86(AACEncContext *s);
 void ff_aac_coder_init_mips(AACEncContext *c);
 void ff_quantize_band_cost_cache_init(struct AACEncContext *s);
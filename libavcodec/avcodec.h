@@ -3748,6 +3748,18 @@ typedef struct AVCodecContext {
      *             AVCodecContext.get_format callback)
      */
     int hwaccel_flags;
+
+    /**
+     * Frame threading statistics of the decode call that returned the last
+     * frame: the number of times its thread blocked waiting for rows of a
+     * reference picture still being decoded by another thread, and the total
+     * time it spent blocked, in microseconds.
+     * Only filled by decoders which support it, currently H.264.
+     * - encoding: unused
+     * - decoding: set by libavcodec
+     */
+    int thread_stall_count;
+    int64_t thread_stall_time;
 } AVCodecContext;
 
 AVRational av_codec_get_pkt_timebase         (const AVCodecContext *avctx);
@@ -189,12 +189,14 @@ static void await_reference_mb_row(const H264Context *const h, H264Ref *ref,
         return;
 
     /* FIXME: It can be safe to access mb stuff
-     * even if pixels aren't deblocked yet. */
-
-    ff_thread_await_progress(&ref->parent->tf,
-                             FFMIN(16 * mb_y >> ref_field_picture,
-                                   ref_height - 1),
-                             ref_field_picture && ref_field);
+     * even if pixels aren't deblocked yet.
+     * With tight_progress, the first row of mb_y is reported as soon as
+     * mb_y has been decoded, so this does not wait longer than needed. */
+
+    ff_thread_await_progress_stat(h->avctx, &ref->parent->tf,
+                                  FFMIN(16 * mb_y >> ref_field_picture,
+                                        ref_height - 1),
+                                  ref_field_picture && ref_field);
 }
 
 static void pred_spatial_direct_motion(const H264Context *const h, H264SliceContext *sl,
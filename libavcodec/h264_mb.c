@@ -177,26 +177,26 @@ static void await_references(const H264Context *h, H264SliceContext *sl)
 
                 if (!FIELD_PICTURE(h) && ref_field_picture) { // frame referencing two fields
                     av_assert2((ref_pic->parent->reference & 3) == 3);
-                    ff_thread_await_progress(&ref_pic->parent->tf,
-                                             FFMIN((row >> 1) - !(row & 1),
-                                                   pic_height - 1),
-                                             1);
-                    ff_thread_await_progress(&ref_pic->parent->tf,
-                                             FFMIN((row >> 1), pic_height - 1),
-                                             0);
+                    ff_thread_await_progress_stat(h->avctx, &ref_pic->parent->tf,
+                                                  FFMIN((row >> 1) - !(row & 1),
+                                                        pic_height - 1),
+                                                  1);
+                    ff_thread_await_progress_stat(h->avctx, &ref_pic->parent->tf,
+                                                  FFMIN((row >> 1), pic_height - 1),
+                                                  0);
                 } else if (FIELD_PICTURE(h) && !ref_field_picture) { // field referencing one field of a frame
-                    ff_thread_await_progress(&ref_pic->parent->tf,
-                                             FFMIN(row * 2 + ref_field,
-                                                   pic_height - 1),
-                                             0);
+                    ff_thread_await_progress_stat(h->avctx, &ref_pic->parent->tf,
+                                                  FFMIN(row * 2 + ref_field,
+                                                        pic_height - 1),
+                                                  0);
                 } else if (FIELD_PICTURE(h)) {
-                    ff_thread_await_progress(&ref_pic->parent->tf,
-                                             FFMIN(row, pic_height - 1),
-                                             ref_field);
+                    ff_thread_await_progress_stat(h->avctx, &ref_pic->parent->tf,
+                                                  FFMIN(row, pic_height - 1),
+                                                  ref_field);
                 } else {
-                    ff_thread_await_progress(&ref_pic->parent->tf,
-                                             FFMIN(row, pic_height - 1),
-                                             0);
+                    ff_thread_await_progress_stat(h->avctx, &ref_pic->parent->tf,
+                                                  FFMIN(row, pic_height - 1),
+                                                  0);
                 }
             }
         }
@@ -1511,9 +1511,9 @@ static int h264_field_start(H264Context *h, const H264SliceContext *sl,
                 h->short_ref[0]->f->width == prev->f->width &&
                 h->short_ref[0]->f->height == prev->f->height &&
                 h->short_ref[0]->f->format == prev->f->format) {
-                ff_thread_await_progress(&prev->tf, INT_MAX, 0);
+                ff_thread_await_progress_stat(h->avctx, &prev->tf, INT_MAX, 0);
                 if (prev->field_picture)
-                    ff_thread_await_progress(&prev->tf, INT_MAX, 1);
+                    ff_thread_await_progress_stat(h->avctx, &prev->tf, INT_MAX, 1);
                 av_image_copy(h->short_ref[0]->f->data,
                               h->short_ref[0]->f->linesize,
                               (const uint8_t **)prev->f->data,
@@ -2444,13 +2444,17 @@ static void predict_field_decoding_flag(const H264Context *h, H264SliceContext *
 
 /**
  * Draw edges and report progress for the last MB row.
+ *
+ * Deblocking the top edge of the next row changes up to 3 lines of this
+ * one (of each field for MBAFF field pairs), so those are held back.
+ * Without tight_progress, the whole row is held back as well.
  */
 static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
 {
     int top            = 16 * (sl->mb_y      >> FIELD_PICTURE(h));
     int pic_height     = 16 *  h->mb_height >> FIELD_PICTURE(h);
     int height         =  16      << FRAME_MBAFF(h);
-    int deblock_border = (16 + 4) << FRAME_MBAFF(h);
+    int deblock_border = (h->tight_progress ? 4 : 16 + 4) << FRAME_MBAFF(h);
 
     if (sl->deblocking_filter) {
         if ((top + height) >= pic_height)
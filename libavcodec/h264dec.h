@@ -596,6 +596,7 @@ typedef struct H264Context {
     int16_t slice_row[MAX_SLICES]; ///< to detect when MAX_SLICES is too low
 
     int enable_er;
+    int tight_progress;
 
     H264SEIContext sei;
 
@@ -3132,6 +3132,8 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     HEVCContext       *s = avctx->priv_data;
     int i;
 
+    ff_frame_thread_free_slices(avctx);
+
     pic_arrays_free(s);
 
     av_freep(&s->sei.picture_hash.md5_ctx);
@@ -3303,6 +3305,22 @@ static int hevc_update_thread_context(AVCodecContext *dst,
     return 0;
 }
 
+/* In frame threading mode, decode the CTB rows of WPP slices of each frame
+ * in parallel as well. The frame progress is reported per CTB row from the
+ * row threads (see ff_hevc_hls_filter()). */
+static av_cold int hevc_init_wpp_threads(AVCodecContext *avctx)
+{
+    HEVCContext *s = avctx->priv_data;
+    int ret;
+
+    ret = ff_frame_thread_init_slices(avctx, FFMIN(s->wpp_threads, MAX_NB_THREADS));
+    if (ret < 0)
+        return ret;
+    s->threads_number = FFMAX(ret, 1);
+
+    return 0;
+}
+
 static av_cold int hevc_decode_init(AVCodecContext *avctx)
 {
     HEVCContext *s = avctx->priv_data;
@@ -3338,20 +3356,36 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
         else
             s->threads_type = FF_THREAD_SLICE;
 
+    if (s->threads_type == FF_THREAD_FRAME) {
+        ret = hevc_init_wpp_threads(avctx);
+        if (ret < 0) {
+            hevc_decode_free(avctx);
+            return ret;
+        }
+    }
+
     return 0;
 }
 
 static av_cold int hevc_init_thread_copy(AVCodecContext *avctx)
 {
     HEVCContext *s = avctx->priv_data;
+    int wpp_threads = s->wpp_threads;
     int ret;
 
     memset(s, 0, sizeof(*s));
+    s->wpp_threads = wpp_threads;
 
     ret = hevc_init_context(avctx);
     if (ret < 0)
         return ret;
 
+    ret = hevc_init_wpp_threads(avctx);
+    if (ret < 0) {
+        hevc_decode_free(avctx);
+        return ret;
+    }
+
     return 0;
 }
 
@@ -3371,6 +3405,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "Number of threads decoding the CTB rows of each frame in frame threading mode", OFFSET(wpp_threads),
+        AV_OPT_TYPE_INT, {.i64 = 1}, 1, MAX_NB_THREADS, PAR },
     { NULL },
 };
 
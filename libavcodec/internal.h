@@ -147,6 +147,13 @@ typedef struct AVCodecInternal {
 
     void *thread_ctx;
 
+    /**
+     * Slice threading context, shared with thread_ctx in slice threading
+     * mode. Frame threads splitting their frames across slice threads have
+     * their own, see ff_frame_thread_init_slices().
+     */
+    void *slice_thread_ctx;
+
     DecodeSimpleContext ds;
     DecodeFilterContext filter;
 
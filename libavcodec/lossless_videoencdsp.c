@@ -74,10 +74,21 @@ static void sub_median_pred_c(uint8_t *dst, const uint8_t *src1,
     *left_top = lt;
 }
 
+static int sum_abs_int8_c(const uint8_t *src, intptr_t w)
+{
+    long i;
+    int sum = 0;
+
+    for (i = 0; i < w; i++)
+        sum += FFABS((int8_t)src[i]);
+    return sum;
+}
+
 av_cold void ff_llvidencdsp_init(LLVidEncDSPContext *c)
 {
     c->diff_bytes      = diff_bytes_c;
     c->sub_median_pred = sub_median_pred_c;
+    c->sum_abs_int8    = sum_abs_int8_c;
 
     if (ARCH_X86)
         ff_llvidencdsp_init_x86(c);
@@ -33,6 +33,11 @@ typedef struct LLVidEncDSPContext {
     void (*sub_median_pred)(uint8_t *dst, const uint8_t *src1,
                             const uint8_t *src2, intptr_t w,
                             int *left, int *left_top);
+    /**
+     * Sum the absolute values of the bytes of src read as signed, as done
+     * to choose the prediction of a row by PNG's heuristic.
+     */
+    int (*sum_abs_int8)(const uint8_t *src, intptr_t w);
 } LLVidEncDSPContext;
 
 void ff_llvidencdsp_init(LLVidEncDSPContext *c);
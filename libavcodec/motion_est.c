@@ -1131,6 +1131,142 @@ int ff_pre_estimate_p_frame_motion(MpegEncContext * s,
     return dmin;
 }
 
+int ff_me_pyramid_init(MpegEncContext *s)
+{
+    MotionEstContext * const c = &s->me;
+    int levels = s->me_pyramid;
+    int l, i;
+
+    /* the coarsest level must hold a whole 8x8 block */
+    while (levels > 0 && ((s->mb_width  * 16 >> levels) < 8 ||
+                          (s->mb_height * 16 >> levels) < 8))
+        levels--;
+
+    for (l = 1; l <= levels; l++) {
+        const int w = s->mb_width  * 16 >> l;
+        const int h = s->mb_height * 16 >> l;
+
+        c->pyramid_stride[l] = FFALIGN(w, 32);
+        for (i = 0; i < 2; i++) {
+            c->pyramid[i][l] = av_malloc(c->pyramid_stride[l] * h);
+            if (!c->pyramid[i][l])
+                goto fail;
+        }
+        c->pyramid_mv[l] = av_mallocz_array(s->mb_stride * s->mb_height,
+                                            sizeof(*c->pyramid_mv[l]));
+        if (!c->pyramid_mv[l])
+            goto fail;
+    }
+    c->pyramid_levels = levels;
+    return 0;
+fail:
+    ff_me_pyramid_free(s);
+    return AVERROR(ENOMEM);
+}
+
+void ff_me_pyramid_free(MpegEncContext *s)
+{
+    MotionEstContext * const c = &s->me;
+    int l;
+
+    for (l = 0; l <= ME_PYRAMID_MAX_LEVELS; l++) {
+        av_freep(&c->pyramid[0][l]);
+        av_freep(&c->pyramid[1][l]);
+        av_freep(&c->pyramid_mv[l]);
+    }
+    c->pyramid_levels = 0;
+}
+
+void ff_me_pyramid_downsample(MpegEncContext *s)
+{
+    MotionEstContext * const c = &s->me;
+    int i, l, x, y;
+
+    for (i = 0; i < 2; i++) {
+        const uint8_t *src = i ? s->last_picture.f->data[0] : s->new_picture.f->data[0];
+        ptrdiff_t src_stride = s->linesize;
+
+        /* the rows of a level only depend on the same macroblock rows above */
+        for (l = 1; l <= c->pyramid_levels; l++) {
+            const int w     = s->mb_width   * 16 >> l;
+            const int start = s->start_mb_y * 16 >> l;
+            const int end   = s->end_mb_y   * 16 >> l;
+            const ptrdiff_t stride = c->pyramid_stride[l];
+            uint8_t *dst = c->pyramid[i][l];
+
+            for (y = start; y < end; y++) {
+                const uint8_t *src0 = src + 2 * y * src_stride;
+                const uint8_t *src1 = src0 + src_stride;
+                uint8_t *d = dst + y * stride;
+
+                for (x = 0; x < w; x++)
+                    d[x] = (src0[2 * x] + src0[2 * x + 1] +
+                            src1[2 * x] + src1[2 * x + 1] + 2) >> 2;
+            }
+            src        = dst;
+            src_stride = stride;
+        }
+    }
+}
+
+void ff_me_pyramid_search(MpegEncContext *s)
+{
+    MotionEstContext * const c = &s->me;
+    const int l       = c->pyramid_level;
+    const int shift   = l - 1; /* log2 of the macroblocks per block side */
+    const int w       = s->mb_width  * 16 >> l;
+    const int h       = s->mb_height * 16 >> l;
+    const int bw      = (s->mb_width   + (1 << shift) - 1) >> shift;
+    const int start   = (s->start_mb_y + (1 << shift) - 1) >> shift;
+    const int end     = (s->end_mb_y   + (1 << shift) - 1) >> shift;
+    const ptrdiff_t stride = c->pyramid_stride[l];
+    const int penalty = s->lambda >> FF_LAMBDA_SHIFT;
+    me_cmp_func sad   = s->mecc.sad[1];
+    int range, bx, by;
+
+    /* exhaustive search on the coarsest level, refinement on the others */
+    if (l == c->pyramid_levels)
+        range = c->avctx->me_range ? FFMAX(c->avctx->me_range >> l, 1) : 8;
+    else
+        range = 1;
+
+    for (by = start; by < end; by++) {
+        for (bx = 0; bx < bw; bx++) {
+            /* the blocks overlapping the edges are moved inside the plane */
+            const int x = FFMIN(8 * bx,  w - 8);
+            const int y = FFMIN(8 * by,  h - 8);
+            uint8_t *cur = c->pyramid[0][l] + y * stride + x;
+            uint8_t *ref = c->pyramid[1][l] + y * stride + x;
+            const int xmin = -x, xmax = w - 8 - x;
+            const int ymin = -y, ymax = h - 8 - y;
+            int cx = 0, cy = 0, best_x = 0, best_y = 0, dmin, mx, my;
+
+            if (l < c->pyramid_levels) {
+                const int16_t *mv = c->pyramid_mv[l + 1][(by >> 1) * s->mb_stride + (bx >> 1)];
+                cx = av_clip(2 * mv[0], xmin, xmax);
+                cy = av_clip(2 * mv[1], ymin, ymax);
+            }
+            /* the zero vector keeps the static areas out of the motion above */
+            dmin = sad(s, cur, ref, stride, 8);
+
+            for (my = FFMAX(cy - range, ymin); my <= FFMIN(cy + range, ymax); my++) {
+                for (mx = FFMAX(cx - range, xmin); mx <= FFMIN(cx + range, xmax); mx++) {
+                    int d = sad(s, cur, ref + my * stride + mx, stride, 8) +
+                            penalty * (FFABS(mx) + FFABS(my));
+
+                    if (d < dmin) {
+                        dmin   = d;
+                        best_x = mx;
+                        best_y = my;
+                    }
+                }
+            }
+            c->pyramid_mv[l][by * s->mb_stride + bx][0] = best_x;
+            c->pyramid_mv[l][by * s->mb_stride + bx][1] = best_y;
+        }
+    }
+}
+
 static int estimate_motion_b(MpegEncContext *s, int mb_x, int mb_y,
                              int16_t (*mv_table)[2], int ref_index, int f_code)
 {
@@ -36,6 +36,7 @@ struct MpegEncContext;
 #endif
 #define MAX_DMV (2*MAX_MV)
 #define ME_MAP_SIZE 64
+#define ME_PYRAMID_MAX_LEVELS 3
 
 #define FF_ME_ZERO 0
 #define FF_ME_EPZS 1
@@ -92,6 +93,15 @@ typedef struct MotionEstContext {
     qpel_mc_func(*qpel_avg)[16];
     uint8_t (*mv_penalty)[MAX_DMV * 2 + 1]; ///< bit amount needed to encode a MV
     uint8_t *current_mv_penalty;
+
+    /* hierarchical pre-pass */
+    int pyramid_levels;             ///< number of downsampled levels, 0 if disabled
+    int pyramid_level;              ///< level searched by ff_me_pyramid_search()
+    uint8_t *pyramid[2][ME_PYRAMID_MAX_LEVELS + 1]; ///< downsampled luma of the current and reference pictures, indexed by level
+    int pyramid_stride[ME_PYRAMID_MAX_LEVELS + 1];
+    int16_t (*pyramid_mv[ME_PYRAMID_MAX_LEVELS + 1])[2]; /**< per block vectors in units of
+                                     * the level, mb_stride based; the blocks
+                                     * of level 1 are the macroblocks */
     int (*sub_motion_search)(struct MpegEncContext *s,
                              int *mx_ptr, int *my_ptr, int dmin,
                              int src_index, int ref_index,
@@ -116,6 +126,26 @@ void ff_estimate_b_frame_motion(struct MpegEncContext *s, int mb_x, int mb_y);
 int ff_pre_estimate_p_frame_motion(struct MpegEncContext *s,
                                    int mb_x, int mb_y);
 
+/**
+ * Allocate the buffers of the hierarchical pre-pass with s->me_pyramid
+ * levels, reduced if the picture is too small.
+ */
+int ff_me_pyramid_init(struct MpegEncContext *s);
+void ff_me_pyramid_free(struct MpegEncContext *s);
+
+/**
+ * Downsample the luma of the current and reference pictures for the
+ * macroblock rows of the slice context.
+ */
+void ff_me_pyramid_downsample(struct MpegEncContext *s);
+
+/**
+ * Search the blocks of level s->me.pyramid_level that start in the macroblock
+ * rows of the slice context, refining the vectors of the level above.
+ * All the slices of a level must be done before the next one is searched.
+ */
+void ff_me_pyramid_search(struct MpegEncContext *s);
+
 int ff_epzs_motion_search(struct MpegEncContext *s, int *mx_ptr, int *my_ptr,
                           int P[10][2], int src_index, int ref_index,
                           int16_t (*last_mv)[2], int ref_mv_scale, int size,
@@ -925,6 +925,10 @@ static av_always_inline int epzs_motion_search_internal(MpegEncContext * s, int
         CHECK_MV(P_TOP[0]     >>shift, P_TOP[1]     >>shift)
         CHECK_MV(P_TOPRIGHT[0]>>shift, P_TOPRIGHT[1]>>shift)
     }
+    if (c->pyramid_levels && s->pict_type == AV_PICTURE_TYPE_P && size == 0 && h == 16) {
+        const int16_t *mv = c->pyramid_mv[1][s->mb_x + s->mb_y * ref_mv_stride];
+        CHECK_CLIPPED_MV(2 * mv[0], 2 * mv[1])
+    }
     if(dmin>h*h*4){
         if(c->pre_pass){
             CHECK_CLIPPED_MV((last_mv[ref_mv_xy-1][0]*ref_mv_scale + (1<<15))>>16,
@@ -962,6 +962,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       MAX_PICTURE_COUNT * sizeof(Picture *), fail);
 
 
+    if (s->me_pyramid && ff_me_pyramid_init(s) < 0)
+        goto fail;
+
     if (s->noise_reduction) {
         FF_ALLOCZ_OR_GOTO(s->avctx, s->dct_offset,
                           2 * 64 * sizeof(uint16_t), fail);
@@ -1192,6 +1195,7 @@ av_cold int ff_mpv_encode_end(AVCodecContext *avctx)
     av_freep(&s->input_picture);
     av_freep(&s->reordered_input_picture);
     av_freep(&s->dct_offset);
+    ff_me_pyramid_free(s);
 
     return 0;
 }
@@ -2853,6 +2857,22 @@ static int pre_estimate_motion_thread(AVCodecContext *c, void *arg){
     return 0;
 }
 
+static int pyramid_downsample_thread(AVCodecContext *c, void *arg){
+    MpegEncContext *s= *(void**)arg;
+
+    ff_me_pyramid_downsample(s);
+
+    return 0;
+}
+
+static int pyramid_search_thread(AVCodecContext *c, void *arg){
+    MpegEncContext *s= *(void**)arg;
+
+    ff_me_pyramid_search(s);
+
+    return 0;
+}
+
 static int estimate_motion_thread(AVCodecContext *c, void *arg){
     MpegEncContext *s= *(void**)arg;
 
@@ -3814,6 +3834,17 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     if(s->pict_type != AV_PICTURE_TYPE_I){
         s->lambda  = (s->lambda  * s->me_penalty_compensation + 128) >> 8;
         s->lambda2 = (s->lambda2 * (int64_t) s->me_penalty_compensation + 128) >> 8;
+        if (s->pict_type != AV_PICTURE_TYPE_B && s->me.pyramid_levels) {
+            int level;
+
+            s->avctx->execute(s->avctx, pyramid_downsample_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+            /* each level refines the vectors of the whole level above */
+            for (level = s->me.pyramid_levels; level > 0; level--) {
+                for (i = 0; i < context_count; i++)
+                    s->thread_context[i]->me.pyramid_level = level;
+                s->avctx->execute(s->avctx, pyramid_search_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+            }
+        }
         if (s->pict_type != AV_PICTURE_TYPE_B) {
             if ((s->me_pre && s->last_non_b_pict_type == AV_PICTURE_TYPE_I) ||
                 s->me_pre == 2) {
@@ -36,6 +36,7 @@
 #include <zlib.h>
 
 #define IOBUF_SIZE 4096
+#define WINDOW_SIZE 32768
 
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
@@ -45,6 +46,24 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/**
+ * Rows of a frame deflated independently of the others, so that the slices
+ * can be compressed concurrently.
+ */
+typedef struct PNGEncSlice {
+    z_stream zstream;            ///< raw deflate stream, the first slice uses the one of the context
+    uint8_t *crow_base;
+    unsigned int crow_base_size;
+    uint8_t *dict;               ///< filtered rows preceding the slice
+    unsigned int dict_size;
+    uint8_t *buf;                ///< compressed data
+    unsigned int buf_size;
+    int size;
+    uLong adler;                 ///< Adler-32 of the filtered rows of the slice
+    uLong len;
+    int ret;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -57,6 +76,8 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+    PNGEncSlice *slices;
+    int nb_slices;
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -199,15 +220,12 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     if (!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
     if (pred == PNG_FILTER_VALUE_MIXED) {
-        int i;
         int cost, bcost = INT_MAX;
         uint8_t *buf1 = dst, *buf2 = dst + size + 16;
         for (pred = 0; pred < 5; pred++) {
             png_filter_row(s, buf1 + 1, pred, src, top, size, bpp);
             buf1[0] = pred;
-            cost = 0;
-            for (i = 0; i <= size; i++)
-                cost += abs((int8_t) buf1[i]);
+            cost = s->llvidencdsp.sum_abs_int8(buf1, size + 1);
             if (cost < bcost) {
                 bcost = cost;
                 FFSWAP(uint8_t *, buf1, buf2);
@@ -428,6 +446,132 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+static uint8_t *png_filter_frame_row(PNGEncContext *s, uint8_t *crow_buf,
+                                     const AVFrame *pict, int y, int row_size)
+{
+    uint8_t *ptr = pict->data[0] + y * pict->linesize[0];
+
+    return png_choose_filter(s, crow_buf, ptr, y ? ptr - pict->linesize[0] : NULL,
+                             row_size, s->bits_per_pixel >> 3);
+}
+
+/**
+ * Deflate the rows of a slice, primed with the last filtered rows of the
+ * previous slice and ended with a sync flush unless it is the last slice,
+ * so that the concatenated slices are a single zlib stream.
+ */
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s    = avctx->priv_data;
+    const AVFrame *pict = arg;
+    PNGEncSlice *sl     = &s->slices[jobnr];
+    z_stream *zstream   = jobnr ? &sl->zstream : &s->zstream;
+    int nb_slices = FFMIN(s->nb_slices, pict->height);
+    int y_start   = pict->height *  jobnr      / nb_slices;
+    int y_end     = pict->height * (jobnr + 1) / nb_slices;
+    int row_size  = (pict->width * s->bits_per_pixel + 7) >> 3;
+    int flush     = jobnr == nb_slices - 1 ? Z_FINISH : Z_SYNC_FLUSH;
+    uint8_t *crow_buf, *crow;
+    int y, ret;
+
+    av_fast_malloc(&sl->crow_base, &sl->crow_base_size,
+                   (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    if (!sl->crow_base) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    // pixel data should be aligned, but there's a control byte before it
+    crow_buf = sl->crow_base + 15;
+
+    if (y_start) {
+        int nb_rows = FFMIN(y_start, (WINDOW_SIZE + row_size) / (row_size + 1));
+        int len     = nb_rows * (row_size + 1);
+
+        av_fast_malloc(&sl->dict, &sl->dict_size, len);
+        if (!sl->dict) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (y = y_start - nb_rows; y < y_start; y++) {
+            crow = png_filter_frame_row(s, crow_buf, pict, y, row_size);
+            memcpy(sl->dict + (y - y_start + nb_rows) * (row_size + 1), crow, row_size + 1);
+        }
+        if (deflateSetDictionary(zstream, sl->dict + FFMAX(len - WINDOW_SIZE, 0),
+                                 FFMIN(len, WINDOW_SIZE)) != Z_OK) {
+            ret = -1;
+            goto end;
+        }
+    }
+
+    sl->len = (uLong)(y_end - y_start) * (row_size + 1);
+    /* room for a sync flush and for the Adler-32 of the stream */
+    av_fast_malloc(&sl->buf, &sl->buf_size, deflateBound(zstream, sl->len) + 64);
+    if (!sl->buf) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    zstream->next_out  = sl->buf;
+    zstream->avail_out = sl->buf_size;
+    sl->adler = adler32(0, NULL, 0);
+    for (y = y_start; y < y_end; y++) {
+        crow = png_filter_frame_row(s, crow_buf, pict, y, row_size);
+        sl->adler = adler32(sl->adler, crow, row_size + 1);
+        zstream->next_in  = crow;
+        zstream->avail_in = row_size + 1;
+        if (deflate(zstream, Z_NO_FLUSH) != Z_OK || zstream->avail_in) {
+            ret = -1;
+            goto end;
+        }
+    }
+    ret = deflate(zstream, flush);
+    if (ret != (flush == Z_FINISH ? Z_STREAM_END : Z_OK) || zstream->avail_out < 4) {
+        ret = -1;
+        goto end;
+    }
+    sl->size = zstream->next_out - sl->buf;
+    ret = 0;
+
+end:
+    deflateReset(zstream);
+    sl->ret = ret;
+    return ret;
+}
+
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int nb_slices = FFMIN(s->nb_slices, pict->height);
+    uLong adler = adler32(0, NULL, 0);
+    PNGEncSlice *sl;
+    int i, pos, len;
+
+    avctx->execute2(avctx, encode_slice, (void *)pict, NULL, nb_slices);
+
+    for (i = 0; i < nb_slices; i++) {
+        sl = &s->slices[i];
+        if (sl->ret < 0)
+            return sl->ret;
+        adler = adler32_combine(adler, sl->adler, sl->len);
+    }
+    /* the zlib trailer, the first slice has written the header */
+    sl = &s->slices[nb_slices - 1];
+    AV_WB32(sl->buf + sl->size, adler);
+    sl->size += 4;
+
+    for (i = 0; i < nb_slices; i++) {
+        sl = &s->slices[i];
+        for (pos = 0; pos < sl->size; pos += len) {
+            len = FFMIN(sl->size - pos, IOBUF_SIZE);
+            if (s->bytestream_end - s->bytestream <= len + 100) {
+                av_log(avctx, AV_LOG_ERROR, "Packet too small for slice %d\n", i);
+                return AVERROR(ENOSPC);
+            }
+            png_write_image_data(avctx, sl->buf + pos, len);
+        }
+    }
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -439,6 +583,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->nb_slices > 1 && pict->height > 1)
+        return encode_frame_slices(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -1092,14 +1239,47 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
 
+    /* the passes of an interlaced image are not split */
+    if (avctx->slices > 1 && !s->is_progressive) {
+        int i;
+
+        s->nb_slices = FFMIN(avctx->slices, avctx->height);
+        s->slices    = av_mallocz_array(s->nb_slices, sizeof(*s->slices));
+        if (!s->slices) {
+            s->nb_slices = 0;
+            return AVERROR(ENOMEM);
+        }
+        for (i = 1; i < s->nb_slices; i++) {
+            z_stream *zstream = &s->slices[i].zstream;
+
+            zstream->zalloc = ff_png_zalloc;
+            zstream->zfree  = ff_png_zfree;
+            zstream->opaque = NULL;
+            if (deflateInit2(zstream, compression_level, Z_DEFLATED, -15, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+        }
+    }
+
     return 0;
 }
 
 static av_cold int png_enc_close(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
+    int i;
 
     deflateEnd(&s->zstream);
+    for (i = 0; i < s->nb_slices; i++) {
+        PNGEncSlice *sl = &s->slices[i];
+        if (i)
+            deflateEnd(&sl->zstream);
+        av_freep(&sl->crow_base);
+        av_freep(&sl->dict);
+        av_freep(&sl->buf);
+    }
+    av_freep(&s->slices);
+    s->nb_slices = 0;
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1146,7 +1326,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -1167,7 +1348,7 @@ AVCodec ff_apng_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_apng,
-    .capabilities   = AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
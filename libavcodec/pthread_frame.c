@@ -44,6 +44,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 enum {
     ///< Set when the thread is awaiting a packet.
@@ -196,6 +197,8 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
 
         av_frame_unref(p->frame);
         p->got_frame = 0;
+        avctx->thread_stall_count = 0;
+        avctx->thread_stall_time  = 0;
         p->result = codec->decode(avctx, p->frame, &p->got_frame, &p->avpkt);
 
         if ((p->result < 0 || !p->got_frame) && p->frame->buf[0]) {
@@ -303,6 +306,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     if (for_user) {
         dst->delay       = src->thread_count - 1;
+        dst->thread_stall_count = src->thread_stall_count;
+        dst->thread_stall_time  = src->thread_stall_time;
 #if FF_API_CODED_FRAME
 FF_DISABLE_DEPRECATION_WARNINGS
         dst->coded_frame = src->coded_frame;
@@ -570,7 +575,9 @@ void ff_thread_report_progress(ThreadFrame *f, int n, int field)
         av_log(f->owner[field], AV_LOG_DEBUG,
                "%p finished %d field %d\n", progress, n, field);
 
-    atomic_store_explicit(&progress[field], n, memory_order_release);
+    /* the slice threads of the owner may report concurrently */
+    if (atomic_load_explicit(&progress[field], memory_order_relaxed) < n)
+        atomic_store_explicit(&progress[field], n, memory_order_release);
 
     pthread_cond_broadcast(&p->progress_cond);
     pthread_mutex_unlock(&p->progress_mutex);
@@ -596,6 +603,22 @@ void ff_thread_await_progress(ThreadFrame *f, int n, int field)
     pthread_mutex_unlock(&p->progress_mutex);
 }
 
+void ff_thread_await_progress_stat(AVCodecContext *avctx, ThreadFrame *f,
+                                   int n, int field)
+{
+    atomic_int *progress = f->progress ? (atomic_int*)f->progress->data : NULL;
+    int64_t start;
+
+    if (!progress ||
+        atomic_load_explicit(&progress[field], memory_order_acquire) >= n)
+        return;
+
+    start = av_gettime_relative();
+    ff_thread_await_progress(f, n, field);
+    avctx->thread_stall_count++;
+    avctx->thread_stall_time += av_gettime_relative() - start;
+}
+
 void ff_thread_finish_setup(AVCodecContext *avctx) {
     PerThreadContext *p = avctx->internal->thread_ctx;
 
@@ -799,6 +822,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         }
         *copy->internal = *src->internal;
         copy->internal->thread_ctx = p;
+        copy->internal->slice_thread_ctx = NULL;
         copy->internal->last_pkt_props = &p->avpkt;
 
         if (!i) {
@@ -64,10 +64,10 @@ typedef struct SliceThreadContext {
 static void* attribute_align_arg worker(void *v)
 {
     AVCodecContext *avctx = v;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     unsigned last_execute = 0;
     int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
+    int thread_count = c->thread_count;
     int self_id;
 
     pthread_mutex_lock(&c->current_job_lock);
@@ -102,20 +102,20 @@ static void* attribute_align_arg worker(void *v)
 
 void ff_slice_thread_free(AVCodecContext *avctx)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int i;
 
     pthread_mutex_lock(&c->current_job_lock);
     c->done = 1;
     pthread_cond_broadcast(&c->current_job_cond);
-    for (i = 0; i < c->thread_count; i++)
+    for (i = 0; c->progress_cond && i < c->thread_count; i++)
         pthread_cond_broadcast(&c->progress_cond[i]);
     pthread_mutex_unlock(&c->current_job_lock);
 
-    for (i=0; i<avctx->thread_count; i++)
+    for (i=0; i<c->thread_count; i++)
          pthread_join(c->workers[i], NULL);
 
-    for (i = 0; i < c->thread_count; i++) {
+    for (i = 0; c->progress_mutex && i < c->thread_count; i++) {
         pthread_mutex_destroy(&c->progress_mutex[i]);
         pthread_cond_destroy(&c->progress_cond[i]);
     }
@@ -129,7 +129,9 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&c->progress_cond);
 
     av_freep(&c->workers);
-    av_freep(&avctx->internal->thread_ctx);
+    if (avctx->internal->thread_ctx == c)
+        avctx->internal->thread_ctx = NULL;
+    av_freep(&avctx->internal->slice_thread_ctx);
 }
 
 static av_always_inline void thread_park_workers(SliceThreadContext *c, int thread_count)
@@ -141,9 +143,9 @@ static av_always_inline void thread_park_workers(SliceThreadContext *c, int thre
 
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
 
-    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+    if (!c || c->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
 
     if (job_count <= 0)
@@ -151,7 +153,7 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
 
     pthread_mutex_lock(&c->current_job_lock);
 
-    c->current_job = avctx->thread_count;
+    c->current_job = c->thread_count;
     c->job_count = job_count;
     c->job_size = job_size;
     c->args = arg;
@@ -160,22 +162,65 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     c->current_execute++;
     pthread_cond_broadcast(&c->current_job_cond);
 
-    thread_park_workers(c, avctx->thread_count);
+    thread_park_workers(c, c->thread_count);
 
     return 0;
 }
 
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+
+    if (!c || c->thread_count <= 1)
+        return avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+
     c->func2 = func2;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
-int ff_slice_thread_init(AVCodecContext *avctx)
+static int slice_thread_init(AVCodecContext *avctx, int thread_count)
 {
     int i;
     SliceThreadContext *c;
+
+    c = av_mallocz(sizeof(SliceThreadContext));
+    if (!c)
+        return -1;
+
+    c->workers = av_mallocz_array(thread_count, sizeof(pthread_t));
+    if (!c->workers) {
+        av_free(c);
+        return -1;
+    }
+
+    avctx->internal->slice_thread_ctx = c;
+    c->thread_count = thread_count;
+    c->current_job = 0;
+    c->job_count = 0;
+    c->job_size = 0;
+    c->done = 0;
+    pthread_cond_init(&c->current_job_cond, NULL);
+    pthread_cond_init(&c->last_job_cond, NULL);
+    pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_lock(&c->current_job_lock);
+    for (i=0; i<thread_count; i++) {
+        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
+           c->thread_count = i;
+           pthread_mutex_unlock(&c->current_job_lock);
+           ff_slice_thread_free(avctx);
+           return -1;
+        }
+    }
+
+    thread_park_workers(c, thread_count);
+
+    avctx->execute = thread_execute;
+    avctx->execute2 = thread_execute2;
+    return 0;
+}
+
+int ff_slice_thread_init(AVCodecContext *avctx)
+{
     int thread_count = avctx->thread_count;
 
 #if HAVE_W32THREADS
@@ -199,49 +244,49 @@ int ff_slice_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = 1;
     }
 
+    // The FLAC encoder runs one job per channel, more threads would stay idle
+    if (av_codec_is_encoder(avctx->codec) &&
+        avctx->codec_id == AV_CODEC_ID_FLAC &&
+        avctx->channels > 0 && thread_count > avctx->channels)
+        thread_count = avctx->thread_count = avctx->channels;
+
     if (thread_count <= 1) {
         avctx->active_thread_type = 0;
         return 0;
     }
 
-    c = av_mallocz(sizeof(SliceThreadContext));
-    if (!c)
-        return -1;
-
-    c->workers = av_mallocz_array(thread_count, sizeof(pthread_t));
-    if (!c->workers) {
-        av_free(c);
+    if (slice_thread_init(avctx, thread_count) < 0) {
+        avctx->thread_count = 1;
         return -1;
     }
 
-    avctx->internal->thread_ctx = c;
-    c->current_job = 0;
-    c->job_count = 0;
-    c->job_size = 0;
-    c->done = 0;
-    pthread_cond_init(&c->current_job_cond, NULL);
-    pthread_cond_init(&c->last_job_cond, NULL);
-    pthread_mutex_init(&c->current_job_lock, NULL);
-    pthread_mutex_lock(&c->current_job_lock);
-    for (i=0; i<thread_count; i++) {
-        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
-           pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
-           return -1;
-        }
-    }
+    avctx->internal->thread_ctx = avctx->internal->slice_thread_ctx;
+    return 0;
+}
 
-    thread_park_workers(c, thread_count);
+int ff_frame_thread_init_slices(AVCodecContext *avctx, int thread_count)
+{
+    int ret;
 
-    avctx->execute = thread_execute;
-    avctx->execute2 = thread_execute2;
-    return 0;
+    av_assert0(avctx->active_thread_type & FF_THREAD_FRAME);
+
+    if (thread_count <= 1)
+        return 0;
+
+    ret = slice_thread_init(avctx, thread_count);
+    return ret < 0 ? AVERROR(ENOMEM) : thread_count;
+}
+
+void ff_frame_thread_free_slices(AVCodecContext *avctx)
+{
+    if (avctx->internal->slice_thread_ctx &&
+        avctx->internal->slice_thread_ctx != avctx->internal->thread_ctx)
+        ff_slice_thread_free(avctx);
 }
 
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     int *entries = p->entries;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
@@ -252,7 +297,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = avctx->internal->slice_thread_ctx;
     int *entries      = p->entries;
 
     if (!entries || !field) return;
@@ -270,15 +315,10 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 {
     int i;
 
-    if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
-
-        if (p->entries) {
-            av_assert0(p->thread_count == avctx->thread_count);
-            av_freep(&p->entries);
-        }
+    if (avctx->internal->slice_thread_ctx) {
+        SliceThreadContext *p = avctx->internal->slice_thread_ctx;
 
-        p->thread_count  = avctx->thread_count;
+        av_freep(&p->entries);
         p->entries       = av_mallocz_array(count, sizeof(int));
 
         if (!p->progress_mutex) {
@@ -305,6 +345,6 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
@@ -97,6 +97,15 @@ void ff_thread_report_progress(ThreadFrame *f, int progress, int field);
  */
 void ff_thread_await_progress(ThreadFrame *f, int progress, int field);
 
+/**
+ * Same as ff_thread_await_progress(), but if the calling thread has to block,
+ * count it in the thread_stall_count and thread_stall_time fields of avctx.
+ *
+ * @param avctx The context of the calling decoding thread.
+ */
+void ff_thread_await_progress_stat(AVCodecContext *avctx, ThreadFrame *f,
+                                   int progress, int field);
+
 /**
  * Wrapper around get_format() for frame-multithreaded codecs.
  * Call this function instead of avctx->get_format().
@@ -135,6 +144,24 @@ int ff_thread_ref_frame(ThreadFrame *dst, ThreadFrame *src);
 int ff_thread_init(AVCodecContext *s);
 void ff_thread_free(AVCodecContext *s);
 
+/**
+ * Start slice threads for a frame thread, so that the codec can also split
+ * the frame it decodes with avctx->execute()/execute2() and the
+ * ff_thread_*_progress2() functions, as in slice threading mode.
+ * To be called from the init() and init_thread_copy() callbacks.
+ *
+ * @param thread_count number of slice threads for this frame thread
+ * @return the number of slice threads started, 0 if the frame is decoded
+ *         in a single thread, or a negative error code
+ */
+int ff_frame_thread_init_slices(AVCodecContext *avctx, int thread_count);
+
+/**
+ * Stop the slice threads started by ff_frame_thread_init_slices(), if any.
+ * To be called from the close() callback.
+ */
+void ff_frame_thread_free_slices(AVCodecContext *avctx);
+
 int ff_alloc_entries(AVCodecContext *avctx, int count);
 void ff_reset_entries(AVCodecContext *avctx);
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n);
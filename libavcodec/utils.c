@@ -2230,11 +2230,25 @@ void ff_thread_await_progress(ThreadFrame *f, int progress, int field)
 {
 }
 
+void ff_thread_await_progress_stat(AVCodecContext *avctx, ThreadFrame *f,
+                                   int progress, int field)
+{
+}
+
 int ff_thread_can_start_frame(AVCodecContext *avctx)
 {
     return 1;
 }
 
+int ff_frame_thread_init_slices(AVCodecContext *avctx, int thread_count)
+{
+    return 0;
+}
+
+void ff_frame_thread_free_slices(AVCodecContext *avctx)
+{
+}
+
 int ff_alloc_entries(AVCodecContext *avctx, int count)
 {
     return 0;
@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include "libavutil/float_dsp.h"
+#include "libavutil/x86/asm.h"
 #include "libavutil/x86/cpu.h"
 #include "libavcodec/aacenc.h"
 
@@ -31,6 +32,82 @@ void ff_aac_quantize_bands_sse2(int *out, const float *in, const float *scaled,
                                 int size, int is_signed, int maxval, const float Q34,
                                 const float rounding);
 
+#if HAVE_AVX_INLINE
+/*
+ * The sizes are multiples of 4, the rows are processed by 8 from their end
+ * with a negative offset, and an odd group of 4 is left in a last xmm step.
+ * Only float instructions are used, in the order of the C versions, so that
+ * the results are the same.
+ */
+#define AVX_ROWS(STEP)                                  \
+    "add             $32, %[i]                  \n\t"   \
+    "jg               2f                        \n\t"   \
+    "1:                                         \n\t"   \
+    STEP("ymm", -32)                                    \
+    "add             $32, %[i]                  \n\t"   \
+    "jle              1b                        \n\t"   \
+    "2:                                         \n\t"   \
+    "sub             $32, %[i]                  \n\t"   \
+    "jz               3f                        \n\t"   \
+    STEP("xmm", 0)                                      \
+    "3:                                         \n\t"   \
+    "vzeroupper                                 \n\t"
+
+#define ABS_POW34_STEP(r, off)                                          \
+    "vandps "#off"(%[in], %[i]), %%"r"2, %%"r"0    \n\t"                \
+    "vsqrtps         %%"r"0, %%"r"1                \n\t"                \
+    "vmulps  %%"r"1, %%"r"0, %%"r"0                \n\t"                \
+    "vsqrtps         %%"r"0, %%"r"0                \n\t"                \
+    "vmovups %%"r"0, "#off"(%[out], %[i])          \n\t"
+
+static void abs_pow34_avx(float *out, const float *in, const int size)
+{
+    static const uint32_t abs_mask = 0x7fffffff;
+    x86_reg i = -4 * (x86_reg)size;
+
+    __asm__ volatile (
+        "vbroadcastss %[mask], %%ymm2              \n\t"
+        AVX_ROWS(ABS_POW34_STEP)
+        : [i]"+&r"(i)
+        : [out]"r"(out + size), [in]"r"(in + size), [mask]"m"(abs_mask)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2",) "memory"
+    );
+}
+
+/* the sign bit of the input is set before the conversion, which truncates */
+#define QUANTIZE_BANDS_STEP(r, off)                                     \
+    "vmulps "#off"(%[scaled], %[i]), %%"r"0, %%"r"2 \n\t"               \
+    "vaddps  %%"r"1, %%"r"2, %%"r"2                \n\t"                \
+    "vminps  %%"r"3, %%"r"2, %%"r"2                \n\t"                \
+    "vandps "#off"(%[in], %[i]), %%"r"4, %%"r"5    \n\t"                \
+    "vorps   %%"r"5, %%"r"2, %%"r"2                \n\t"                \
+    "vcvttps2dq      %%"r"2, %%"r"2                \n\t"                \
+    "vmovups %%"r"2, "#off"(%[out], %[i])          \n\t"
+
+static void quantize_bands_avx(int *out, const float *in, const float *scaled,
+                               int size, int is_signed, int maxval, const float Q34,
+                               const float rounding)
+{
+    const float fmaxval = maxval;
+    const uint32_t sign_mask = is_signed ? 0x80000000 : 0;
+    x86_reg i = -4 * (x86_reg)size;
+
+    __asm__ volatile (
+        "vbroadcastss  %[Q34], %%ymm0              \n\t"
+        "vbroadcastss  %[rounding], %%ymm1         \n\t"
+        "vbroadcastss  %[maxval], %%ymm3           \n\t"
+        "vbroadcastss  %[sign], %%ymm4             \n\t"
+        AVX_ROWS(QUANTIZE_BANDS_STEP)
+        : [i]"+&r"(i)
+        : [out]"r"(out + size), [in]"r"(in + size), [scaled]"r"(scaled + size),
+          [Q34]"m"(Q34), [rounding]"m"(rounding), [maxval]"m"(fmaxval),
+          [sign]"m"(sign_mask)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",)
+          "memory"
+    );
+}
+#endif /* HAVE_AVX_INLINE */
+
 av_cold void ff_aac_dsp_init_x86(AACEncContext *s)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -40,4 +117,11 @@ av_cold void ff_aac_dsp_init_x86(AACEncContext *s)
 
     if (EXTERNAL_SSE2(cpu_flags))
         s->quant_bands = ff_aac_quantize_bands_sse2;
+
+#if HAVE_AVX_INLINE
+    if (INLINE_AVX_FAST(cpu_flags)) {
+        s->abs_pow34   = abs_pow34_avx;
+        s->quant_bands = quantize_bands_avx;
+    }
+#endif
 }
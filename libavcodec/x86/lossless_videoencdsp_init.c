@@ -28,6 +28,7 @@
 #include "libavutil/x86/cpu.h"
 #include "libavcodec/lossless_videoencdsp.h"
 #include "libavcodec/mathops.h"
+#include "libavcodec/x86/constants.h"
 
 void ff_diff_bytes_mmx(uint8_t *dst, const uint8_t *src1, const uint8_t *src2,
                        intptr_t w);
@@ -78,6 +79,37 @@ static void sub_median_pred_mmxext(uint8_t *dst, const uint8_t *src1,
     *left     = src2[w - 1];
 }
 
+static int sum_abs_int8_sse2(const uint8_t *src, intptr_t w)
+{
+    x86_reg i = 0, n = w & ~15;
+    int sum = 0;
+
+    /* src ^ 0x80 is src + 128 as unsigned, so its distance to 0x80 is |src| */
+    if (n) {
+        __asm__ volatile (
+            "movdqa %[pb_80], %%xmm2            \n\t"
+            "pxor %%xmm3, %%xmm3                \n\t"
+            "1:                                 \n\t"
+            "movdqu (%[src], %[i]), %%xmm0      \n\t"
+            "pxor %%xmm2, %%xmm0                \n\t"
+            "psadbw %%xmm2, %%xmm0              \n\t"
+            "paddq %%xmm0, %%xmm3               \n\t"
+            "add $16, %[i]                      \n\t"
+            "cmp %[n], %[i]                     \n\t"
+            " jb 1b                             \n\t"
+            "movhlps %%xmm3, %%xmm0             \n\t"
+            "paddq %%xmm0, %%xmm3               \n\t"
+            "movd %%xmm3, %[sum]                \n\t"
+            : [i]"+&r"(i), [sum]"=r"(sum)
+            : [src]"r"(src), [n]"r"(n), [pb_80]"m"(ff_pb_80)
+            : XMM_CLOBBERS("%xmm0", "%xmm2", "%xmm3",) "memory");
+    }
+    for (; i < w; i++)
+        sum += FFABS((int8_t)src[i]);
+
+    return sum;
+}
+
 #endif /* HAVE_INLINE_ASM */
 
 av_cold void ff_llvidencdsp_init_x86(LLVidEncDSPContext *c)
@@ -92,6 +124,9 @@ av_cold void ff_llvidencdsp_init_x86(LLVidEncDSPContext *c)
     if (INLINE_MMXEXT(cpu_flags)) {
         c->sub_median_pred = sub_median_pred_mmxext;
     }
+    if (INLINE_SSE2(cpu_flags)) {
+        c->sum_abs_int8 = sum_abs_int8_sse2;
+    }
 #endif /* HAVE_INLINE_ASM */
 
     if (EXTERNAL_SSE2(cpu_flags)) {
@@ -188,9 +188,32 @@ int avfilter_link_get_channels(AVFilterLink *link)
     return link->channels;
 }
 
+/**
+ * Filters activated in parallel never share a link, but they can update
+ * the same neighbour: lock while doing so.
+ */
+static int lock_neighbour(AVFilterContext *filter)
+{
+    AVFilterGraphInternal *gi = filter->graph ? filter->graph->internal : NULL;
+
+    if (!gi || !gi->parallel)
+        return 0;
+    ff_mutex_lock(&gi->parallel_lock);
+    return 1;
+}
+
+static void unlock_neighbour(AVFilterContext *filter, int locked)
+{
+    if (locked)
+        ff_mutex_unlock(&filter->graph->internal->parallel_lock);
+}
+
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
+    int locked = lock_neighbour(filter);
+
     filter->ready = FFMAX(filter->ready, priority);
+    unlock_neighbour(filter, locked);
 }
 
 /**
@@ -199,10 +222,12 @@ void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
  */
 static void filter_unblock(AVFilterContext *filter)
 {
+    int locked = lock_neighbour(filter);
     unsigned i;
 
     for (i = 0; i < filter->nb_outputs; i++)
         filter->outputs[i]->frame_blocked_in = 0;
+    unlock_neighbour(filter, locked);
 }
 
 
@@ -530,7 +555,8 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
     link->current_pts = pts;
     link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
-    if (link->graph && link->age_index >= 0)
+    /* the heap is rebuilt after filters are activated in parallel */
+    if (link->graph && link->age_index >= 0 && !link->graph->internal->parallel)
         ff_avfilter_graph_update_heap(link->graph, link);
 }
 
@@ -676,8 +702,8 @@ static const AVClass avfilter_class = {
     .option           = avfilter_options,
 };
 
-static int default_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg,
-                           int *ret, int nb_jobs)
+int ff_filter_execute_default(AVFilterContext *ctx, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs)
 {
     int i;
 
@@ -718,7 +744,7 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
     ret->internal = av_mallocz(sizeof(*ret->internal));
     if (!ret->internal)
         goto err;
-    ret->internal->execute = default_execute;
+    ret->internal->execute = ff_filter_execute_default;
 
     ret->nb_inputs = avfilter_pad_count(filter->inputs);
     if (ret->nb_inputs ) {
@@ -1557,6 +1583,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
     if (av_frame_is_writable(frame))
         return 0;
     av_log(link->dst, AV_LOG_DEBUG, "Copying data in avfilter.\n");
+    ff_filter_account_copy(link->dst, frame);
 
     switch (link->type) {
     case AVMEDIA_TYPE_VIDEO:
@@ -1630,6 +1657,52 @@ int ff_inlink_evaluate_timeline_at_frame(AVFilterLink *link, const AVFrame *fram
     return fabs(av_expr_eval(dstctx->enable, dstctx->var_values, NULL)) >= 0.5;
 }
 
+void ff_inlink_request_border(AVFilterLink *link, int left, int top,
+                              int right, int bottom)
+{
+    av_assert1(link->type == AVMEDIA_TYPE_VIDEO);
+    link->border[0] = FFMAX(left,   0);
+    link->border[1] = FFMAX(top,    0);
+    link->border[2] = FFMAX(right,  0);
+    link->border[3] = FFMAX(bottom, 0);
+}
+
+void ff_link_get_border(AVFilterLink *link, int border[4])
+{
+    for (;;) {
+        AVFilterContext *dst = link->dst;
+        AVFilterLink *next;
+
+        if (link->border[0] || link->border[1] ||
+            link->border[2] || link->border[3] ||
+            !dst || dst->nb_inputs != 1 || dst->nb_outputs != 1 ||
+            link->dstpad->get_video_buffer != ff_null_get_video_buffer)
+            break;
+
+        next = dst->outputs[0];
+        if (!next || next->w != link->w || next->h != link->h ||
+            next->format != link->format)
+            break;
+        link = next;
+    }
+    memcpy(border, link->border, sizeof(link->border));
+}
+
+void ff_filter_account_copy(AVFilterContext *ctx, const AVFrame *frame)
+{
+    int size;
+
+    if (frame->nb_samples)
+        size = av_samples_get_buffer_size(NULL, frame->channels,
+                                          frame->nb_samples, frame->format, 1);
+    else
+        size = av_image_get_buffer_size(frame->format, frame->width,
+                                        frame->height, 1);
+    if (size > 0)
+        atomic_fetch_add_explicit(&ctx->graph->internal->copied_bytes, size,
+                                  memory_order_relaxed);
+}
+
 void ff_inlink_request_frame(AVFilterLink *link)
 {
     av_assert1(!link->status_in);
@@ -317,6 +317,12 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate several filters of a graph concurrently, as long as they are not
+ * linked to each other. Only meaningful in AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -611,6 +617,12 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Room around the pictures requested by the destination filter, see
+     * ff_inlink_request_border().
+     */
+    int border[4];
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -852,7 +864,10 @@ typedef struct AVFilterGraph {
      * of AVFILTER_THREAD_* flags.
      *
      * May be set by the caller at any point, the setting will apply to all
-     * filters initialized after that. The default is allowing everything.
+     * filters initialized after that. The default is AVFILTER_THREAD_SLICE.
+     *
+     * With AVFILTER_THREAD_GRAPH, filters whose inputs are ready at the same
+     * time are run in parallel; the output does not depend on it.
      *
      * When a filter in this graph is initialized, this field is combined using
      * bit AND with AVFilterContext.thread_type to get the final mask used for
@@ -47,6 +47,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -92,6 +93,8 @@ AVFilterGraph *avfilter_graph_alloc(void)
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
+    ff_mutex_init(&ret->internal->parallel_lock, NULL);
+    atomic_init(&ret->internal->copied_bytes, 0);
 
     return ret;
 }
@@ -124,6 +127,8 @@ void avfilter_graph_free(AVFilterGraph **graph)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_mutex_destroy(&(*graph)->internal->parallel_lock);
+    av_freep(&(*graph)->internal->jobs);
 
     av_freep(&(*graph)->sink_links);
 
@@ -1435,6 +1440,104 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+typedef struct FFGraphJob {
+    AVFilterContext *filter;
+    avfilter_execute_func *execute;
+    int ret;
+} FFGraphJob;
+
+static int filters_linked(AVFilterContext *a, AVFilterContext *b)
+{
+    unsigned i;
+
+    for (i = 0; i < a->nb_inputs; i++)
+        if (a->inputs[i] && a->inputs[i]->src == b)
+            return 1;
+    for (i = 0; i < a->nb_outputs; i++)
+        if (a->outputs[i] && a->outputs[i]->dst == b)
+            return 1;
+    return 0;
+}
+
+static int activate_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FFGraphJob *job = (FFGraphJob *)arg + jobnr;
+
+    job->ret = ff_filter_activate(job->filter);
+    return job->ret;
+}
+
+static void heap_rebuild(AVFilterGraph *graph)
+{
+    int i;
+
+    for (i = graph->sink_links_count / 2 - 1; i >= 0; i--)
+        heap_bubble_down(graph, graph->sink_links[i], i);
+}
+
+/**
+ * Activate filter together with the other ready filters that share no link
+ * with it nor with each other, on the graph worker threads.
+ *
+ * Filters only exchange data through the frame queues of the links, which
+ * have a single reader and a single writer, and the set of filters run
+ * together only depends on the ready flags: the result is the same as
+ * when activating them one after the other.
+ */
+static int run_parallel(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    FFGraphJob *jobs;
+    int nb_jobs = 1, sinks = 0, i, j;
+
+    if (!gi->jobs) {
+        gi->jobs = av_malloc_array(graph->nb_threads, sizeof(*gi->jobs));
+        if (!gi->jobs)
+            return AVERROR(ENOMEM);
+    }
+    jobs = gi->jobs;
+
+    jobs[0].filter = filter;
+    for (i = 0; i < graph->nb_filters && nb_jobs < graph->nb_threads; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!f->ready || f == filter)
+            continue;
+        for (j = 0; j < nb_jobs; j++)
+            if (filters_linked(f, jobs[j].filter))
+                break;
+        if (j == nb_jobs)
+            jobs[nb_jobs++].filter = f;
+    }
+    if (nb_jobs == 1)
+        return ff_filter_activate(filter);
+
+    /* the worker threads are busy: run the slice jobs of the filters in
+     * their own thread */
+    for (j = 0; j < nb_jobs; j++) {
+        AVFilterContext *f = jobs[j].filter;
+
+        jobs[j].execute = f->internal->execute;
+        f->internal->execute = ff_filter_execute_default;
+        for (i = 0; i < f->nb_inputs; i++)
+            sinks |= f->inputs[i] && f->inputs[i]->age_index >= 0;
+    }
+
+    gi->parallel = 1;
+    gi->thread_execute(filter, activate_job, jobs, NULL, nb_jobs);
+    gi->parallel = 0;
+
+    for (j = 0; j < nb_jobs; j++)
+        jobs[j].filter->internal->execute = jobs[j].execute;
+    if (sinks)
+        heap_rebuild(graph);
+
+    for (j = 0; j < nb_jobs; j++)
+        if (jobs[j].ret < 0)
+            return jobs[j].ret;
+    return 0;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
@@ -1447,5 +1550,8 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH &&
+        graph->internal->thread_execute && graph->nb_threads > 1)
+        return run_parallel(graph, filter);
     return ff_filter_activate(filter);
 }
@@ -294,6 +294,14 @@ unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
+void av_buffersrc_get_border(AVFilterContext *buffer_src, int border[4])
+{
+    memset(border, 0, 4 * sizeof(*border));
+    if (buffer_src->nb_outputs && buffer_src->outputs[0] &&
+        buffer_src->outputs[0]->type == AVMEDIA_TYPE_VIDEO)
+        ff_link_get_border(buffer_src->outputs[0], border);
+}
+
 #define OFFSET(x) offsetof(BufferSourceContext, x)
 #define A AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_AUDIO_PARAM
 #define V AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
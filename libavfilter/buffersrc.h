@@ -63,6 +63,21 @@ enum {
  */
 unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src);
 
+/**
+ * Get the room around the pictures that the filters following a video buffer
+ * source can use to process frames in place, e.g. the borders added by the
+ * pad filter. Frames added with at least that much allocated memory around
+ * their data, within the same buffers and linesizes, are then not copied.
+ *
+ * Only valid after the graph has been configured. The room is given in
+ * pixels of the first plane; for subsampled planes, it must be rounded up
+ * to whole chroma samples.
+ *
+ * @param border set to the room on the left, top, right and bottom,
+ *               all 0 if none was requested
+ */
+void av_buffersrc_get_border(AVFilterContext *buffer_src, int border[4]);
+
 /**
  * This structure contains the parameters describing the frames that will be
  * passed to this filter.
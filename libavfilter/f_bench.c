@@ -21,6 +21,7 @@
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
+#include "video.h"
 
 enum BenchAction {
     ACTION_START,
@@ -33,6 +34,7 @@ typedef struct {
     int action;
     int64_t max, min;
     int64_t sum;
+    int64_t copied_sum;
     int n;
 } BenchContext;
 
@@ -46,6 +48,7 @@ static const AVOption filt_name##_options[] = {
 }
 
 #define START_TIME_KEY "lavfi.bench.start_time"
+#define START_COPIED_KEY "lavfi.bench.start_copied"
 #define T2F(v) ((v) / 1000000.)
 
 static av_cold int init(AVFilterContext *ctx)
@@ -62,25 +65,33 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     BenchContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     const int64_t t = av_gettime();
+    const int64_t copied = atomic_load_explicit(&ctx->graph->internal->copied_bytes,
+                                                memory_order_relaxed);
 
     if (t < 0)
         return ff_filter_frame(outlink, in);
 
     if (s->action == ACTION_START) {
         av_dict_set_int(&in->metadata, START_TIME_KEY, t, 0);
+        av_dict_set_int(&in->metadata, START_COPIED_KEY, copied, 0);
     } else if (s->action == ACTION_STOP) {
         AVDictionaryEntry *e = av_dict_get(in->metadata, START_TIME_KEY, NULL, 0);
+        AVDictionaryEntry *c = av_dict_get(in->metadata, START_COPIED_KEY, NULL, 0);
         if (e) {
             const int64_t start = strtoll(e->value, NULL, 0);
             const int64_t diff = t - start;
+            const int64_t copied_diff = c ? copied - strtoll(c->value, NULL, 0) : 0;
             s->sum += diff;
+            s->copied_sum += copied_diff;
             s->n++;
             s->min = FFMIN(s->min, diff);
             s->max = FFMAX(s->max, diff);
-            av_log(s, AV_LOG_INFO, "t:%f avg:%f max:%f min:%f\n",
-                   T2F(diff), T2F(s->sum / s->n), T2F(s->max), T2F(s->min));
+            av_log(s, AV_LOG_INFO, "t:%f avg:%f max:%f min:%f copied:%"PRId64" avg_copied:%"PRId64"\n",
+                   T2F(diff), T2F(s->sum / s->n), T2F(s->max), T2F(s->min),
+                   copied_diff, s->copied_sum / s->n);
         }
         av_dict_set(&in->metadata, START_TIME_KEY, NULL, 0);
+        av_dict_set(&in->metadata, START_COPIED_KEY, NULL, 0);
     }
 
     return ff_filter_frame(outlink, in);
@@ -92,9 +103,10 @@ AVFILTER_DEFINE_CLASS(bench);
 
 static const AVFilterPad bench_inputs[] = {
     {
-        .name         = "default",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .filter_frame = filter_frame,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .get_video_buffer = ff_null_get_video_buffer,
+        .filter_frame     = filter_frame,
     },
     { NULL }
 };
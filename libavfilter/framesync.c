@@ -257,6 +257,7 @@ int ff_framesync_get_frame(FFFrameSync *fs, unsigned in, AVFrame **rframe,
                 av_frame_free(&frame);
                 return ret;
             }
+            ff_filter_account_copy(fs->parent, frame);
         } else {
             fs->in[in].frame = NULL;
         }
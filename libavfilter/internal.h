@@ -24,7 +24,10 @@
  * internal API functions
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "formats.h"
@@ -149,6 +152,21 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Set while several filters are activated concurrently; the fields
+     * they may all write to in a common neighbour are then protected by
+     * parallel_lock.
+     */
+    int parallel;
+    AVMutex parallel_lock;
+    struct FFGraphJob *jobs;    ///< filters activated together, nb_threads entries
+
+    /**
+     * Number of bytes of frame data copied by the filters of the graph,
+     * see ff_filter_account_copy().
+     */
+    atomic_int_least64_t copied_bytes;
 };
 
 struct AVFilterInternal {
@@ -392,6 +410,12 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * Execute the jobs one after the other in the calling thread.
+ */
+int ff_filter_execute_default(AVFilterContext *ctx, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs);
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -419,4 +443,32 @@ static inline int ff_norm_qscale(int qscale, int type)
  */
 int ff_filter_get_nb_threads(AVFilterContext *ctx);
 
+/**
+ * Request room around the pictures arriving on a video input link, so that
+ * the filter can extend them in place instead of copying them, as the
+ * get_video_buffer() callbacks allow for frames allocated in the graph.
+ * Sources which allocate frames outside of libavfilter can honour it too,
+ * see av_buffersrc_get_border().
+ *
+ * Must be called from the config_props() callback of the input pad.
+ *
+ * @param left,top,right,bottom room in pixels of the first plane
+ */
+void ff_inlink_request_border(AVFilterLink *link, int left, int top,
+                              int right, int bottom);
+
+/**
+ * Get the room requested on a link with ff_inlink_request_border(), looking
+ * through the filters which pass their input frames on as they are.
+ *
+ * @param border set to the left, top, right and bottom room
+ */
+void ff_link_get_border(AVFilterLink *link, int border[4]);
+
+/**
+ * Account for the data of a frame being copied by a filter, in the
+ * statistics reported by the bench filter.
+ */
+void ff_filter_account_copy(AVFilterContext *ctx, const AVFrame *frame);
+
 #endif /* AVFILTER_INTERNAL_H */
@@ -32,6 +32,9 @@
 #include "libavutil/rational.h"
 #include "libavutil/stereo3d.h"
 
+#define FF_INTERNAL_FIELDS 1
+#include "framequeue.h"
+
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
@@ -297,6 +300,10 @@ static int request_frame(AVFilterLink *outlink)
             ret = ff_request_frame(ctx->inputs[i]);
             if (ret < 0)
                 return ret;
+        } else if (ctx->inputs[i]->status_in && !ctx->inputs[i]->status_out) {
+            /* acknowledge the end of this input, the pending view can still
+             * be paired with a frame from the other one */
+            ff_request_frame(ctx->inputs[i]);
         }
     }
     return 0;
@@ -39,6 +39,7 @@
 #include "dualinput.h"
 #include "drawutils.h"
 #include "video.h"
+#include "vf_overlay.h"
 
 static const char *const var_names[] = {
     "main_w",    "W", ///< width  of the main    video
@@ -98,15 +99,6 @@ enum EvalMode {
     EVAL_MODE_NB
 };
 
-enum OverlayFormat {
-    OVERLAY_FORMAT_YUV420,
-    OVERLAY_FORMAT_YUV422,
-    OVERLAY_FORMAT_YUV444,
-    OVERLAY_FORMAT_RGB,
-    OVERLAY_FORMAT_GBRP,
-    OVERLAY_FORMAT_NB
-};
-
 typedef struct OverlayContext {
     const AVClass *class;
     int x, y;                   ///< position of overlaid picture
@@ -119,6 +111,7 @@ typedef struct OverlayContext {
     uint8_t overlay_rgba_map[4];
     uint8_t overlay_has_alpha;
     int format;                 ///< OverlayFormat
+    int alpha_format;           ///< OverlayAlphaFormat
     int eval_mode;              ///< EvalMode
 
     FFDualInputContext dinput;
@@ -135,9 +128,16 @@ typedef struct OverlayContext {
 
     AVExpr *x_pexpr, *y_pexpr;
 
-    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y);
+    OverlayDSPContext dsp;
+
+    int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 } OverlayContext;
 
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} ThreadData;
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -376,7 +376,7 @@ static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     OverlayContext *s = ctx->priv;
-    int ret;
+    int ret, alpha_pos = -1;
 
     if ((ret = ff_dualinput_init(ctx, &s->dinput)) < 0)
         return ret;
@@ -385,6 +385,11 @@ static int config_output(AVFilterLink *outlink)
     outlink->h = ctx->inputs[MAIN]->h;
     outlink->time_base = ctx->inputs[MAIN]->time_base;
 
+    if (s->main_pix_step[0] == 4 && s->overlay_pix_step[0] == 4 &&
+        !memcmp(s->main_rgba_map, s->overlay_rgba_map, sizeof(s->main_rgba_map)))
+        alpha_pos = s->overlay_rgba_map[A];
+    ff_overlay_init(&s->dsp, s->format, s->alpha_format, s->main_has_alpha, alpha_pos);
+
     return 0;
 }
 
@@ -398,16 +403,174 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+#define ALPHA_44 a[x]
+#define ALPHA_22 (a[2*x] + ((a[2*x] + a[2*x+1]) >> 1)) >> 1
+#define ALPHA_20 (a[2*x] + a[2*x+1] + a[alinesize+2*x] + a[alinesize+2*x+1]) >> 2
+
+#define BLEND_STRAIGHT  FAST_DIV255(d[x] * (255 - alpha) + s[x] * alpha)
+#define BLEND_PREMUL    FFMIN(FAST_DIV255(d[x] * (255 - alpha)) + s[x], 255)
+#define BLEND_PREMUL_UV av_clip_uint8(FAST_DIV255((d[x] - 128) * (255 - alpha)) + s[x])
+
+#define OVERLAY_ROW(name, alpha_expr, blend)                                   \
+static int overlay_row_##name##_c(uint8_t *d, const uint8_t *s,                \
+                                  const uint8_t *a, int w,                     \
+                                  ptrdiff_t alinesize)                         \
+{                                                                              \
+    int x;                                                                     \
+                                                                               \
+    for (x = 0; x < w; x++) {                                                  \
+        const int alpha = alpha_expr;                                          \
+        d[x] = blend;                                                          \
+    }                                                                          \
+    return w;                                                                  \
+}
+
+OVERLAY_ROW(44_straight,  ALPHA_44, BLEND_STRAIGHT)
+OVERLAY_ROW(22_straight,  ALPHA_22, BLEND_STRAIGHT)
+OVERLAY_ROW(20_straight,  ALPHA_20, BLEND_STRAIGHT)
+OVERLAY_ROW(44_premul,    ALPHA_44, BLEND_PREMUL)
+OVERLAY_ROW(22_premul,    ALPHA_22, BLEND_PREMUL)
+OVERLAY_ROW(20_premul,    ALPHA_20, BLEND_PREMUL)
+OVERLAY_ROW(44_premul_uv, ALPHA_44, BLEND_PREMUL_UV)
+OVERLAY_ROW(22_premul_uv, ALPHA_22, BLEND_PREMUL_UV)
+OVERLAY_ROW(20_premul_uv, ALPHA_20, BLEND_PREMUL_UV)
+
+/**
+ * Blend premultiplied packed pixels of the same layout. The main alpha is
+ * composited with the same equation as the color components, which gives
+ * the same result as the straight alpha compositing of the other paths.
+ */
+static av_always_inline int overlay_row_packed_premul(uint8_t *d, const uint8_t *s,
+                                                      int w, int alpha_pos)
+{
+    int x, c;
+
+    for (x = 0; x < 4 * w; x += 4) {
+        const int alpha = s[x + alpha_pos];
+
+        for (c = 0; c < 4; c++)
+            d[x + c] = FFMIN(FAST_DIV255(d[x + c] * (255 - alpha)) + s[x + c], 255);
+    }
+    return w;
+}
+
+static int overlay_row_argb_premul_c(uint8_t *d, const uint8_t *s,
+                                     const uint8_t *a, int w,
+                                     ptrdiff_t alinesize)
+{
+    return overlay_row_packed_premul(d, s, w, 0);
+}
+
+static int overlay_row_rgba_premul_c(uint8_t *d, const uint8_t *s,
+                                     const uint8_t *a, int w,
+                                     ptrdiff_t alinesize)
+{
+    return overlay_row_packed_premul(d, s, w, 3);
+}
+
+av_cold void ff_overlay_set_funcs(OverlayDSPContext *dsp, int format, int alpha_format,
+                                  int main_has_alpha, int alpha_pos,
+                                  const OverlayBlendRowFunc *straight,
+                                  const OverlayBlendRowFunc *premul,
+                                  const OverlayBlendRowFunc *premul_uv,
+                                  OverlayBlendRowFunc argb_premul,
+                                  OverlayBlendRowFunc rgba_premul)
+{
+    const int premultiplied = alpha_format == OVERLAY_ALPHA_PREMULTIPLIED;
+    int sub;
+
+    switch (format) {
+    case OVERLAY_FORMAT_YUV420: sub = 2; break;
+    case OVERLAY_FORMAT_YUV422: sub = 1; break;
+    case OVERLAY_FORMAT_RGB:
+        /* straight alpha over a main picture with alpha needs a division */
+        if (premultiplied && alpha_pos == 0)
+            dsp->blend_row[0] = argb_premul;
+        else if (premultiplied && alpha_pos == 3)
+            dsp->blend_row[0] = rgba_premul;
+        return;
+    default:                    sub = 0; break;
+    }
+
+    if (!premultiplied && main_has_alpha)
+        return;
+
+    if (!premultiplied) {
+        dsp->blend_row[0] = straight[0];
+        dsp->blend_row[1] = straight[sub];
+    } else {
+        dsp->blend_row[0] = premul[0];
+        dsp->blend_row[1] = format == OVERLAY_FORMAT_GBRP ? premul[sub] :
+                                                            premul_uv[sub];
+    }
+    dsp->blend_row[2] = dsp->blend_row[1];
+}
+
+av_cold void ff_overlay_init(OverlayDSPContext *dsp, int format, int alpha_format,
+                             int main_has_alpha, int alpha_pos)
+{
+    static const OverlayBlendRowFunc straight[] = {
+        overlay_row_44_straight_c, overlay_row_22_straight_c, overlay_row_20_straight_c,
+    };
+    static const OverlayBlendRowFunc premul[] = {
+        overlay_row_44_premul_c, overlay_row_22_premul_c, overlay_row_20_premul_c,
+    };
+    static const OverlayBlendRowFunc premul_uv[] = {
+        overlay_row_44_premul_uv_c, overlay_row_22_premul_uv_c, overlay_row_20_premul_uv_c,
+    };
+
+    memset(dsp, 0, sizeof(*dsp));
+    ff_overlay_set_funcs(dsp, format, alpha_format, main_has_alpha, alpha_pos,
+                         straight, premul, premul_uv,
+                         overlay_row_argb_premul_c, overlay_row_rgba_premul_c);
+
+    if (ARCH_X86)
+        ff_overlay_init_x86(dsp, format, alpha_format, main_has_alpha, alpha_pos);
+}
+
+/**
+ * Compute the rows of the overlay blended by job jobnr in a plane with
+ * vertical subsampling vsub, for a main picture subsampled by max_vsub.
+ * The main picture is cut on its rows of the most subsampled planes, so
+ * that every job owns whole chroma rows and the luma and alpha rows below
+ * them, whatever the parity of y.
+ */
+static void slice_rows(int y, int src_h, int dst_h, int max_vsub, int vsub,
+                       int jobnr, int nb_jobs, int *start, int *end)
+{
+    const int first = FFMAX(y, 0) >> max_vsub;
+    const int last  = ((FFMIN(y + src_h, dst_h) - 1) >> max_vsub) + 1;
+    const int yp    = y >> vsub;
+    const int pmin  = FFMAX(-yp, 0);
+    const int pmax  = FFMIN(AV_CEIL_RSHIFT(dst_h, vsub) - yp,
+                            AV_CEIL_RSHIFT(src_h, vsub));
+    const int shift = max_vsub - vsub;
+    int c0, c1;
+
+    if (last <= first) {
+        *start = *end = 0;
+        return;
+    }
+    c0 = first + (last - first) *  jobnr      / nb_jobs;
+    c1 = first + (last - first) * (jobnr + 1) / nb_jobs;
+    *start = av_clip((c0 << shift) - yp, pmin, pmax);
+    *end   = av_clip((c1 << shift) - yp, pmin, pmax);
+}
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
  */
 
-static void blend_image_packed_rgb(AVFilterContext *ctx,
-                                   AVFrame *dst, const AVFrame *src,
-                                   int x, int y)
+static int blend_slice_packed_rgb(AVFilterContext *ctx, void *arg,
+                                  int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *dst = td->dst;
+    const AVFrame *src = td->src;
     int i, imax, j, jmax;
+    const int x = s->x;
+    const int y = s->y;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
@@ -424,41 +587,57 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
     const int sa = s->overlay_rgba_map[A];
     const int sstep = s->overlay_pix_step[0];
     const int main_has_alpha = s->main_has_alpha;
+    const int straight = s->alpha_format == OVERLAY_ALPHA_STRAIGHT;
     uint8_t *S, *sp, *d, *dp;
 
-    i = FFMAX(-y, 0);
+    slice_rows(y, src_h, dst_h, 0, 0, jobnr, nb_jobs, &i, &imax);
     sp = src->data[0] + i     * src->linesize[0];
     dp = dst->data[0] + (y+i) * dst->linesize[0];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (; i < imax; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
+        jmax = FFMIN(-x + dst_w, src_w);
 
-        for (jmax = FFMIN(-x + dst_w, src_w); j < jmax; j++) {
+        if (s->dsp.blend_row[0]) {
+            int n = s->dsp.blend_row[0](d, S, NULL, jmax - j, 0);
+            d += n * dstep;
+            S += n * sstep;
+            j += n;
+        }
+
+        for (; j < jmax; j++) {
             alpha = S[sa];
 
             // if the main channel has an alpha channel, alpha has to be calculated
             // to create an un-premultiplied (straight) alpha value
-            if (main_has_alpha && alpha != 0 && alpha != 255) {
+            if (main_has_alpha && straight && alpha != 0 && alpha != 255) {
                 uint8_t alpha_d = d[da];
                 alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
             }
 
-            switch (alpha) {
-            case 0:
-                break;
-            case 255:
-                d[dr] = S[sr];
-                d[dg] = S[sg];
-                d[db] = S[sb];
-                break;
-            default:
-                // main_value = main_value * (1 - alpha) + overlay_value * alpha
-                // since alpha is in the range 0-255, the result must divided by 255
-                d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + S[sr] * alpha);
-                d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + S[sg] * alpha);
-                d[db] = FAST_DIV255(d[db] * (255 - alpha) + S[sb] * alpha);
+            if (!straight) {
+                // the overlay is already multiplied by its alpha
+                d[dr] = FFMIN(FAST_DIV255(d[dr] * (255 - alpha)) + S[sr], 255);
+                d[dg] = FFMIN(FAST_DIV255(d[dg] * (255 - alpha)) + S[sg], 255);
+                d[db] = FFMIN(FAST_DIV255(d[db] * (255 - alpha)) + S[sb], 255);
+            } else {
+                switch (alpha) {
+                case 0:
+                    break;
+                case 255:
+                    d[dr] = S[sr];
+                    d[dg] = S[sg];
+                    d[db] = S[sb];
+                    break;
+                default:
+                    // main_value = main_value * (1 - alpha) + overlay_value * alpha
+                    // since alpha is in the range 0-255, the result must divided by 255
+                    d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + S[sr] * alpha);
+                    d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + S[sg] * alpha);
+                    d[db] = FAST_DIV255(d[db] * (255 - alpha) + S[sb] * alpha);
+                }
             }
             if (main_has_alpha) {
                 switch (alpha) {
@@ -478,6 +657,7 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
         dp += dst->linesize[0];
         sp += src->linesize[0];
     }
+    return 0;
 }
 
 static av_always_inline void blend_plane(AVFilterContext *ctx,
@@ -489,31 +669,48 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          int main_has_alpha,
                                          int dst_plane,
                                          int dst_offset,
-                                         int dst_step)
+                                         int dst_step,
+                                         int straight,
+                                         int yuv,
+                                         int jobnr,
+                                         int nb_jobs)
 {
+    OverlayContext *octx = ctx->priv;
+    OverlayBlendRowFunc blend_row = dst_step == 1 ? octx->dsp.blend_row[i] : NULL;
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
     int dst_wp = AV_CEIL_RSHIFT(dst_w, hsub);
-    int dst_hp = AV_CEIL_RSHIFT(dst_h, vsub);
     int yp = y>>vsub;
     int xp = x>>hsub;
     uint8_t *s, *sp, *d, *dp, *a, *ap;
     int jmax, j, k, kmax;
 
-    j = FFMAX(-yp, 0);
+    slice_rows(y, src_h, dst_h, octx->vsub, vsub, jobnr, nb_jobs, &j, &jmax);
     sp = src->data[i] + j         * src->linesize[i];
     dp = dst->data[dst_plane]
                       + (yp+j)    * dst->linesize[dst_plane]
                       + dst_offset;
     ap = src->data[3] + (j<<vsub) * src->linesize[3];
 
-    for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+    for (; j < jmax; j++) {
         k = FFMAX(-xp, 0);
         d = dp + (xp+k) * dst_step;
         s = sp + k;
         a = ap + (k<<hsub);
+        kmax = FFMIN(-xp + dst_wp, src_wp);
+
+        // the row blenders only handle the pixels whose alpha is averaged
+        // from a full block, the borders are left to the code below
+        if (blend_row && (!vsub || j+1 < src_hp)) {
+            int n = blend_row(d, s, a, FFMIN(kmax, src_wp - hsub) - k,
+                              src->linesize[3]);
+            d += n;
+            s += n;
+            a += n << hsub;
+            k += n;
+        }
 
-        for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+        for (; k < kmax; k++) {
             int alpha_v, alpha_h, alpha;
 
             // average alpha for color components, improve quality
@@ -530,23 +727,30 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                 alpha = a[0];
             // if the main channel has an alpha channel, alpha has to be calculated
             // to create an un-premultiplied (straight) alpha value
-            if (main_has_alpha && alpha != 0 && alpha != 255) {
+            if (main_has_alpha && straight && alpha != 0 && alpha != 255) {
                 // average alpha for color components, improve quality
+                const uint8_t *da = dst->data[3] + ((yp+j) << vsub) * dst->linesize[3]
+                                                 + ((xp+k) << hsub);
                 uint8_t alpha_d;
                 if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
-                    alpha_d = (d[0] + d[src->linesize[3]] +
-                               d[1] + d[src->linesize[3]+1]) >> 2;
+                    alpha_d = (da[0] + da[dst->linesize[3]] +
+                               da[1] + da[dst->linesize[3]+1]) >> 2;
                 } else if (hsub || vsub) {
                     alpha_h = hsub && k+1 < src_wp ?
-                        (d[0] + d[1]) >> 1 : d[0];
+                        (da[0] + da[1]) >> 1 : da[0];
                     alpha_v = vsub && j+1 < src_hp ?
-                        (d[0] + d[src->linesize[3]]) >> 1 : d[0];
+                        (da[0] + da[dst->linesize[3]]) >> 1 : da[0];
                     alpha_d = (alpha_v + alpha_h) >> 1;
                 } else
-                    alpha_d = d[0];
+                    alpha_d = da[0];
                 alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
             }
-            *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+            if (straight)
+                *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+            else if (i && yuv) // premultiplied chroma is centered on 128
+                *d = av_clip_uint8(FAST_DIV255((*d - 128) * (255 - alpha)) + *s);
+            else
+                *d = FFMIN(FAST_DIV255(*d * (255 - alpha)) + *s, 255);
             s++;
             d += dst_step;
             a += 1 << hsub;
@@ -560,17 +764,18 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
                                    int dst_w, int dst_h,
-                                   int x, int y)
+                                   int x, int y, int max_vsub,
+                                   int jobnr, int nb_jobs)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
     int i, imax, j, jmax;
 
-    i = FFMAX(-y, 0);
+    slice_rows(y, src_h, dst_h, max_vsub, 0, jobnr, nb_jobs, &i, &imax);
     sa = src->data[3] + i     * src->linesize[3];
     da = dst->data[3] + (y+i) * dst->linesize[3];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (; i < imax; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -599,78 +804,97 @@ static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
     }
 }
 
-static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
+static av_always_inline void blend_slice_yuv(AVFilterContext *ctx,
                                              AVFrame *dst, const AVFrame *src,
                                              int hsub, int vsub,
                                              int main_has_alpha,
-                                             int x, int y)
+                                             int x, int y,
+                                             int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
-
-    if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+    const int straight = s->alpha_format == OVERLAY_ALPHA_STRAIGHT;
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                straight, 1, jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                straight, 1, jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                straight, 1, jobnr, nb_jobs);
+
+    // the main alpha is updated last, blend_plane() needs its original value
+    if (main_has_alpha)
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, vsub, jobnr, nb_jobs);
 }
 
-static av_always_inline void blend_image_rgb(AVFilterContext *ctx,
+static av_always_inline void blend_slice_rgb(AVFilterContext *ctx,
                                              AVFrame *dst, const AVFrame *src,
                                              int hsub, int vsub,
                                              int main_has_alpha,
-                                             int x, int y)
+                                             int x, int y,
+                                             int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
-
-    if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+    const int straight = s->alpha_format == OVERLAY_ALPHA_STRAIGHT;
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step,
+                straight, 0, jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step,
+                straight, 0, jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step,
+                straight, 0, jobnr, nb_jobs);
+
+    if (main_has_alpha)
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, vsub, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 1, 1, s->main_has_alpha, x, y);
+    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, s->main_has_alpha, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 1, 0, s->main_has_alpha, x, y);
+    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, s->main_has_alpha, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 0, 0, s->main_has_alpha, x, y);
+    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, s->main_has_alpha, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_gbrp(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_rgb(ctx, dst, src, 0, 0, s->main_has_alpha, x, y);
+    blend_slice_rgb(ctx, td->dst, td->src, 0, 0, s->main_has_alpha, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -690,19 +914,19 @@ static int config_input_main(AVFilterLink *inlink)
     s->main_has_alpha = ff_fmt_is_in(inlink->format, alpha_pix_fmts);
     switch (s->format) {
     case OVERLAY_FORMAT_YUV420:
-        s->blend_image = blend_image_yuv420;
+        s->blend_slice = blend_slice_yuv420;
         break;
     case OVERLAY_FORMAT_YUV422:
-        s->blend_image = blend_image_yuv422;
+        s->blend_slice = blend_slice_yuv422;
         break;
     case OVERLAY_FORMAT_YUV444:
-        s->blend_image = blend_image_yuv444;
+        s->blend_slice = blend_slice_yuv444;
         break;
     case OVERLAY_FORMAT_RGB:
-        s->blend_image = blend_image_packed_rgb;
+        s->blend_slice = blend_slice_packed_rgb;
         break;
     case OVERLAY_FORMAT_GBRP:
-        s->blend_image = blend_image_gbrp;
+        s->blend_slice = blend_slice_gbrp;
         break;
     }
     return 0;
@@ -735,8 +959,15 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
     }
 
     if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0)
-        s->blend_image(ctx, mainpic, second, s->x, s->y);
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td;
+
+        td.dst = mainpic;
+        td.src = second;
+        ctx->internal->execute(ctx, s->blend_slice, &td, NULL,
+                               FFMIN(FFMAX(1, AV_CEIL_RSHIFT(second->height, s->vsub)),
+                                     ff_filter_get_nb_threads(ctx)));
+    }
     return mainpic;
 }
 
@@ -799,6 +1030,9 @@ static const AVOption overlay_options[] = {
         { "rgb",    "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_FORMAT_RGB},    .flags = FLAGS, .unit = "format" },
         { "gbrp",   "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_FORMAT_GBRP},   .flags = FLAGS, .unit = "format" },
     { "repeatlast", "repeat overlay of the last overlay frame", OFFSET(dinput.repeatlast), AV_OPT_TYPE_BOOL, {.i64=1}, 0, 1, FLAGS },
+    { "alpha", "alpha format", OFFSET(alpha_format), AV_OPT_TYPE_INT, {.i64=OVERLAY_ALPHA_STRAIGHT}, 0, OVERLAY_ALPHA_NB-1, FLAGS, "alpha_format" },
+        { "straight",      "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_ALPHA_STRAIGHT},      .flags = FLAGS, .unit = "alpha_format" },
+        { "premultiplied", "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_ALPHA_PREMULTIPLIED}, .flags = FLAGS, .unit = "alpha_format" },
     { NULL }
 };
 
@@ -842,5 +1076,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
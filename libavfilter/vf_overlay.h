@@ -0,0 +1,89 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum OverlayFormat {
+    OVERLAY_FORMAT_YUV420,
+    OVERLAY_FORMAT_YUV422,
+    OVERLAY_FORMAT_YUV444,
+    OVERLAY_FORMAT_RGB,
+    OVERLAY_FORMAT_GBRP,
+    OVERLAY_FORMAT_NB
+};
+
+enum OverlayAlphaFormat {
+    OVERLAY_ALPHA_STRAIGHT,
+    OVERLAY_ALPHA_PREMULTIPLIED,
+    OVERLAY_ALPHA_NB
+};
+
+/**
+ * Blend the start of a row of overlay pixels onto the main picture.
+ *
+ * @param d         main picture pixels, one byte per pixel for planar
+ *                  formats and four bytes per pixel for packed RGB
+ * @param s         overlay pixels, laid out like d
+ * @param a         overlay alpha plane, subsampled by the caller's function
+ *                  choice; unused for packed RGB
+ * @param w         number of pixels available
+ * @param alinesize linesize of the overlay alpha plane
+ * @return number of pixels blended, the caller handles the rest
+ */
+typedef int (*OverlayBlendRowFunc)(uint8_t *d, const uint8_t *s,
+                                   const uint8_t *a, int w,
+                                   ptrdiff_t alinesize);
+
+typedef struct OverlayDSPContext {
+    /**
+     * Row blenders for the main picture planes 0-2 (in overlay plane
+     * order), or for the single plane of packed RGB in blend_row[0].
+     * NULL if the blend needs the per-pixel code of the filter, i.e. for
+     * straight alpha over a main picture with alpha.
+     */
+    OverlayBlendRowFunc blend_row[3];
+} OverlayDSPContext;
+
+/**
+ * @param alpha_pos offset of the alpha byte in packed RGB pixels, or -1 if
+ *                  the main and overlay pixels are not both laid out that way
+ */
+void ff_overlay_init(OverlayDSPContext *dsp, int format, int alpha_format,
+                     int main_has_alpha, int alpha_pos);
+
+void ff_overlay_init_x86(OverlayDSPContext *dsp, int format, int alpha_format,
+                         int main_has_alpha, int alpha_pos);
+
+/**
+ * Set the row blenders of dsp for the given setup from a set of versions.
+ * The straight, premul and premul_uv tables are indexed by the alpha
+ * subsampling: none, horizontal, both.
+ */
+void ff_overlay_set_funcs(OverlayDSPContext *dsp, int format, int alpha_format,
+                          int main_has_alpha, int alpha_pos,
+                          const OverlayBlendRowFunc *straight,
+                          const OverlayBlendRowFunc *premul,
+                          const OverlayBlendRowFunc *premul_uv,
+                          OverlayBlendRowFunc argb_premul,
+                          OverlayBlendRowFunc rgba_premul);
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -204,6 +204,10 @@ static int config_input(AVFilterLink *inlink)
         return AVERROR(EINVAL);
     }
 
+    /* let frames allocated before the graph leave room for in place padding */
+    ff_inlink_request_border(inlink, s->x, s->y,
+                             s->w - s->x - inlink->w, s->h - s->y - inlink->h);
+
     return 0;
 
 eval_fail:
@@ -352,6 +356,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 
     if (needs_copy) {
         av_log(inlink->dst, AV_LOG_DEBUG, "Direct padding impossible allocating new frame\n");
+        ff_filter_account_copy(inlink->dst, in);
         out = ff_get_video_buffer(inlink->dst->outputs[0],
                                   FFMAX(inlink->w, s->w),
                                   FFMAX(inlink->h, s->h));
@@ -41,16 +41,25 @@
 #include "libavutil/avassert.h"
 #include "libswscale/swscale.h"
 
+/* output slice alignment required by sws_scale_dst_slice() */
+#define SLICE_ALIGN 8
+
 enum EvalMode {
     EVAL_MODE_INIT,
     EVAL_MODE_FRAME,
     EVAL_MODE_NB
 };
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
 typedef struct ScaleContext {
     const AVClass *class;
     struct SwsContext *sws;     ///< software scaler context
     struct SwsContext *isws[2]; ///< software scaler context for interlaced material
+    struct SwsContext **slice_sws; ///< additional scaler contexts for slice threading
+    int nb_slice_sws;
     AVDictionary *opts;
 
     /**
@@ -145,12 +154,23 @@ static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
     return 0;
 }
 
+static void free_slice_contexts(ScaleContext *scale)
+{
+    int i;
+
+    for (i = 0; i < scale->nb_slice_sws; i++)
+        sws_freeContext(scale->slice_sws[i]);
+    av_freep(&scale->slice_sws);
+    scale->nb_slice_sws = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
     sws_freeContext(scale->sws);
     sws_freeContext(scale->isws[0]);
     sws_freeContext(scale->isws[1]);
+    free_slice_contexts(scale);
     scale->sws = NULL;
     av_dict_free(&scale->opts);
 }
@@ -217,6 +237,61 @@ static const int *parse_yuv_type(const char *s, enum AVColorSpace colorspace)
     return sws_getCoefficients(colorspace);
 }
 
+static int init_scale_context(AVFilterContext *ctx, struct SwsContext **ps,
+                              AVFilterLink *inlink0, AVFilterLink *outlink,
+                              enum AVPixelFormat outfmt, int field)
+{
+    ScaleContext *scale = ctx->priv;
+    int in_v_chr_pos = scale->in_v_chr_pos, out_v_chr_pos = scale->out_v_chr_pos;
+    struct SwsContext *s;
+    int ret;
+
+    s = *ps = sws_alloc_context();
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(s, "srcw", inlink0 ->w, 0);
+    av_opt_set_int(s, "srch", inlink0 ->h >> !!field, 0);
+    av_opt_set_int(s, "src_format", inlink0->format, 0);
+    av_opt_set_int(s, "dstw", outlink->w, 0);
+    av_opt_set_int(s, "dsth", outlink->h >> !!field, 0);
+    av_opt_set_int(s, "dst_format", outfmt, 0);
+    av_opt_set_int(s, "sws_flags", scale->flags, 0);
+    av_opt_set_int(s, "param0", scale->param[0], 0);
+    av_opt_set_int(s, "param1", scale->param[1], 0);
+    if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
+        av_opt_set_int(s, "src_range",
+                       scale->in_range == AVCOL_RANGE_JPEG, 0);
+    if (scale->out_range != AVCOL_RANGE_UNSPECIFIED)
+        av_opt_set_int(s, "dst_range",
+                       scale->out_range == AVCOL_RANGE_JPEG, 0);
+
+    if (scale->opts) {
+        AVDictionaryEntry *e = NULL;
+        while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
+            if ((ret = av_opt_set(s, e->key, e->value, 0)) < 0)
+                return ret;
+        }
+    }
+    /* Override YUV420P default settings to have the correct (MPEG-2) chroma positions
+     * MPEG-2 chroma positions are used by convention
+     * XXX: support other 4:2:0 pixel formats */
+    if (inlink0->format == AV_PIX_FMT_YUV420P && scale->in_v_chr_pos == -513) {
+        in_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    if (outlink->format == AV_PIX_FMT_YUV420P && scale->out_v_chr_pos == -513) {
+        out_v_chr_pos = (field == 0) ? 128 : (field == 1) ? 64 : 192;
+    }
+
+    av_opt_set_int(s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
+    av_opt_set_int(s, "src_v_chr_pos", in_v_chr_pos, 0);
+    av_opt_set_int(s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
+    av_opt_set_int(s, "dst_v_chr_pos", out_v_chr_pos, 0);
+
+    return sws_init_context(s, NULL, NULL);
+}
+
 static int config_props(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -274,6 +349,7 @@ static int config_props(AVFilterLink *outlink)
     if (scale->isws[1])
         sws_freeContext(scale->isws[1]);
     scale->isws[0] = scale->isws[1] = scale->sws = NULL;
+    free_slice_contexts(scale);
     if (inlink0->w == outlink->w &&
         inlink0->h == outlink->h &&
         !scale->out_color_matrix &&
@@ -285,56 +361,29 @@ static int config_props(AVFilterLink *outlink)
         int i;
 
         for (i = 0; i < 3; i++) {
-            int in_v_chr_pos = scale->in_v_chr_pos, out_v_chr_pos = scale->out_v_chr_pos;
-            struct SwsContext **s = swscs[i];
-            *s = sws_alloc_context();
-            if (!*s)
-                return AVERROR(ENOMEM);
-
-            av_opt_set_int(*s, "srcw", inlink0 ->w, 0);
-            av_opt_set_int(*s, "srch", inlink0 ->h >> !!i, 0);
-            av_opt_set_int(*s, "src_format", inlink0->format, 0);
-            av_opt_set_int(*s, "dstw", outlink->w, 0);
-            av_opt_set_int(*s, "dsth", outlink->h >> !!i, 0);
-            av_opt_set_int(*s, "dst_format", outfmt, 0);
-            av_opt_set_int(*s, "sws_flags", scale->flags, 0);
-            av_opt_set_int(*s, "param0", scale->param[0], 0);
-            av_opt_set_int(*s, "param1", scale->param[1], 0);
-            if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(*s, "src_range",
-                               scale->in_range == AVCOL_RANGE_JPEG, 0);
-            if (scale->out_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(*s, "dst_range",
-                               scale->out_range == AVCOL_RANGE_JPEG, 0);
-
-            if (scale->opts) {
-                AVDictionaryEntry *e = NULL;
-                while ((e = av_dict_get(scale->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
-                    if ((ret = av_opt_set(*s, e->key, e->value, 0)) < 0)
-                        return ret;
-                }
-            }
-            /* Override YUV420P default settings to have the correct (MPEG-2) chroma positions
-             * MPEG-2 chroma positions are used by convention
-             * XXX: support other 4:2:0 pixel formats */
-            if (inlink0->format == AV_PIX_FMT_YUV420P && scale->in_v_chr_pos == -513) {
-                in_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            if (outlink->format == AV_PIX_FMT_YUV420P && scale->out_v_chr_pos == -513) {
-                out_v_chr_pos = (i == 0) ? 128 : (i == 1) ? 64 : 192;
-            }
-
-            av_opt_set_int(*s, "src_h_chr_pos", scale->in_h_chr_pos, 0);
-            av_opt_set_int(*s, "src_v_chr_pos", in_v_chr_pos, 0);
-            av_opt_set_int(*s, "dst_h_chr_pos", scale->out_h_chr_pos, 0);
-            av_opt_set_int(*s, "dst_v_chr_pos", out_v_chr_pos, 0);
-
-            if ((ret = sws_init_context(*s, NULL, NULL)) < 0)
+            if ((ret = init_scale_context(ctx, swscs[i], inlink0, outlink, outfmt, i)) < 0)
                 return ret;
             if (!scale->interlaced)
                 break;
         }
+
+        if (!scale->interlaced && !scale->nb_slices &&
+            sws_scale_dst_slice(scale->sws, NULL, NULL, NULL, NULL, 0, 0) >= 0) {
+            int nb_jobs = FFMIN(ff_filter_get_nb_threads(ctx), outlink->h / SLICE_ALIGN);
+
+            if (nb_jobs > 1) {
+                scale->slice_sws = av_mallocz_array(nb_jobs - 1, sizeof(*scale->slice_sws));
+                if (!scale->slice_sws)
+                    return AVERROR(ENOMEM);
+                for (i = 0; i < nb_jobs - 1; i++) {
+                    ret = init_scale_context(ctx, &scale->slice_sws[i], inlink0,
+                                             outlink, outfmt, 0);
+                    scale->nb_slice_sws++;
+                    if (ret < 0)
+                        return ret;
+                }
+            }
+        }
     }
 
     if (inlink->sample_aspect_ratio.num){
@@ -400,10 +449,34 @@ static int scale_slice(AVFilterLink *link, AVFrame *out_buf, AVFrame *cur_pic, s
                          out,out_stride);
 }
 
+static int scale_slice_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    struct SwsContext *sws = jobnr ? scale->slice_sws[jobnr - 1] : scale->sws;
+    const int slice_start = (out->height *  jobnr     ) / nb_jobs / SLICE_ALIGN * SLICE_ALIGN;
+    const int slice_end   = jobnr == nb_jobs - 1 ? out->height :
+                            (out->height * (jobnr + 1)) / nb_jobs / SLICE_ALIGN * SLICE_ALIGN;
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int i, ret;
+
+    for (i = 0; i < 4; i++) {
+        src[i] = in->data[i];
+        dst[i] = out->data[i];
+    }
+
+    ret = sws_scale_dst_slice(sws, src, in->linesize, dst, out->linesize,
+                              slice_start, slice_end - slice_start);
+    return ret < 0 ? ret : 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
-    ScaleContext *scale = link->dst->priv;
-    AVFilterLink *outlink = link->dst->outputs[0];
+    AVFilterContext *ctx = link->dst;
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     char buf[32];
@@ -463,7 +536,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         || scale-> in_range != AVCOL_RANGE_UNSPECIFIED
         || in_range != AVCOL_RANGE_UNSPECIFIED
         || scale->out_range != AVCOL_RANGE_UNSPECIFIED) {
-        int in_full, out_full, brightness, contrast, saturation;
+        int i, in_full, out_full, brightness, contrast, saturation;
         const int *inv_table, *table;
 
         sws_getColorspaceDetails(scale->sws, (int **)&inv_table, &in_full,
@@ -495,6 +568,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             sws_setColorspaceDetails(scale->isws[1], inv_table, in_full,
                                      table, out_full,
                                      brightness, contrast, saturation);
+        for (i = 0; i < scale->nb_slice_sws; i++)
+            sws_setColorspaceDetails(scale->slice_sws[i], inv_table, in_full,
+                                     table, out_full,
+                                     brightness, contrast, saturation);
 
         out->color_range = out_full ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
     }
@@ -507,6 +584,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     if(scale->interlaced>0 || (scale->interlaced<0 && in->interlaced_frame)){
         scale_slice(link, out, in, scale->isws[0], 0, (link->h+1)/2, 2, 0);
         scale_slice(link, out, in, scale->isws[1], 0,  link->h   /2, 2, 1);
+    }else if (scale->nb_slice_sws) {
+        ThreadData td = { .in = in, .out = out };
+        ctx->internal->execute(ctx, scale_slice_job, &td, NULL,
+                               scale->nb_slice_sws + 1);
     }else if (scale->nb_slices) {
         int i, slice_h, slice_start, slice_end = 0;
         const int nb_slices = FFMIN(scale->nb_slices, link->h);
@@ -637,6 +718,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
 
 static const AVClass scale2ref_class = {
@@ -689,4 +771,5 @@ AVFilter ff_vf_scale2ref = {
     .inputs          = avfilter_vf_scale2ref_inputs,
     .outputs         = avfilter_vf_scale2ref_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,343 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/vf_overlay.h"
+
+#if HAVE_INLINE_ASM && HAVE_6REGS
+
+/* (x + 128) * 257 >> 16 is x / 255 rounded to nearest, see FAST_DIV255 in
+ * vf_overlay.c; pmulhw keeps the floor of negative values like >> does. */
+DECLARE_ASM_CONST(32, uint16_t, pw_257)[16] = {
+    257, 257, 257, 257, 257, 257, 257, 257,
+    257, 257, 257, 257, 257, 257, 257, 257,
+};
+
+/*
+ * Planar rows, the modes are
+ * straight  d = (d * (255 - a) + s * a) / 255
+ * premul    d = min(d * (255 - a) / 255 + s, 255)
+ * premul_uv d = clip(((d - 128) * (255 - a)) / 255 + s, 0, 255)
+ * and the alpha plane has the same size (44), is horizontally subsampled
+ * (22) or subsampled in both directions (20).
+ * m5 holds words of 255, m6 words of 128 and m7 zero.
+ */
+
+#if HAVE_SSE2_INLINE
+#define SSE2_INIT                                       \
+    "pcmpeqw       %%xmm5, %%xmm5           \n\t"       \
+    "psrlw            $8, %%xmm5            \n\t"       \
+    "pcmpeqw       %%xmm6, %%xmm6           \n\t"       \
+    "psllw           $15, %%xmm6            \n\t"       \
+    "psrlw            $8, %%xmm6            \n\t"       \
+    "pxor          %%xmm7, %%xmm7           \n\t"
+
+#define SSE2_ALPHA_44                                   \
+    "movq  (%[a], %[x]), %%xmm2             \n\t"       \
+    "punpcklbw     %%xmm7, %%xmm2           \n\t"
+
+#define SSE2_ALPHA_22                                   \
+    "movdqu (%[a], %[x], 2), %%xmm2         \n\t"       \
+    "movdqa        %%xmm2, %%xmm3           \n\t"       \
+    "pand          %%xmm5, %%xmm2           \n\t"       \
+    "psrlw            $8, %%xmm3            \n\t"       \
+    "paddw         %%xmm2, %%xmm3           \n\t"       \
+    "psrlw            $1, %%xmm3            \n\t"       \
+    "paddw         %%xmm3, %%xmm2           \n\t"       \
+    "psrlw            $1, %%xmm2            \n\t"
+
+#define SSE2_ALPHA_20                                   \
+    "movdqu (%[a], %[x], 2), %%xmm2         \n\t"       \
+    "movdqu (%[a2], %[x], 2), %%xmm4        \n\t"       \
+    "movdqa        %%xmm2, %%xmm3           \n\t"       \
+    "pand          %%xmm5, %%xmm2           \n\t"       \
+    "psrlw            $8, %%xmm3            \n\t"       \
+    "paddw         %%xmm3, %%xmm2           \n\t"       \
+    "movdqa        %%xmm4, %%xmm3           \n\t"       \
+    "pand          %%xmm5, %%xmm4           \n\t"       \
+    "psrlw            $8, %%xmm3            \n\t"       \
+    "paddw         %%xmm4, %%xmm2           \n\t"       \
+    "paddw         %%xmm3, %%xmm2           \n\t"       \
+    "psrlw            $2, %%xmm2            \n\t"
+
+#define SSE2_LOAD                                       \
+    "movq  (%[d], %[x]), %%xmm0             \n\t"       \
+    "movq  (%[s], %[x]), %%xmm1             \n\t"       \
+    "punpcklbw     %%xmm7, %%xmm0           \n\t"       \
+    "punpcklbw     %%xmm7, %%xmm1           \n\t"       \
+    "movdqa        %%xmm5, %%xmm3           \n\t"       \
+    "psubw         %%xmm2, %%xmm3           \n\t"
+
+#define SSE2_STRAIGHT                                   \
+    "pmullw        %%xmm3, %%xmm0           \n\t"       \
+    "pmullw        %%xmm2, %%xmm1           \n\t"       \
+    "paddw         %%xmm1, %%xmm0           \n\t"       \
+    "paddw         %%xmm6, %%xmm0           \n\t"       \
+    "pmulhuw    %[pw_257], %%xmm0           \n\t"
+
+#define SSE2_PREMUL                                     \
+    "pmullw        %%xmm3, %%xmm0           \n\t"       \
+    "paddw         %%xmm6, %%xmm0           \n\t"       \
+    "pmulhuw    %[pw_257], %%xmm0           \n\t"       \
+    "paddw         %%xmm1, %%xmm0           \n\t"
+
+#define SSE2_PREMUL_UV                                  \
+    "psubw         %%xmm6, %%xmm0           \n\t"       \
+    "pmullw        %%xmm3, %%xmm0           \n\t"       \
+    "paddw         %%xmm6, %%xmm0           \n\t"       \
+    "pmulhw     %[pw_257], %%xmm0           \n\t"       \
+    "paddw         %%xmm1, %%xmm0           \n\t"
+
+#define SSE2_STORE                                      \
+    "packuswb      %%xmm0, %%xmm0           \n\t"       \
+    "movq          %%xmm0, (%[d], %[x])     \n\t"
+
+#define SSE2_CLOBBERS XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", \
+                                   "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+#define SSE2_END
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE
+#define AVX2_INIT                                               \
+    "vpcmpeqw      %%ymm5, %%ymm5, %%ymm5           \n\t"       \
+    "vpsllw          $15, %%ymm5, %%ymm6            \n\t"       \
+    "vpsrlw           $8, %%ymm5, %%ymm5            \n\t"       \
+    "vpsrlw           $8, %%ymm6, %%ymm6            \n\t"       \
+    "vpxor         %%ymm7, %%ymm7, %%ymm7           \n\t"
+
+#define AVX2_ALPHA_44                                           \
+    "vpmovzxbw (%[a], %[x]), %%ymm2                 \n\t"
+
+#define AVX2_ALPHA_22                                           \
+    "vmovdqu (%[a], %[x], 2), %%ymm2                \n\t"       \
+    "vpsrlw           $8, %%ymm2, %%ymm3            \n\t"       \
+    "vpand         %%ymm5, %%ymm2, %%ymm2           \n\t"       \
+    "vpaddw        %%ymm2, %%ymm3, %%ymm3           \n\t"       \
+    "vpsrlw           $1, %%ymm3, %%ymm3            \n\t"       \
+    "vpaddw        %%ymm3, %%ymm2, %%ymm2           \n\t"       \
+    "vpsrlw           $1, %%ymm2, %%ymm2            \n\t"
+
+#define AVX2_ALPHA_20                                           \
+    "vmovdqu (%[a], %[x], 2), %%ymm2                \n\t"       \
+    "vmovdqu (%[a2], %[x], 2), %%ymm4               \n\t"       \
+    "vpsrlw           $8, %%ymm2, %%ymm3            \n\t"       \
+    "vpand         %%ymm5, %%ymm2, %%ymm2           \n\t"       \
+    "vpaddw        %%ymm3, %%ymm2, %%ymm2           \n\t"       \
+    "vpsrlw           $8, %%ymm4, %%ymm3            \n\t"       \
+    "vpand         %%ymm5, %%ymm4, %%ymm4           \n\t"       \
+    "vpaddw        %%ymm4, %%ymm2, %%ymm2           \n\t"       \
+    "vpaddw        %%ymm3, %%ymm2, %%ymm2           \n\t"       \
+    "vpsrlw           $2, %%ymm2, %%ymm2            \n\t"
+
+#define AVX2_LOAD                                               \
+    "vpmovzxbw (%[d], %[x]), %%ymm0                 \n\t"       \
+    "vpmovzxbw (%[s], %[x]), %%ymm1                 \n\t"       \
+    "vpsubw        %%ymm2, %%ymm5, %%ymm3           \n\t"
+
+#define AVX2_STRAIGHT                                           \
+    "vpmullw       %%ymm3, %%ymm0, %%ymm0           \n\t"       \
+    "vpmullw       %%ymm2, %%ymm1, %%ymm1           \n\t"       \
+    "vpaddw        %%ymm1, %%ymm0, %%ymm0           \n\t"       \
+    "vpaddw        %%ymm6, %%ymm0, %%ymm0           \n\t"       \
+    "vpmulhuw   %[pw_257], %%ymm0, %%ymm0           \n\t"
+
+#define AVX2_PREMUL                                             \
+    "vpmullw       %%ymm3, %%ymm0, %%ymm0           \n\t"       \
+    "vpaddw        %%ymm6, %%ymm0, %%ymm0           \n\t"       \
+    "vpmulhuw   %[pw_257], %%ymm0, %%ymm0           \n\t"       \
+    "vpaddw        %%ymm1, %%ymm0, %%ymm0           \n\t"
+
+#define AVX2_PREMUL_UV                                          \
+    "vpsubw        %%ymm6, %%ymm0, %%ymm0           \n\t"       \
+    "vpmullw       %%ymm3, %%ymm0, %%ymm0           \n\t"       \
+    "vpaddw        %%ymm6, %%ymm0, %%ymm0           \n\t"       \
+    "vpmulhw    %[pw_257], %%ymm0, %%ymm0           \n\t"       \
+    "vpaddw        %%ymm1, %%ymm0, %%ymm0           \n\t"
+
+/* packuswb works within the lanes, gather the low quadwords */
+#define AVX2_STORE                                              \
+    "vpackuswb     %%ymm0, %%ymm0, %%ymm0           \n\t"       \
+    "vpermq        $0x08, %%ymm0, %%ymm0            \n\t"       \
+    "vmovdqu       %%xmm0, (%[d], %[x])             \n\t"
+
+#define AVX2_CLOBBERS SSE2_CLOBBERS
+#define AVX2_END "vzeroupper                        \n\t"
+#endif /* HAVE_AVX2_INLINE */
+
+#define OVERLAY_ROW(name, alpha, mode, opt, OPT, step)                         \
+static int overlay_row_##name##_##opt(uint8_t *d, const uint8_t *s,            \
+                                      const uint8_t *a, int w,                 \
+                                      ptrdiff_t alinesize)                     \
+{                                                                              \
+    x86_reg x = 0, n = w & -step;                                              \
+                                                                               \
+    if (n <= 0)                                                                \
+        return 0;                                                              \
+    __asm__ volatile (                                                         \
+        OPT##_INIT                                                             \
+        "1:                                 \n\t"                              \
+        OPT##_##alpha                                                          \
+        OPT##_LOAD                                                             \
+        OPT##_##mode                                                           \
+        OPT##_STORE                                                            \
+        "add            $"#step", %[x]      \n\t"                              \
+        "cmp               %[n], %[x]       \n\t"                              \
+        "jl 1b                              \n\t"                              \
+        OPT##_END                                                              \
+        : [x]"+&r"(x)                                                          \
+        : [d]"r"(d), [s]"r"(s), [a]"r"(a), [a2]"r"(a + alinesize),             \
+          [n]"rm"(n), [pw_257]"m"(*pw_257)                                     \
+        : OPT##_CLOBBERS                                                       \
+    );                                                                         \
+    return n;                                                                  \
+}
+
+/*
+ * Packed 32-bit pixels with the same layout and the alpha in word idx of
+ * each pixel, premultiplied blend of all the components, which composites
+ * the main alpha too.
+ */
+#if HAVE_SSE2_INLINE
+#define SSE2_BLEND_PACKED(dst, src, idx)                                \
+    "pshuflw $"#idx", %%xmm"#src", %%xmm4   \n\t"                       \
+    "pshufhw $"#idx", %%xmm4, %%xmm4        \n\t"                       \
+    "pxor          %%xmm5, %%xmm4           \n\t"                       \
+    "pmullw        %%xmm4, %%xmm"#dst"      \n\t"                       \
+    "paddw         %%xmm6, %%xmm"#dst"      \n\t"                       \
+    "pmulhuw    %[pw_257], %%xmm"#dst"      \n\t"                       \
+    "paddw    %%xmm"#src", %%xmm"#dst"      \n\t"
+
+#define SSE2_PACKED(idx)                                                \
+    "movdqu (%[d], %[x]), %%xmm0            \n\t"                       \
+    "movdqu (%[s], %[x]), %%xmm1            \n\t"                       \
+    "movdqa        %%xmm0, %%xmm2           \n\t"                       \
+    "movdqa        %%xmm1, %%xmm3           \n\t"                       \
+    "punpcklbw     %%xmm7, %%xmm0           \n\t"                       \
+    "punpckhbw     %%xmm7, %%xmm2           \n\t"                       \
+    "punpcklbw     %%xmm7, %%xmm1           \n\t"                       \
+    "punpckhbw     %%xmm7, %%xmm3           \n\t"                       \
+    SSE2_BLEND_PACKED(0, 1, idx)                                        \
+    SSE2_BLEND_PACKED(2, 3, idx)                                        \
+    "packuswb      %%xmm2, %%xmm0           \n\t"                       \
+    "movdqu        %%xmm0, (%[d], %[x])     \n\t"
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE
+#define AVX2_BLEND_PACKED(dst, src, idx)                                        \
+    "vpshuflw $"#idx", %%ymm"#src", %%ymm4          \n\t"                       \
+    "vpshufhw $"#idx", %%ymm4, %%ymm4               \n\t"                       \
+    "vpxor         %%ymm5, %%ymm4, %%ymm4           \n\t"                       \
+    "vpmullw       %%ymm4, %%ymm"#dst", %%ymm"#dst" \n\t"                       \
+    "vpaddw        %%ymm6, %%ymm"#dst", %%ymm"#dst" \n\t"                       \
+    "vpmulhuw   %[pw_257], %%ymm"#dst", %%ymm"#dst" \n\t"                       \
+    "vpaddw   %%ymm"#src", %%ymm"#dst", %%ymm"#dst" \n\t"
+
+/* the unpacks and the pack work within the lanes and cancel out */
+#define AVX2_PACKED(idx)                                                        \
+    "vmovdqu (%[d], %[x]), %%ymm2                   \n\t"                       \
+    "vmovdqu (%[s], %[x]), %%ymm3                   \n\t"                       \
+    "vpunpcklbw    %%ymm7, %%ymm2, %%ymm0           \n\t"                       \
+    "vpunpckhbw    %%ymm7, %%ymm2, %%ymm2           \n\t"                       \
+    "vpunpcklbw    %%ymm7, %%ymm3, %%ymm1           \n\t"                       \
+    "vpunpckhbw    %%ymm7, %%ymm3, %%ymm3           \n\t"                       \
+    AVX2_BLEND_PACKED(0, 1, idx)                                                \
+    AVX2_BLEND_PACKED(2, 3, idx)                                                \
+    "vpackuswb     %%ymm2, %%ymm0, %%ymm0           \n\t"                       \
+    "vmovdqu       %%ymm0, (%[d], %[x])             \n\t"
+#endif /* HAVE_AVX2_INLINE */
+
+#define OVERLAY_ROW_PACKED(name, idx, opt, OPT, bytes)                         \
+static int overlay_row_##name##_premul_##opt(uint8_t *d, const uint8_t *s,     \
+                                             const uint8_t *a, int w,          \
+                                             ptrdiff_t alinesize)              \
+{                                                                              \
+    x86_reg x = 0, n = (w & -(bytes / 4)) * 4;                                 \
+                                                                               \
+    if (n <= 0)                                                                \
+        return 0;                                                              \
+    __asm__ volatile (                                                         \
+        OPT##_INIT                                                             \
+        "1:                                 \n\t"                              \
+        OPT##_PACKED(idx)                                                      \
+        "add           $"#bytes", %[x]      \n\t"                              \
+        "cmp               %[n], %[x]       \n\t"                              \
+        "jl 1b                              \n\t"                              \
+        OPT##_END                                                              \
+        : [x]"+&r"(x)                                                          \
+        : [d]"r"(d), [s]"r"(s), [n]"rm"(n), [pw_257]"m"(*pw_257)               \
+        : OPT##_CLOBBERS                                                       \
+    );                                                                         \
+    return n / 4;                                                              \
+}
+
+#define OVERLAY_FUNCS(opt, OPT, step)                                          \
+OVERLAY_ROW(44_straight,  ALPHA_44, STRAIGHT,  opt, OPT, step)                 \
+OVERLAY_ROW(22_straight,  ALPHA_22, STRAIGHT,  opt, OPT, step)                 \
+OVERLAY_ROW(20_straight,  ALPHA_20, STRAIGHT,  opt, OPT, step)                 \
+OVERLAY_ROW(44_premul,    ALPHA_44, PREMUL,    opt, OPT, step)                 \
+OVERLAY_ROW(22_premul,    ALPHA_22, PREMUL,    opt, OPT, step)                 \
+OVERLAY_ROW(20_premul,    ALPHA_20, PREMUL,    opt, OPT, step)                 \
+OVERLAY_ROW(44_premul_uv, ALPHA_44, PREMUL_UV, opt, OPT, step)                 \
+OVERLAY_ROW(22_premul_uv, ALPHA_22, PREMUL_UV, opt, OPT, step)                 \
+OVERLAY_ROW(20_premul_uv, ALPHA_20, PREMUL_UV, opt, OPT, step)                 \
+OVERLAY_ROW_PACKED(argb, 0x00, opt, OPT, 2 * step)                             \
+OVERLAY_ROW_PACKED(rgba, 0xff, opt, OPT, 2 * step)
+
+#define SET_FUNCS(opt)                                                         \
+    ff_overlay_set_funcs(dsp, format, alpha_format, main_has_alpha, alpha_pos, \
+        (const OverlayBlendRowFunc[]){ overlay_row_44_straight_##opt,          \
+                                       overlay_row_22_straight_##opt,          \
+                                       overlay_row_20_straight_##opt },        \
+        (const OverlayBlendRowFunc[]){ overlay_row_44_premul_##opt,            \
+                                       overlay_row_22_premul_##opt,            \
+                                       overlay_row_20_premul_##opt },          \
+        (const OverlayBlendRowFunc[]){ overlay_row_44_premul_uv_##opt,         \
+                                       overlay_row_22_premul_uv_##opt,         \
+                                       overlay_row_20_premul_uv_##opt },       \
+        overlay_row_argb_premul_##opt, overlay_row_rgba_premul_##opt)
+
+#if HAVE_SSE2_INLINE
+OVERLAY_FUNCS(sse2, SSE2, 8)
+#endif
+#if HAVE_AVX2_INLINE
+OVERLAY_FUNCS(avx2, AVX2, 16)
+#endif
+
+#endif /* HAVE_INLINE_ASM && HAVE_6REGS */
+
+av_cold void ff_overlay_init_x86(OverlayDSPContext *dsp, int format,
+                                 int alpha_format, int main_has_alpha,
+                                 int alpha_pos)
+{
+#if HAVE_INLINE_ASM && HAVE_6REGS
+    int cpu_flags = av_get_cpu_flags();
+
+#if HAVE_SSE2_INLINE
+    if (INLINE_SSE2(cpu_flags))
+        SET_FUNCS(sse2);
+#endif
+#if HAVE_AVX2_INLINE
+    if (INLINE_AVX2(cpu_flags) && !(cpu_flags & AV_CPU_FLAG_AVXSLOW))
+        SET_FUNCS(avx2);
+#endif
+#endif /* HAVE_INLINE_ASM && HAVE_6REGS */
+}
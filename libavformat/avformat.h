@@ -2899,6 +2899,35 @@ int av_index_search_timestamp(AVStream *st, int64_t timestamp, int flags);
 int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
 		int size, int distance, int flags);
 
+/**
+ * Get the number of entries in the index of a stream.
+ */
+int avformat_index_get_entries_count(const AVStream *st);
+
+/**
+ * Get an entry of the index of a stream. The index may not be stored as
+ * AVStream.index_entries, this is the way to access it outside of lavf.
+ *
+ * @param idx index of the entry, as returned by av_index_search_timestamp()
+ * @return the entry, or NULL if idx is out of range. It is only valid until
+ *         the next call to a function accessing the index of the stream,
+ *         or reading from or seeking in the AVFormatContext.
+ */
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx);
+
+/**
+ * Get the entry of the index of a stream for a timestamp.
+ *
+ * @param wanted_timestamp timestamp to retrieve the entry for
+ * @param flags            flags of av_index_search_timestamp()
+ * @return the entry, or NULL if there is none. It is only valid until the
+ *         next call to a function accessing the index of the stream, or
+ *         reading from or seeking in the AVFormatContext.
+ */
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags);
+
 
 /**
  * Split a URL string into components.
@@ -53,6 +53,19 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext as a reference to the data of the
+ * underlying protocol, without copying it. This is only possible if the
+ * protocol has the data in memory, like the file protocol with mmap.
+ * The data must not be modified and is not followed by zeroed padding.
+ * @param s IO context
+ * @param buf set to the reference to the data read
+ * @param size number of bytes requested
+ * @return number of bytes read, fewer at the end of the stream, or AVERROR;
+ *         AVERROR(ENOSYS) if the data must be read with avio_read()
+ */
+int ffio_read_buffer_ref(AVIOContext *s, AVBufferRef **buf, int size);
+
 /**
  * Read size bytes from AVIOContext into buf.
  * This reads at most 1 packet. If that is not enough fewer bytes will be
@@ -22,10 +22,12 @@
 #include "libavutil/bprint.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avio_internal.h"
@@ -44,6 +46,16 @@
 
 typedef struct AVIOInternal {
     URLContext *h;
+#if HAVE_THREADS
+    /* asynchronous writes, the writer thread empties the fifo into h */
+    AVFifoBuffer *fifo;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_writer;     ///< signaled when data is queued or on close
+    pthread_cond_t cond_main;       ///< signaled when data was written
+    int write_error;
+    int close_request;
+#endif
 } AVIOInternal;
 
 static void *ff_avio_child_next(void *obj, void *prev)
@@ -77,6 +89,10 @@ const AVClass ff_avio_class = {
 
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
+static int io_write_packet(void *opaque, uint8_t *buf, int buf_size);
+#if HAVE_THREADS
+static int async_write_wait(AVIOInternal *internal);
+#endif
 
 int ffio_init_context(AVIOContext *s,
                   unsigned char *buffer,
@@ -270,6 +286,16 @@ void avio_flush(AVIOContext *s)
 {
     flush_buffer(s);
     s->must_flush = 0;
+#if HAVE_THREADS
+    if (s->write_packet == io_write_packet) {
+        AVIOInternal *internal = s->opaque;
+        if (internal->fifo) {
+            int ret = async_write_wait(internal);
+            if (ret < 0 && !s->error)
+                s->error = ret;
+        }
+    }
+#endif
 }
 
 int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
@@ -903,15 +929,149 @@ static int io_read_packet(void *opaque, uint8_t *buf, int buf_size)
     return ffurl_read(internal->h, buf, buf_size);
 }
 
+#if HAVE_THREADS
+static void *async_write_thread(void *arg)
+{
+    AVIOInternal *internal = arg;
+    uint8_t buf[IO_BUFFER_SIZE];
+
+    pthread_mutex_lock(&internal->mutex);
+    for (;;) {
+        int size = FFMIN(av_fifo_size(internal->fifo), sizeof(buf));
+        int ret;
+
+        if (!size || internal->write_error < 0) {
+            if (internal->close_request)
+                break;
+            pthread_cond_wait(&internal->cond_writer, &internal->mutex);
+            continue;
+        }
+        /* the data stays queued until it is written, so that an empty fifo
+         * means that everything reached the protocol */
+        av_fifo_generic_peek(internal->fifo, buf, size, NULL);
+        pthread_mutex_unlock(&internal->mutex);
+        ret = ffurl_write(internal->h, buf, size);
+        pthread_mutex_lock(&internal->mutex);
+        av_fifo_drain(internal->fifo, size);
+        if (ret < 0)
+            internal->write_error = ret;
+        pthread_cond_signal(&internal->cond_main);
+    }
+    pthread_mutex_unlock(&internal->mutex);
+    return NULL;
+}
+
+static int async_write_start(AVIOInternal *internal)
+{
+    int ret;
+
+    internal->fifo = av_fifo_alloc(internal->h->async_write_size);
+    if (!internal->fifo)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&internal->mutex, NULL);
+    if (ret)
+        goto mutex_fail;
+    ret = pthread_cond_init(&internal->cond_writer, NULL);
+    if (ret)
+        goto cond_writer_fail;
+    ret = pthread_cond_init(&internal->cond_main, NULL);
+    if (ret)
+        goto cond_main_fail;
+    ret = pthread_create(&internal->thread, NULL, async_write_thread, internal);
+    if (ret)
+        goto thread_fail;
+    return 0;
+
+thread_fail:
+    pthread_cond_destroy(&internal->cond_main);
+cond_main_fail:
+    pthread_cond_destroy(&internal->cond_writer);
+cond_writer_fail:
+    pthread_mutex_destroy(&internal->mutex);
+mutex_fail:
+    av_fifo_freep(&internal->fifo);
+    return AVERROR(ret);
+}
+
+/**
+ * Wait until all the queued data is written.
+ *
+ * @return the error of a previous write, 0 otherwise
+ */
+static int async_write_wait(AVIOInternal *internal)
+{
+    int ret;
+
+    pthread_mutex_lock(&internal->mutex);
+    while (av_fifo_size(internal->fifo) && internal->write_error >= 0)
+        pthread_cond_wait(&internal->cond_main, &internal->mutex);
+    ret = internal->write_error;
+    pthread_mutex_unlock(&internal->mutex);
+    return ret;
+}
+
+static int async_write_stop(AVIOInternal *internal)
+{
+    int ret = async_write_wait(internal);
+
+    pthread_mutex_lock(&internal->mutex);
+    internal->close_request = 1;
+    pthread_cond_signal(&internal->cond_writer);
+    pthread_mutex_unlock(&internal->mutex);
+    pthread_join(internal->thread, NULL);
+
+    pthread_cond_destroy(&internal->cond_main);
+    pthread_cond_destroy(&internal->cond_writer);
+    pthread_mutex_destroy(&internal->mutex);
+    av_fifo_freep(&internal->fifo);
+    return ret;
+}
+
+/* queue the data, waiting for the writer thread while the fifo is full */
+static int async_write(AVIOInternal *internal, const uint8_t *buf, int buf_size)
+{
+    int left = buf_size, ret;
+
+    pthread_mutex_lock(&internal->mutex);
+    while (left > 0 && internal->write_error >= 0) {
+        int size = FFMIN(av_fifo_space(internal->fifo), left);
+
+        if (!size) {
+            pthread_cond_wait(&internal->cond_main, &internal->mutex);
+            continue;
+        }
+        av_fifo_generic_write(internal->fifo, (void *)buf, size, NULL);
+        buf  += size;
+        left -= size;
+        pthread_cond_signal(&internal->cond_writer);
+    }
+    ret = internal->write_error;
+    pthread_mutex_unlock(&internal->mutex);
+    return ret < 0 ? ret : buf_size;
+}
+#endif
+
 static int io_write_packet(void *opaque, uint8_t *buf, int buf_size)
 {
     AVIOInternal *internal = opaque;
+#if HAVE_THREADS
+    if (internal->fifo)
+        return async_write(internal, buf, buf_size);
+#endif
     return ffurl_write(internal->h, buf, buf_size);
 }
 
 static int64_t io_seek(void *opaque, int64_t offset, int whence)
 {
     AVIOInternal *internal = opaque;
+#if HAVE_THREADS
+    if (internal->fifo) {
+        int ret = async_write_wait(internal);
+        if (ret < 0)
+            return ret;
+    }
+#endif
     return ffurl_seek(internal->h, offset, whence);
 }
 
@@ -945,6 +1105,29 @@ ffio_fdopen()
 IO_BUFFER_SIZEֽڸBufferIO_BUFFER_SIZEȡֵΪ32768
 */
 
+int ffio_read_buffer_ref(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    AVIOInternal *internal = s->opaque;
+    int64_t pos = avio_tell(s);
+    int ret;
+
+    if (s->read_packet != io_read_packet || s->write_flag || s->update_checksum)
+        return AVERROR(ENOSYS);
+    if (pos < 0)
+        return pos;
+
+    ret = ffurl_get_buffer(internal->h, pos, size, buf);
+    if (ret <= 0)
+        return ret;
+    if (avio_seek(s, pos + ret, SEEK_SET) < 0) {
+        av_buffer_unref(buf);
+        return AVERROR(EIO);
+    }
+    if (ret < size)
+        s->eof_reached = 1;
+    return ret;
+}
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     AVIOInternal *internal = NULL;
@@ -972,6 +1155,20 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     if (!*s)
         goto fail;
 
+#if HAVE_THREADS
+    /* packetized protocols need their writes to be kept as they are */
+    if (h->async_write_size && (h->flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_WRITE &&
+        !max_packet_size) {
+        int ret = async_write_start(internal);
+        if (ret < 0) {
+            av_freep(s);
+            av_freep(&internal);
+            av_freep(&buffer);
+            return ret;
+        }
+    }
+#endif
+
     (*s)->protocol_whitelist = av_strdup(h->protocol_whitelist);
     if (!(*s)->protocol_whitelist && h->protocol_whitelist) {
         avio_closep(s);
@@ -1186,6 +1383,7 @@ int avio_close(AVIOContext *s)
 {
     AVIOInternal *internal;
     URLContext *h;
+    int ret = 0, err;
 
     if (!s)
         return 0;
@@ -1193,6 +1391,10 @@ int avio_close(AVIOContext *s)
     avio_flush(s);
     internal = s->opaque;
     h        = internal->h;
+#if HAVE_THREADS
+    if (internal->fifo)
+        ret = async_write_stop(internal);
+#endif
 
     av_freep(&s->opaque);
     av_freep(&s->buffer);
@@ -1202,7 +1404,8 @@ int avio_close(AVIOContext *s)
         av_log(s, AV_LOG_DEBUG, "Statistics: %"PRId64" bytes read, %d seeks\n", s->bytes_read, s->seek_count);
     av_opt_free(s);
     av_free(s);
-    return ffurl_close(h);
+    err = ffurl_close(h);
+    return ret < 0 ? ret : err;
 }
 
 int avio_closep(AVIOContext **s)
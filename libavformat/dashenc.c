@@ -72,10 +72,16 @@ typedef struct OutputStream {
     Segment **segments;
     int64_t first_pts, start_pts, max_pts;
     int64_t last_dts;
+    int64_t frag_start_pts;
     int bit_rate;
     char bandwidth_str[64];
 
     char codec_str[100];
+
+    int segment_started;
+    int64_t seg_start_pos;
+    char filename[1024], full_path[1024], temp_path[1024];
+    double availability_time_offset;
 } OutputStream;
 
 typedef struct DASHContext {
@@ -98,6 +104,9 @@ typedef struct DASHContext {
     const char *media_seg_name;
     AVRational min_frame_rate, max_frame_rate;
     int ambiguous_frame_rate;
+    int streaming;
+    int64_t frag_duration;
+    int use_rename;         ///< media segments are written to a temporary file first
 } DASHContext;
 
 static int dash_write(void *opaque, uint8_t *buf, int buf_size)
@@ -209,6 +218,8 @@ static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext
         avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", timescale);
         if (!c->use_timeline)
             avio_printf(out, "duration=\"%"PRId64"\" ", c->last_duration);
+        if (c->streaming && !c->use_timeline && os->availability_time_offset > 0)
+            avio_printf(out, "availabilityTimeOffset=\"%.3f\" availabilityTimeComplete=\"false\" ", os->availability_time_offset);
         avio_printf(out, "initialization=\"%s\" media=\"%s\" startNumber=\"%d\">\n", c->init_seg_name, c->media_seg_name, c->use_timeline ? start_number : 1);
         if (c->use_timeline) {
             int64_t cur_time = 0;
@@ -590,6 +601,7 @@ static int dash_init(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     int ret = 0, i;
     AVOutputFormat *oformat;
+    const char *proto = avio_find_protocol_name(s->filename);
     char *ptr;
     char basename[1024];
 
@@ -598,6 +610,8 @@ static int dash_init(AVFormatContext *s)
     if (c->single_file)
         c->use_template = 0;
     c->ambiguous_frame_rate = 0;
+    // Chunks have to be readable while the segment is being written.
+    c->use_rename = proto && !strcmp(proto, "file") && !c->streaming;
 
     av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
@@ -669,6 +683,11 @@ static int dash_init(AVFormatContext *s)
         os->init_start_pos = 0;
 
         av_dict_set(&opts, "movflags", "frag_custom+dash+delay_moov", 0);
+        // A sidx per chunk would only index that chunk, and its earliest
+        // presentation time is clamped to 0 for the first one, while the
+        // tfdt of the chunks is continuous, so leave the timing to the tfdt.
+        if (c->streaming && !c->single_file)
+            av_dict_set(&opts, "movflags", "+skip_sidx", AV_DICT_APPEND);
         if ((ret = avformat_init_output(ctx, &opts)) < 0)
             return ret;
         os->ctx_inited = 1;
@@ -698,12 +717,34 @@ static int dash_init(AVFormatContext *s)
         }
 
         set_codec_str(s, st->codecpar, os->codec_str, sizeof(os->codec_str));
+
+        if (c->streaming) {
+            // Clients may request a segment as soon as its first chunk is
+            // available, one chunk duration after the start of the segment.
+            int64_t chunk_duration = c->frag_duration;
+            if (!chunk_duration) {
+                if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+                    s->streams[i]->avg_frame_rate.num > 0)
+                    chunk_duration = av_rescale_q(1, av_inv_q(s->streams[i]->avg_frame_rate), AV_TIME_BASE_Q);
+                else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                         st->codecpar->frame_size && st->codecpar->sample_rate)
+                    chunk_duration = av_rescale(st->codecpar->frame_size, AV_TIME_BASE, st->codecpar->sample_rate);
+            }
+            if (chunk_duration > 0 && chunk_duration < c->min_seg_duration)
+                os->availability_time_offset = (c->min_seg_duration - chunk_duration) / (double)AV_TIME_BASE;
+        }
+
         os->first_pts = AV_NOPTS_VALUE;
         os->max_pts = AV_NOPTS_VALUE;
         os->last_dts = AV_NOPTS_VALUE;
         os->segment_index = 1;
     }
 
+    if (c->streaming && (!c->use_template || c->use_timeline))
+        av_log(s, AV_LOG_WARNING, "availabilityTimeOffset is only signalled "
+               "with use_template and without use_timeline, clients will not "
+               "request partial segments\n");
+
     if (!c->has_video && c->min_seg_duration <= 0) {
         av_log(s, AV_LOG_WARNING, "no video stream and no min seg duration set\n");
         return AVERROR(EINVAL);
@@ -818,22 +859,77 @@ static int update_stream_extradata(AVFormatContext *s, OutputStream *os,
     return 0;
 }
 
+static int flush_init_segment(AVFormatContext *s, OutputStream *os)
+{
+    DASHContext *c = s->priv_data;
+
+    av_write_frame(os->ctx, NULL);
+    os->init_range_length = avio_tell(os->ctx->pb);
+    if (!c->single_file)
+        ff_format_io_close(s, &os->out);
+    return 0;
+}
+
+/**
+ * Open the file of the next media segment of the stream, unless all the
+ * segments are stored in a single file.
+ */
+static int start_segment(AVFormatContext *s, OutputStream *os, int index)
+{
+    DASHContext *c = s->priv_data;
+    int ret;
+
+    os->seg_start_pos = avio_tell(os->ctx->pb);
+    if (!c->single_file) {
+        dash_fill_tmpl_params(os->filename, sizeof(os->filename), c->media_seg_name, index, os->segment_index, os->bit_rate, os->start_pts);
+        snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->filename);
+        snprintf(os->temp_path, sizeof(os->temp_path), c->use_rename ? "%s.tmp" : "%s", os->full_path);
+        ret = s->io_open(s, &os->out, os->temp_path, AVIO_FLAG_WRITE, NULL);
+        if (ret < 0)
+            return ret;
+        write_styp(os->ctx->pb);
+    } else {
+        os->filename[0] = '\0';
+        snprintf(os->full_path, sizeof(os->full_path), "%s%s", c->dirname, os->initfile);
+    }
+    os->segment_started = 1;
+    return 0;
+}
+
+/**
+ * Write the moof/mdat chunk of the packets of the current segment written
+ * since the last one, and send it to the output right away.
+ */
+static int write_chunk(AVFormatContext *s, OutputStream *os, int index)
+{
+    int ret;
+
+    if (!os->init_range_length && (ret = flush_init_segment(s, os)) < 0)
+        return ret;
+    if (!os->segment_started && (ret = start_segment(s, os, index)) < 0)
+        return ret;
+
+    av_write_frame(os->ctx, NULL);
+    avio_flush(os->ctx->pb);
+    if (os->out) {
+        avio_flush(os->out);
+        if (os->out->error < 0)
+            return os->out->error;
+    }
+    return 0;
+}
+
 static int dash_flush(AVFormatContext *s, int final, int stream)
 {
     DASHContext *c = s->priv_data;
     int i, ret = 0;
 
-    const char *proto = avio_find_protocol_name(s->filename);
-    int use_rename = proto && !strcmp(proto, "file");
-
     int cur_flush_segment_index = 0;
     if (stream >= 0)
         cur_flush_segment_index = c->streams[stream].segment_index;
 
     for (i = 0; i < s->nb_streams; i++) {
         OutputStream *os = &c->streams[i];
-        char filename[1024] = "", full_path[1024], temp_path[1024];
-        int64_t start_pos;
         int range_length, index_length = 0;
 
         if (!os->packets_written)
@@ -851,45 +947,31 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
                 continue;
         }
 
-        if (!os->init_range_length) {
-            av_write_frame(os->ctx, NULL);
-            os->init_range_length = avio_tell(os->ctx->pb);
-            if (!c->single_file)
-                ff_format_io_close(s, &os->out);
-        }
-
-        start_pos = avio_tell(os->ctx->pb);
+        if (!os->init_range_length)
+            flush_init_segment(s, os);
 
-        if (!c->single_file) {
-            dash_fill_tmpl_params(filename, sizeof(filename), c->media_seg_name, i, os->segment_index, os->bit_rate, os->start_pts);
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
-            snprintf(temp_path, sizeof(temp_path), use_rename ? "%s.tmp" : "%s", full_path);
-            ret = s->io_open(s, &os->out, temp_path, AVIO_FLAG_WRITE, NULL);
-            if (ret < 0)
-                break;
-            write_styp(os->ctx->pb);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, os->initfile);
-        }
+        if (!os->segment_started && (ret = start_segment(s, os, i)) < 0)
+            break;
 
         av_write_frame(os->ctx, NULL);
         avio_flush(os->ctx->pb);
         os->packets_written = 0;
+        os->segment_started = 0;
 
-        range_length = avio_tell(os->ctx->pb) - start_pos;
+        range_length = avio_tell(os->ctx->pb) - os->seg_start_pos;
         if (c->single_file) {
-            find_index_range(s, full_path, start_pos, &index_length);
+            find_index_range(s, os->full_path, os->seg_start_pos, &index_length);
         } else {
             ff_format_io_close(s, &os->out);
 
-            if (use_rename) {
-                ret = avpriv_io_move(temp_path, full_path);
+            if (c->use_rename) {
+                ret = avpriv_io_move(os->temp_path, os->full_path);
                 if (ret < 0)
                     break;
             }
         }
-        add_segment(os, filename, os->start_pts, os->max_pts - os->start_pts, start_pos, range_length, index_length);
-        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, full_path);
+        add_segment(os, os->filename, os->start_pts, os->max_pts - os->start_pts, os->seg_start_pos, range_length, index_length);
+        av_log(s, AV_LOG_VERBOSE, "Representation %d media segment %d written to: %s\n", i, os->segment_index, os->full_path);
     }
 
     if (c->window_size || (final && c->remove_at_exit)) {
@@ -984,13 +1066,24 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
             os->start_pts = os->max_pts;
         else
             os->start_pts = pkt->pts;
+        os->frag_start_pts = os->start_pts;
     }
     if (os->max_pts == AV_NOPTS_VALUE)
         os->max_pts = pkt->pts + pkt->duration;
     else
         os->max_pts = FFMAX(os->max_pts, pkt->pts + pkt->duration);
     os->packets_written++;
-    return ff_write_chained(os->ctx, 0, pkt, s, 0);
+    if ((ret = ff_write_chained(os->ctx, 0, pkt, s, 0)) < 0)
+        return ret;
+
+    if (c->streaming &&
+        av_compare_ts(os->max_pts - os->frag_start_pts, st->time_base,
+                      c->frag_duration, AV_TIME_BASE_Q) >= 0) {
+        if ((ret = write_chunk(s, os, pkt->stream_index)) < 0)
+            return ret;
+        os->frag_start_pts = os->max_pts;
+    }
+    return 0;
 }
 
 static int dash_write_trailer(AVFormatContext *s)
@@ -1063,6 +1156,8 @@ static const AVOption options[] = {
     { "single_file_name", "DASH-templated name to be used for baseURL. Implies storing all segments in one file, accessed using byte ranges", OFFSET(single_file_name), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "init_seg_name", "DASH-templated name to used for the initialization segment", OFFSET(init_seg_name), AV_OPT_TYPE_STRING, {.str = "init-stream$RepresentationID$.m4s"}, 0, 0, E },
     { "media_seg_name", "DASH-templated name to used for the media segments", OFFSET(media_seg_name), AV_OPT_TYPE_STRING, {.str = "chunk-stream$RepresentationID$-$Number%05d$.m4s"}, 0, 0, E },
+    { "streaming", "Send each chunk of a segment to the output as soon as it is complete", OFFSET(streaming), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    { "frag_duration", "duration of the chunks in streaming mode (in microseconds), 0 for one chunk per frame", OFFSET(frag_duration), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
     { NULL },
 };
 
@@ -19,7 +19,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE     /* needed for MAP_ANONYMOUS and the madvise() advice */
+#define _DARWIN_C_SOURCE
+
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -33,6 +38,9 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <stdlib.h>
 #include "os_support.h"
@@ -65,6 +73,24 @@
 #  endif
 #endif
 
+#if HAVE_MMAP && defined(MAP_ANONYMOUS) && defined(MADV_WILLNEED)
+#define FILE_MMAP 1
+#else
+#define FILE_MMAP 0
+#endif
+
+/* mapped files: a jump of more than MMAP_JUMP bytes ends a run of accesses,
+ * runs shorter than that mean random access, for which the pages are read
+ * ahead by the protocol in windows growing from MMAP_WINDOW_MIN to
+ * MMAP_WINDOW_MAX bytes, and runs longer than MMAP_SEQUENTIAL_RUN bytes are
+ * left to the sequential readahead of the kernel */
+#define MMAP_JUMP           (1 << 21)
+#define MMAP_WINDOW_MIN     (1 << 17)
+#define MMAP_WINDOW_MAX     (1 << 21)
+#define MMAP_SEQUENTIAL_RUN (1 << 23)
+/* smaller references are copied out of the mapping */
+#define MMAP_REF_MIN        (1 << 16)
+
 /* standard file protocol */
 
 typedef struct FileContext {
@@ -73,15 +99,28 @@ typedef struct FileContext {
     int trunc;
     int blocksize;
     int follow;
+    int use_mmap;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if FILE_MMAP
+    AVBufferRef *map;       ///< mapping of the whole file, followed by zeroed padding
+    int64_t map_size;       ///< size of the file
+    int64_t map_pos;        ///< read position
+    int64_t access_end;     ///< end of the last access to the mapping
+    int64_t run_size;       ///< bytes accessed since the last jump
+    int64_t advised_end;    ///< end of the pages read ahead
+    int window;             ///< size of the next readahead window
+    int advice;             ///< current madvise() advice for the mapping
+    int64_t page_mask;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "map the file in memory, so that it is read without system calls and demuxers can reference its data without copies", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -104,11 +143,169 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if FILE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)opaque);
+}
+
+/* Map the file followed by zeroed anonymous pages, so that the data at the
+ * end of the file is padded like packet data. */
+static int file_map(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    size_t size;
+    uint8_t *map;
+
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        st.st_size > SIZE_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+    size = st.st_size + AV_INPUT_BUFFER_PADDING_SIZE;
+
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+    if (mmap(map, st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, c->fd, 0) == MAP_FAILED) {
+        int ret = AVERROR(errno);
+        munmap(map, size);
+        return ret;
+    }
+
+    c->map = av_buffer_create(map, size, file_unmap, (void *)size,
+                              AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(map, size);
+        return AVERROR(ENOMEM);
+    }
+    c->map_size  = st.st_size;
+    c->advice    = MADV_NORMAL;
+#if HAVE_SYSCONF && defined(_SC_PAGESIZE)
+    c->page_mask = sysconf(_SC_PAGESIZE) - 1;
+#else
+    c->page_mask = 4095;
+#endif
+    return 0;
+}
+
+static void file_advise(FileContext *c, int64_t pos, int64_t size, int advice)
+{
+    int64_t end = FFMIN(pos + size, c->map_size);
+
+    pos &= ~c->page_mask;
+    if (end > pos)
+        madvise(c->map->data + pos, end - pos, advice);
+}
+
+/* Give the kernel readahead hints from the pattern of the accesses. */
+static void file_map_access(FileContext *c, int64_t pos, int size)
+{
+    if (pos > c->access_end + MMAP_JUMP || pos < c->access_end - MMAP_JUMP) {
+        int advice = c->run_size < MMAP_JUMP ? MADV_RANDOM : MADV_NORMAL;
+        if (advice != c->advice) {
+            file_advise(c, 0, c->map_size, advice);
+            c->advice = advice;
+        }
+        c->run_size    = 0;
+        c->advised_end = pos;
+        c->window      = MMAP_WINDOW_MIN;
+    }
+    c->run_size  += size;
+    c->access_end = pos + size;
+
+    if (c->advice != MADV_SEQUENTIAL && c->run_size > MMAP_SEQUENTIAL_RUN) {
+        file_advise(c, 0, c->map_size, MADV_SEQUENTIAL);
+        c->advice = MADV_SEQUENTIAL;
+    } else if (c->advice == MADV_RANDOM &&
+               c->access_end + c->window / 2 > c->advised_end) {
+        c->advised_end = FFMAX(c->advised_end, pos);
+        file_advise(c, c->advised_end, c->window, MADV_WILLNEED);
+        c->advised_end += c->window;
+        c->window = FFMIN(c->window * 2, MMAP_WINDOW_MAX);
+    }
+}
+
+/* Map the pages holding size bytes at pos privately, zeroing the padding
+ * in the copy of the last page. Only possible if the padding does not
+ * reach pages past the end of the file, which cannot be accessed. */
+static AVBufferRef *file_map_ref(FileContext *c, int64_t pos, int size)
+{
+    int64_t start = pos & ~c->page_mask;
+    int64_t end   = pos + size + AV_INPUT_BUFFER_PADDING_SIZE;
+    size_t len    = ((end - start) + c->page_mask) & ~c->page_mask;
+    AVBufferRef *buf;
+    uint8_t *map;
+
+    if (((end - 1) | c->page_mask) > ((c->map_size - 1) | c->page_mask))
+        return NULL;
+
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, c->fd, start);
+    if (map == MAP_FAILED)
+        return NULL;
+    memset(map + pos - start + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    buf = av_buffer_create(map, len, file_unmap, (void *)len, 0);
+    if (!buf) {
+        munmap(map, len);
+        return NULL;
+    }
+    buf->data += pos - start;
+    buf->size  = size;
+    return buf;
+}
+
+static int file_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    if (pos >= c->map_size)
+        return 0;
+    size = FFMIN(size, c->map_size - pos);
+    file_map_access(c, pos, size);
+
+    if (pos + size == c->map_size) {
+        /* the padding of the mapping is zeroed */
+        *buf = av_buffer_ref(c->map);
+        if (!*buf)
+            return AVERROR(ENOMEM);
+        (*buf)->data += pos;
+        (*buf)->size  = size;
+        return size;
+    }
+
+    *buf = size >= MMAP_REF_MIN ? file_map_ref(c, pos, size) : NULL;
+    if (!*buf) {
+        *buf = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!*buf)
+            return AVERROR(ENOMEM);
+        memcpy((*buf)->data, c->map->data + pos, size);
+        memset((*buf)->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        (*buf)->size = size;
+    }
+    return size;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if FILE_MMAP
+    if (c->map) {
+        if (c->map_pos >= c->map_size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map_size - c->map_pos);
+        memcpy(buf, c->map->data + c->map_pos, size);
+        file_map_access(c, c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -227,6 +424,17 @@ static int file_open(URLContext *h, const char *filename, int flags)
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE)) {
+#if FILE_MMAP
+        int ret = file_map(h);
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "Cannot map %s, reading it instead: %s\n",
+                   filename, av_err2str(ret));
+#else
+        av_log(h, AV_LOG_VERBOSE, "mmap is not supported on this system\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -236,6 +444,22 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if FILE_MMAP
+    if (c->map) {
+        if (whence == AVSEEK_SIZE)
+            return c->map_size;
+        if (whence == SEEK_CUR)
+            pos += c->map_pos;
+        else if (whence == SEEK_END)
+            pos += c->map_size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -250,6 +474,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if FILE_MMAP
+    /* the mapping stays alive as long as packets reference it */
+    av_buffer_unref(&c->map);
+#endif
     return close(c->fd);
 }
 
@@ -345,6 +573,9 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+#if FILE_MMAP
+    .url_get_buffer      = file_get_buffer,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
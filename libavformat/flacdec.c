@@ -37,10 +37,7 @@ typedef struct FLACDecContext {
 static void reset_index_position(int64_t metadata_head_size, AVStream *st)
 {
     /* the real seek index offset should be the size of metadata blocks with the offset in the frame blocks */
-    int i;
-    for(i=0; i<st->nb_index_entries; i++) {
-        st->index_entries[i].pos += metadata_head_size;
-    }
+    ff_index_shift_pos(st, metadata_head_size);
 }
 
 static int flac_read_header(AVFormatContext *s)
@@ -308,7 +305,7 @@ static av_unused int64_t flac_read_timestamp(AVFormatContext *s, int stream_inde
 static int flac_seek(AVFormatContext *s, int stream_index, int64_t timestamp, int flags) {
     int index;
     int64_t pos;
-    AVIndexEntry e;
+    const AVIndexEntry *e;
     FLACDecContext *flac = s->priv_data;
 
     if (!flac->found_seektable || !(s->flags&AVFMT_FLAG_FAST_SEEK)) {
@@ -319,8 +316,8 @@ static int flac_seek(AVFormatContext *s, int stream_index, int64_t timestamp, in
     if(index<0 || index >= s->streams[0]->nb_index_entries)
         return -1;
 
-    e = s->streams[0]->index_entries[index];
-    pos = avio_seek(s->pb, e.pos, SEEK_SET);
+    e = avformat_index_get_entry(s->streams[0], index);
+    pos = avio_seek(s->pb, e->pos, SEEK_SET);
     if (pos >= 0) {
         return 0;
     }
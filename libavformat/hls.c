@@ -32,6 +32,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -78,6 +79,24 @@ struct segment {
 
 struct rendition;
 
+#if HAVE_THREADS
+/*
+ * A segment downloaded ahead of the demuxer by a prefetch thread. The data
+ * is appended as it arrives, so that the demuxer can start reading before
+ * the download is complete.
+ */
+struct prefetch_entry {
+    int seq_no;
+    struct segment seg; /* copy of the playlist segment, owning url and key */
+    uint8_t *data;
+    unsigned int size;
+    unsigned int alloc_size;
+    unsigned int read_pos;
+    int done;           /* the download has ended, with error if not 0 */
+    int error;
+};
+#endif
+
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
     PLS_TYPE_EVENT,
@@ -153,6 +172,27 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+#if HAVE_THREADS
+    /* Segments prefetched by nb_prefetch_threads threads into a window of
+     * nb_prefetch_threads + 1 entries, the first one being read by the
+     * demuxer (prefetch_cur) once it is open. While the threads run, they
+     * own the segment list and reload the playlist; everything below is
+     * protected by prefetch_lock. */
+    pthread_t *prefetch_threads;
+    int nb_prefetch_threads;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    struct prefetch_entry *prefetch_entries;
+    int prefetch_head;
+    int prefetch_count;
+    int prefetch_seq_no;    /* next segment to assign to a thread */
+    int prefetch_busy;      /* a thread is reloading the playlist */
+    int prefetch_end;       /* no more segments will be assigned */
+    int prefetch_error;     /* reason of prefetch_end */
+    int prefetch_abort;
+#endif
+    struct prefetch_entry *prefetch_cur;
 };
 
 /*
@@ -204,6 +244,8 @@ typedef struct HLSContext {
     char *http_proxy;                    ///< holds the address of the HTTP proxy server
     AVDictionary *avio_opts;
     int strict_std_compliance;
+    int prefetch_segments;
+    AVMutex shared_lock;                 ///< protects cookies and the keys of the playlists from the prefetch threads
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -631,8 +673,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         void *u = (s->flags & AVFMT_FLAG_CUSTOM_IO) ? NULL : s->pb;
+        ff_mutex_lock(&c->shared_lock);
         update_options(&c->cookies, "cookies", u);
         av_dict_set(&opts, "cookies", c->cookies, 0);
+        ff_mutex_unlock(&c->shared_lock);
     }
 
     av_dict_free(&tmp);
@@ -671,7 +715,9 @@ static int parse_playlist(HLSContext *c, const char *url,
 
         // broker prior HTTP options that should be consistent across requests
         av_dict_set(&opts, "user_agent", c->user_agent, 0);
+        ff_mutex_lock(&c->shared_lock);
         av_dict_set(&opts, "cookies", c->cookies, 0);
+        ff_mutex_unlock(&c->shared_lock);
         av_dict_set(&opts, "headers", c->headers, 0);
         av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
 
@@ -857,12 +903,53 @@ enum ReadFromURLMode {
     READ_COMPLETE,
 };
 
+#if HAVE_THREADS
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size,
+                         enum ReadFromURLMode mode)
+{
+    struct prefetch_entry *e = pls->prefetch_cur;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    for (;;) {
+        unsigned int avail = e->size - e->read_pos;
+
+        if (avail && (mode == READ_NORMAL || avail >= buf_size || e->done)) {
+            ret = FFMIN(avail, buf_size);
+            memcpy(buf, e->data + e->read_pos, ret);
+            e->read_pos += ret;
+            break;
+        }
+        if (e->done) {
+            ret = e->error ? e->error : AVERROR_EOF;
+            break;
+        }
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+    }
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    if (mode == READ_COMPLETE && ret != buf_size)
+        av_log(NULL, AV_LOG_ERROR, "Could not read complete segment.\n");
+
+    return ret;
+}
+#endif
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size,
                          enum ReadFromURLMode mode)
 {
     int ret;
 
+#if HAVE_THREADS
+    if (pls->prefetch_cur) {
+        ret = prefetch_read(pls, buf, buf_size, mode);
+        if (ret > 0)
+            pls->cur_seg_offset += ret;
+        return ret;
+    }
+#endif
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -977,15 +1064,14 @@ static void handle_id3(AVIOContext *pb, struct playlist *pls)
         ff_id3v2_free_extra_meta(&extra_meta);
 }
 
-static void intercept_id3(struct playlist *pls, uint8_t *buf,
-                         int buf_size, int *len)
+static void intercept_id3(struct playlist *pls, struct segment *seg,
+                          uint8_t *buf, int buf_size, int *len)
 {
     /* intercept id3 tags, we do not want to pass them to the raw
      * demuxer on all segment switches */
     int bytes;
     int id3_buf_pos = 0;
     int fill_buf = 0;
-    struct segment *seg = current_segment(pls);
 
     /* gather all the id3 tags */
     while (1) {
@@ -1077,7 +1163,8 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
+                      AVIOContext **in)
 {
     AVDictionary *opts = NULL;
     int ret;
@@ -1085,7 +1172,9 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
 
     // broker prior HTTP options that should be consistent across requests
     av_dict_set(&opts, "user_agent", c->user_agent, 0);
+    ff_mutex_lock(&c->shared_lock);
     av_dict_set(&opts, "cookies", c->cookies, 0);
+    ff_mutex_unlock(&c->shared_lock);
     av_dict_set(&opts, "headers", c->headers, 0);
     av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
     av_dict_set(&opts, "seekable", "0", 0);
@@ -1101,15 +1190,23 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, &pls->input, seg->url, c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, c->avio_opts, opts, &is_http);
     } else if (seg->key_type == KEY_AES_128) {
         AVDictionary *opts2 = NULL;
         char iv[33], key[33], url[MAX_URL_SIZE];
-        if (strcmp(seg->key, pls->key_url)) {
+        uint8_t seg_key[sizeof(pls->key)];
+        int new_key;
+
+        ff_mutex_lock(&c->shared_lock);
+        new_key = strcmp(seg->key, pls->key_url);
+        memcpy(seg_key, pls->key, sizeof(seg_key));
+        ff_mutex_unlock(&c->shared_lock);
+        if (new_key) {
+            /* open_url() takes shared_lock, fetch the key without it */
             AVIOContext *pb;
             if (open_url(pls->parent, &pb, seg->key, c->avio_opts, opts, NULL) == 0) {
-                ret = avio_read(pb, pls->key, sizeof(pls->key));
-                if (ret != sizeof(pls->key)) {
+                ret = avio_read(pb, seg_key, sizeof(seg_key));
+                if (ret != sizeof(seg_key)) {
                     av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
                 }
@@ -1118,10 +1215,15 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
                 av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
             }
-            av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+            ff_mutex_lock(&c->shared_lock);
+            if (strcmp(seg->key, pls->key_url)) {
+                memcpy(pls->key, seg_key, sizeof(pls->key));
+                av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+            }
+            ff_mutex_unlock(&c->shared_lock);
         }
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
+        ff_data_to_hex(key, seg_key, sizeof(seg_key), 0);
         iv[32] = key[32] = '\0';
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
@@ -1132,7 +1234,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
         av_dict_set(&opts2, "key", key, 0);
         av_dict_set(&opts2, "iv", iv, 0);
 
-        ret = open_url(pls->parent, &pls->input, url, opts2, opts, &is_http);
+        ret = open_url(pls->parent, in, url, opts2, opts, &is_http);
 
         av_dict_free(&opts2);
 
@@ -1159,21 +1261,20 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
      * noticed without the call, though.
      */
     if (ret == 0 && !is_http && seg->key_type == KEY_NONE && seg->url_offset) {
-        int64_t seekret = avio_seek(pls->input, seg->url_offset, SEEK_SET);
+        int64_t seekret = avio_seek(*in, seg->url_offset, SEEK_SET);
         if (seekret < 0) {
             av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", seg->url_offset, seg->url);
             ret = seekret;
-            ff_format_io_close(pls->parent, &pls->input);
+            ff_format_io_close(pls->parent, in);
         }
     }
 
 cleanup:
     av_dict_free(&opts);
-    pls->cur_seg_offset = 0;
     return ret;
 }
 
-static int update_init_section(struct playlist *pls, struct segment *seg)
+static int update_init_section(struct playlist *pls, struct segment *init_section)
 {
     static const int max_init_section_size = 1024*1024;
     HLSContext *c = pls->parent->priv_data;
@@ -1181,15 +1282,16 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     int64_t urlsize;
     int ret;
 
-    if (seg->init_section == pls->cur_init_section)
+    if (init_section == pls->cur_init_section)
         return 0;
 
     pls->cur_init_section = NULL;
 
-    if (!seg->init_section)
+    if (!init_section)
         return 0;
 
-    ret = open_input(c, pls, seg->init_section);
+    ret = open_input(c, pls, init_section, &pls->input);
+    pls->cur_seg_offset = 0;
     if (ret < 0) {
         av_log(pls->parent, AV_LOG_WARNING,
                "Failed to open an initialization section in playlist %d\n",
@@ -1197,8 +1299,8 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
         return ret;
     }
 
-    if (seg->init_section->size >= 0)
-        sec_size = seg->init_section->size;
+    if (init_section->size >= 0)
+        sec_size = init_section->size;
     else if ((urlsize = avio_size(pls->input)) >= 0)
         sec_size = urlsize;
     else
@@ -1212,14 +1314,14 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
 
     av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
 
-    ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
+    ret = read_from_url(pls, init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size, READ_COMPLETE);
     ff_format_io_close(pls->parent, &pls->input);
 
     if (ret < 0)
         return ret;
 
-    pls->cur_init_section = seg->init_section;
+    pls->cur_init_section = init_section;
     pls->init_sec_data_len = ret;
     pls->init_sec_buf_read_offset = 0;
 
@@ -1237,10 +1339,373 @@ static int64_t default_reload_interval(struct playlist *pls)
                           pls->target_duration;
 }
 
+#if HAVE_THREADS
+static void prefetch_wake(struct playlist *pls)
+{
+    pthread_cond_broadcast(&pls->prefetch_cond);
+}
+
+/* Keep the prefetch threads from reloading the playlist, so that its
+ * segment list can be read. */
+static void prefetch_lock_segments(struct playlist *pls)
+{
+    if (!pls->nb_prefetch_threads)
+        return;
+    pthread_mutex_lock(&pls->prefetch_lock);
+    while (pls->prefetch_busy)
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+}
+
+static void prefetch_unlock_segments(struct playlist *pls)
+{
+    if (pls->nb_prefetch_threads)
+        pthread_mutex_unlock(&pls->prefetch_lock);
+}
+
+/*
+ * Find the next segment to assign to a prefetch thread, reloading the
+ * playlist of a live stream as needed. Called with prefetch_lock held,
+ * which is released while reloading and waiting for new segments.
+ * Returns 1 if a segment is available, 0 if the caller has to check its
+ * state again, a negative error code at the end of the playlist.
+ */
+static int prefetch_select_segment(HLSContext *c, struct playlist *pls)
+{
+    int64_t reload_interval = default_reload_interval(pls);
+    int ret;
+
+    for (;;) {
+        while (pls->prefetch_busy && !pls->prefetch_abort)
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+        if (pls->prefetch_abort)
+            return 0;
+        if (!pls->finished &&
+            av_gettime_relative() - pls->last_load_time >= reload_interval) {
+            pls->prefetch_busy = 1;
+            pthread_mutex_unlock(&pls->prefetch_lock);
+            ret = parse_playlist(c, pls->url, pls, NULL);
+            pthread_mutex_lock(&pls->prefetch_lock);
+            pls->prefetch_busy = 0;
+            prefetch_wake(pls);
+            if (ret < 0) {
+                av_log(pls->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+                       pls->index);
+                return ret;
+            }
+            reload_interval = pls->target_duration / 2;
+        }
+        if (pls->prefetch_abort)
+            return 0;
+        if (pls->prefetch_seq_no < pls->start_seq_no) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "skipping %d segments ahead, expired from playlists\n",
+                   pls->start_seq_no - pls->prefetch_seq_no);
+            pls->prefetch_seq_no = pls->start_seq_no;
+        }
+        if (pls->prefetch_seq_no < pls->start_seq_no + pls->n_segments)
+            return 1;
+        if (pls->finished)
+            return AVERROR_EOF;
+
+        ret = 0;
+        while (!pls->prefetch_abort && !pls->prefetch_busy &&
+               av_gettime_relative() - pls->last_load_time < reload_interval) {
+            pthread_mutex_unlock(&pls->prefetch_lock);
+            if (ff_check_interrupt(c->interrupt_callback))
+                ret = AVERROR_EXIT;
+            else
+                av_usleep(100*1000);
+            pthread_mutex_lock(&pls->prefetch_lock);
+            if (ret < 0)
+                return ret;
+        }
+    }
+}
+
+static int prefetch_copy_segment(struct segment *dst, const struct segment *src)
+{
+    *dst = *src;
+    dst->url = av_strdup(src->url);
+    dst->key = src->key ? av_strdup(src->key) : NULL;
+    if (!dst->url || (src->key && !dst->key)) {
+        av_freep(&dst->url);
+        av_freep(&dst->key);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void prefetch_download(HLSContext *c, struct playlist *pls,
+                              struct prefetch_entry *e)
+{
+    AVIOContext *in = NULL;
+    uint8_t buf[INITIAL_BUFFER_SIZE];
+    int64_t offset = 0;
+    int ret;
+
+    ret = open_input(c, pls, &e->seg, &in);
+    while (ret >= 0) {
+        uint8_t *data = NULL;
+        int size = sizeof(buf);
+
+        /* limit read if the segment was only a part of a file */
+        if (e->seg.size >= 0)
+            size = FFMIN(size, e->seg.size - offset);
+        if (size <= 0)
+            break;
+
+        ret = avio_read(in, buf, size);
+        if (ret <= 0)
+            break;
+        offset += ret;
+
+        pthread_mutex_lock(&pls->prefetch_lock);
+        if (pls->prefetch_abort) {
+            ret = AVERROR_EXIT;
+        } else if (e->size + ret > e->alloc_size &&
+                   !(data = av_fast_realloc(e->data, &e->alloc_size,
+                                            e->size + ret))) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            if (data)
+                e->data = data;
+            memcpy(e->data + e->size, buf, ret);
+            e->size += ret;
+            prefetch_wake(pls);
+        }
+        pthread_mutex_unlock(&pls->prefetch_lock);
+    }
+    if (in)
+        ff_format_io_close(pls->parent, &in);
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    e->error = ret == AVERROR_EOF ? 0 : FFMIN(ret, 0);
+    e->done  = 1;
+    prefetch_wake(pls);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    HLSContext *c = pls->parent->priv_data;
+    int window = pls->nb_prefetch_threads + 1;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    while (!pls->prefetch_abort) {
+        struct prefetch_entry *e;
+
+        if (pls->prefetch_busy || pls->prefetch_end ||
+            pls->prefetch_count == window) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+            continue;
+        }
+
+        ret = prefetch_select_segment(c, pls);
+        if (ret < 0) {
+            pls->prefetch_end   = 1;
+            pls->prefetch_error = ret;
+            prefetch_wake(pls);
+        }
+        if (ret <= 0 || pls->prefetch_count == window)
+            continue;
+
+        e = &pls->prefetch_entries[(pls->prefetch_head + pls->prefetch_count) % window];
+        ret = prefetch_copy_segment(&e->seg, pls->segments[pls->prefetch_seq_no - pls->start_seq_no]);
+        e->seq_no   = pls->prefetch_seq_no++;
+        e->size     = 0;
+        e->read_pos = 0;
+        e->done     = 0;
+        e->error    = 0;
+        pls->prefetch_count++;
+
+        pthread_mutex_unlock(&pls->prefetch_lock);
+        if (ret < 0) {
+            pthread_mutex_lock(&pls->prefetch_lock);
+            e->error = ret;
+            e->done  = 1;
+            prefetch_wake(pls);
+        } else {
+            prefetch_download(c, pls, e);
+            pthread_mutex_lock(&pls->prefetch_lock);
+        }
+    }
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    return NULL;
+}
+
+static void prefetch_stop(struct playlist *pls)
+{
+    int i;
+
+    if (!pls->nb_prefetch_threads)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    pls->prefetch_abort = 1;
+    prefetch_wake(pls);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    for (i = 0; i < pls->nb_prefetch_threads; i++)
+        pthread_join(pls->prefetch_threads[i], NULL);
+
+    for (i = 0; i < pls->prefetch_count; i++) {
+        struct prefetch_entry *e = &pls->prefetch_entries[(pls->prefetch_head + i) %
+                                                          (pls->nb_prefetch_threads + 1)];
+        av_freep(&e->seg.url);
+        av_freep(&e->seg.key);
+    }
+    for (i = 0; i <= pls->nb_prefetch_threads; i++)
+        av_freep(&pls->prefetch_entries[i].data);
+    av_freep(&pls->prefetch_entries);
+    av_freep(&pls->prefetch_threads);
+    pthread_cond_destroy(&pls->prefetch_cond);
+    pthread_mutex_destroy(&pls->prefetch_lock);
+    pls->nb_prefetch_threads = 0;
+    pls->prefetch_cur        = NULL;
+}
+
+static int prefetch_start(HLSContext *c, struct playlist *pls)
+{
+    int i, ret;
+
+    pls->prefetch_entries = av_mallocz_array(c->prefetch_segments + 1,
+                                             sizeof(*pls->prefetch_entries));
+    pls->prefetch_threads = av_mallocz_array(c->prefetch_segments,
+                                             sizeof(*pls->prefetch_threads));
+    if (!pls->prefetch_entries || !pls->prefetch_threads) {
+        av_freep(&pls->prefetch_entries);
+        av_freep(&pls->prefetch_threads);
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&pls->prefetch_lock, NULL);
+    pthread_cond_init(&pls->prefetch_cond, NULL);
+    pls->prefetch_head   = 0;
+    pls->prefetch_count  = 0;
+    pls->prefetch_seq_no = pls->cur_seq_no;
+    pls->prefetch_busy   = 0;
+    pls->prefetch_end    = 0;
+    pls->prefetch_error  = 0;
+    pls->prefetch_abort  = 0;
+
+    /* the threads get the window size from it */
+    pls->nb_prefetch_threads = c->prefetch_segments;
+    for (i = 0; i < c->prefetch_segments; i++) {
+        ret = pthread_create(&pls->prefetch_threads[i], NULL, prefetch_thread, pls);
+        if (ret) {
+            pthread_mutex_lock(&pls->prefetch_lock);
+            pls->prefetch_abort = 1;
+            prefetch_wake(pls);
+            pthread_mutex_unlock(&pls->prefetch_lock);
+            while (i--)
+                pthread_join(pls->prefetch_threads[i], NULL);
+            pls->nb_prefetch_threads = 0;
+            av_freep(&pls->prefetch_entries);
+            av_freep(&pls->prefetch_threads);
+            pthread_cond_destroy(&pls->prefetch_cond);
+            pthread_mutex_destroy(&pls->prefetch_lock);
+            return AVERROR(ret);
+        }
+    }
+
+    return 0;
+}
+
+/* Make the next prefetched segment the one read by the demuxer. */
+static int prefetch_open_segment(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_entry *e;
+    int ret;
+
+    if (!pls->nb_prefetch_threads && (ret = prefetch_start(c, pls)) < 0)
+        return ret;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    for (;;) {
+        while (!pls->prefetch_count && !pls->prefetch_end)
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+        if (!pls->prefetch_count) {
+            pthread_mutex_unlock(&pls->prefetch_lock);
+            return pls->prefetch_error;
+        }
+
+        e = &pls->prefetch_entries[pls->prefetch_head];
+        while (!e->size && !e->done)
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+        if (e->size || !e->error)
+            break;
+
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to open segment of playlist %d\n",
+               pls->index);
+        av_freep(&e->seg.url);
+        av_freep(&e->seg.key);
+        pls->prefetch_head = (pls->prefetch_head + 1) % (pls->nb_prefetch_threads + 1);
+        pls->prefetch_count--;
+        prefetch_wake(pls);
+        if (ff_check_interrupt(c->interrupt_callback)) {
+            pthread_mutex_unlock(&pls->prefetch_lock);
+            return AVERROR_EXIT;
+        }
+    }
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    pls->cur_seq_no = e->seq_no;
+
+    /* load/update Media Initialization Section, if any */
+    ret = update_init_section(pls, e->seg.init_section);
+    if (ret)
+        return ret;
+
+    pls->prefetch_cur   = e;
+    pls->cur_seg_offset = 0;
+    return 0;
+}
+
+static void prefetch_close_segment(struct playlist *pls)
+{
+    struct prefetch_entry *e = pls->prefetch_cur;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    av_freep(&e->seg.url);
+    av_freep(&e->seg.key);
+    pls->prefetch_head = (pls->prefetch_head + 1) % (pls->nb_prefetch_threads + 1);
+    pls->prefetch_count--;
+    prefetch_wake(pls);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    pls->prefetch_cur = NULL;
+}
+#else
+static void prefetch_lock_segments(struct playlist *pls)
+{
+}
+
+static void prefetch_unlock_segments(struct playlist *pls)
+{
+}
+
+static void prefetch_stop(struct playlist *pls)
+{
+}
+
+static int prefetch_open_segment(HLSContext *c, struct playlist *pls)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void prefetch_close_segment(struct playlist *pls)
+{
+}
+#endif
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
     HLSContext *c = v->parent->priv_data;
+    struct segment *seg;
     int ret, i;
     int just_opened = 0;
 
@@ -1248,9 +1713,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    if (!v->input && !v->prefetch_cur) {
         int64_t reload_interval;
-        struct segment *seg;
 
         /* Check that the playlist is still needed before opening a new
          * segment. */
@@ -1266,9 +1730,17 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            prefetch_stop(v);
             return AVERROR_EOF;
         }
 
+        if (c->prefetch_segments) {
+            if ((ret = prefetch_open_segment(c, v)) < 0)
+                return ret;
+            just_opened = 1;
+            goto opened;
+        }
+
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
@@ -1307,11 +1779,12 @@ reload:
         seg = current_segment(v);
 
         /* load/update Media Initialization Section, if any */
-        ret = update_init_section(v, seg);
+        ret = update_init_section(v, seg->init_section);
         if (ret)
             return ret;
 
-        ret = open_input(c, v, seg);
+        ret = open_input(c, v, seg, &v->input);
+        v->cur_seg_offset = 0;
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
                 return AVERROR_EXIT;
@@ -1323,6 +1796,7 @@ reload:
         just_opened = 1;
     }
 
+opened:
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
         /* Push init section out first before first actual segment */
         int copy_size = FFMIN(v->init_sec_data_len - v->init_sec_buf_read_offset, buf_size);
@@ -1331,17 +1805,21 @@ reload:
         return copy_size;
     }
 
-    ret = read_from_url(v, current_segment(v), buf, buf_size, READ_NORMAL);
+    seg = v->prefetch_cur ? &v->prefetch_cur->seg : current_segment(v);
+    ret = read_from_url(v, seg, buf, buf_size, READ_NORMAL);
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
             /* Intercept ID3 tags here, elementary audio streams are required
              * to convey timestamps using them in the beginning of each segment. */
-            intercept_id3(v, buf, buf_size, &ret);
+            intercept_id3(v, seg, buf, buf_size, &ret);
         }
 
         return ret;
     }
-    ff_format_io_close(v->parent, &v->input);
+    if (v->prefetch_cur)
+        prefetch_close_segment(v);
+    else
+        ff_format_io_close(v->parent, &v->input);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1596,12 +2074,17 @@ static void update_noheader_flag(AVFormatContext *s)
 static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
+    int i;
+
+    for (i = 0; i < c->n_playlists; i++)
+        prefetch_stop(c->playlists[i]);
 
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
 
     av_dict_free(&c->avio_opts);
+    ff_mutex_destroy(&c->shared_lock);
 
     return 0;
 }
@@ -1621,6 +2104,12 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+    ff_mutex_init(&c->shared_lock, NULL);
+    if (!HAVE_THREADS && c->prefetch_segments) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching requires threads\n");
+        c->prefetch_segments = 0;
+    }
+
     if (u) {
         // get the previous user agent & set back to null if string size is zero
         update_options(&c->user_agent, "user_agent", u);
@@ -1844,6 +2333,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         } else if (first && !pls->cur_needed && pls->needed) {
             if (pls->input)
                 ff_format_io_close(pls->parent, &pls->input);
+            prefetch_stop(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2030,15 +2520,22 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
 {
     HLSContext *c = s->priv_data;
     struct playlist *seek_pls = NULL;
-    int i, seq_no;
+    int i, ret, seq_no;
     int j;
     int stream_subdemuxer_index;
     int64_t first_timestamp, seek_timestamp, duration;
 
-    if ((flags & AVSEEK_FLAG_BYTE) ||
-        !(c->variants[0]->playlists[0]->finished || c->variants[0]->playlists[0]->type == PLS_TYPE_EVENT))
+    if (flags & AVSEEK_FLAG_BYTE)
         return AVERROR(ENOSYS);
 
+    seek_pls = c->variants[0]->playlists[0];
+    prefetch_lock_segments(seek_pls);
+    ret = seek_pls->finished || seek_pls->type == PLS_TYPE_EVENT;
+    prefetch_unlock_segments(seek_pls);
+    if (!ret)
+        return AVERROR(ENOSYS);
+    seek_pls = NULL;
+
     first_timestamp = c->first_timestamp == AV_NOPTS_VALUE ?
                       0 : c->first_timestamp;
 
@@ -2066,9 +2563,18 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     }
     /* check if the timestamp is valid for the playlist with the
      * specified stream index */
-    if (!seek_pls || !find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no))
+    if (!seek_pls)
+        return AVERROR(EIO);
+    prefetch_lock_segments(seek_pls);
+    ret = find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no);
+    prefetch_unlock_segments(seek_pls);
+    if (!ret)
         return AVERROR(EIO);
 
+    /* the prefetched data is stale, and the threads own the segment lists */
+    for (i = 0; i < c->n_playlists; i++)
+        prefetch_stop(c->playlists[i]);
+
     /* set segment now so we do not need to search again below */
     seek_pls->cur_seq_no = seq_no;
     seek_pls->seek_stream_index = stream_subdemuxer_index;
@@ -2126,6 +2632,8 @@ static int hls_probe(AVProbeData *p)
 static const AVOption hls_options[] = {
     {"live_start_index", "segment index to start live streams at (negative values are from the end)",
         OFFSET(live_start_index), AV_OPT_TYPE_INT, {.i64 = -3}, INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "number of segments to download ahead of the demuxer in background threads, per playlist",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
     {NULL}
 };
 
@@ -36,6 +36,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/random_seed.h"
 #include "libavutil/opt.h"
@@ -68,9 +69,19 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    double prog_date_time;
+    char *entry;    ///< playlist lines of the segment, without the key tag
+
     struct HLSSegment *next;
 } HLSSegment;
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef enum HLSFlags {
     // Generate a single media file and use byte ranges in the playlist.
     HLS_SINGLE_FILE = (1 << 0),
@@ -164,6 +175,17 @@ typedef struct HLSContext {
 
     double initial_prog_date_time;
     char current_segment_final_filename_fmt[1024]; // when renaming segments
+
+    float part_time;       // Set by a private option.
+    double part_target;    // longest part duration, at least part_time
+    HLSPart *parts;        // parts of the segment being written
+    int nb_parts;
+    unsigned parts_size;
+    int64_t part_start_pts;
+    int64_t part_start_pos;
+    int part_independent;
+    uint8_t *playlist_head; // playlist up to the parts, kept until a segment is added
+    int playlist_head_size;
 } HLSContext;
 
 static int get_int_from_double(double val)
@@ -717,6 +739,61 @@ static int sls_flag_use_localtime_filename(AVFormatContext *oc, HLSContext *c)
 }
 
 /* Create a new segment and append it to the segment list */
+static void write_prog_date_time(AVBPrint *out, double prog_date_time)
+{
+    time_t tt, wrongsecs;
+    int milli;
+    struct tm *tm, tmpbuf;
+    char buf0[128], buf1[128];
+    tt = (int64_t)prog_date_time;
+    milli = av_clip(lrint(1000*(prog_date_time - tt)), 0, 999);
+    tm = localtime_r(&tt, &tmpbuf);
+    strftime(buf0, sizeof(buf0), "%Y-%m-%dT%H:%M:%S", tm);
+    if (!strftime(buf1, sizeof(buf1), "%z", tm) || buf1[1]<'0' ||buf1[1]>'2') {
+        int tz_min, dst = tm->tm_isdst;
+        tm = gmtime_r(&tt, &tmpbuf);
+        tm->tm_isdst = dst;
+        wrongsecs = mktime(tm);
+        tz_min = (abs(wrongsecs - tt) + 30) / 60;
+        snprintf(buf1, sizeof(buf1),
+                 "%c%02d%02d",
+                 wrongsecs <= tt ? '+' : '-',
+                 tz_min / 60,
+                 tz_min % 60);
+    }
+    av_bprintf(out, "#EXT-X-PROGRAM-DATE-TIME:%s.%03d%s\n", buf0, milli, buf1);
+}
+
+/**
+ * Format the playlist lines of a segment once, as they do not change while
+ * the segment stays in the playlist, so that long playlists are rewritten
+ * without formatting all their entries again.
+ */
+static int format_segment_entry(HLSContext *hls, HLSSegment *en)
+{
+    AVBPrint out;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+
+    av_bprint_init(&out, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (en->discont)
+        av_bprintf(&out, "#EXT-X-DISCONTINUITY\n");
+
+    if (hls->flags & HLS_ROUND_DURATIONS)
+        av_bprintf(&out, "#EXTINF:%ld,\n",  lrint(en->duration));
+    else
+        av_bprintf(&out, "#EXTINF:%f,\n", en->duration);
+    if (byterange_mode)
+        av_bprintf(&out, "#EXT-X-BYTERANGE:%"PRIi64"@%"PRIi64"\n",
+                   en->size, en->pos);
+    if (hls->flags & HLS_PROGRAM_DATE_TIME)
+        write_prog_date_time(&out, en->prog_date_time);
+    if (hls->baseurl)
+        av_bprintf(&out, "%s", hls->baseurl);
+    av_bprintf(&out, "%s\n", en->filename);
+
+    return av_bprint_finalize(&out, &en->entry);
+}
+
 static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double duration,
                               int64_t pos, int64_t size)
 {
@@ -724,6 +801,8 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double
     const char  *filename;
     int ret;
 
+    av_freep(&hls->playlist_head);
+
     if (!en)
         return AVERROR(ENOMEM);
 
@@ -764,6 +843,14 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double
         av_strlcpy(en->iv_string, hls->iv_string, sizeof(en->iv_string));
     }
 
+    en->prog_date_time = hls->segments ? hls->last_segment->prog_date_time +
+                                         hls->last_segment->duration :
+                                         hls->initial_prog_date_time;
+    if ((ret = format_segment_entry(hls, en)) < 0) {
+        av_free(en);
+        return ret;
+    }
+
     if (!hls->segments)
         hls->segments = en;
     else
@@ -779,6 +866,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls, double
         en = hls->segments;
         hls->initial_prog_date_time += en->duration;
         hls->segments = en->next;
+        av_freep(&en->entry);
         if (en && hls->flags & HLS_DELETE_SEGMENTS &&
 #if FF_API_HLS_WRAP
                 !(hls->flags & HLS_SINGLE_FILE || hls->wrap)) {
@@ -894,6 +982,7 @@ static void hls_free_segments(HLSSegment *p)
     while(p) {
         en = p;
         p = p->next;
+        av_free(en->entry);
         av_free(en);
     }
 }
@@ -952,13 +1041,16 @@ static int hls_window(AVFormatContext *s, int last)
     char *key_uri = NULL;
     char *iv_string = NULL;
     AVDictionary *options = NULL;
-    double prog_date_time = hls->initial_prog_date_time;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int write_sub = 0;
+    int i;
 
     if (byterange_mode) {
         version = 4;
         sequence = 0;
     }
+    if (hls->part_time > 0)
+        version = 4;
 
     if (!use_rename && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
@@ -968,78 +1060,70 @@ static int hls_window(AVFormatContext *s, int last)
     if ((ret = s->io_open(s, &out, temp_filename, AVIO_FLAG_WRITE, &options)) < 0)
         goto fail;
 
-    for (en = hls->segments; en; en = en->next) {
-        if (target_duration <= en->duration)
-            target_duration = get_int_from_double(en->duration);
-    }
+    /* on a part boundary, only the parts after the segments have changed */
+    if (last || !hls->playlist_head) {
+        AVIOContext *head;
 
-    hls->discontinuity_set = 0;
-    write_m3u8_head_block(hls, out, version, target_duration, sequence);
-    if (hls->pl_type == PLAYLIST_TYPE_EVENT) {
-        avio_printf(out, "#EXT-X-PLAYLIST-TYPE:EVENT\n");
-    } else if (hls->pl_type == PLAYLIST_TYPE_VOD) {
-        avio_printf(out, "#EXT-X-PLAYLIST-TYPE:VOD\n");
-    }
+        if ((ret = avio_open_dyn_buf(&head)) < 0)
+            goto fail;
+        for (en = hls->segments; en; en = en->next) {
+            if (target_duration <= en->duration)
+                target_duration = get_int_from_double(en->duration);
+        }
+        if (hls->part_time > 0)
+            target_duration = FFMAX(target_duration, get_int_from_double(hls->time));
+
+        hls->discontinuity_set = 0;
+        write_m3u8_head_block(hls, head, version, target_duration, sequence);
+        if (hls->part_time > 0) {
+            avio_printf(head, "#EXT-X-PART-INF:PART-TARGET=%f\n", hls->part_target);
+            avio_printf(head, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%f\n", 3 * hls->part_target);
+        }
+        if (hls->pl_type == PLAYLIST_TYPE_EVENT) {
+            avio_printf(head, "#EXT-X-PLAYLIST-TYPE:EVENT\n");
+        } else if (hls->pl_type == PLAYLIST_TYPE_VOD) {
+            avio_printf(head, "#EXT-X-PLAYLIST-TYPE:VOD\n");
+        }
 
-    if((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && hls->discontinuity_set==0 ){
-        avio_printf(out, "#EXT-X-DISCONTINUITY\n");
-        hls->discontinuity_set = 1;
-    }
-    for (en = hls->segments; en; en = en->next) {
-        if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
-                                    av_strcasecmp(en->iv_string, iv_string))) {
-            avio_printf(out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
-            if (*en->iv_string)
-                avio_printf(out, ",IV=0x%s", en->iv_string);
-            avio_printf(out, "\n");
-            key_uri = en->key_uri;
-            iv_string = en->iv_string;
+        if((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && hls->discontinuity_set==0 ){
+            avio_printf(head, "#EXT-X-DISCONTINUITY\n");
+            hls->discontinuity_set = 1;
         }
+        for (en = hls->segments; en; en = en->next) {
+            if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
+                                        av_strcasecmp(en->iv_string, iv_string))) {
+                avio_printf(head, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
+                if (*en->iv_string)
+                    avio_printf(head, ",IV=0x%s", en->iv_string);
+                avio_printf(head, "\n");
+                key_uri = en->key_uri;
+                iv_string = en->iv_string;
+            }
 
-        if (en->discont) {
-            avio_printf(out, "#EXT-X-DISCONTINUITY\n");
+            avio_write(head, en->entry, strlen(en->entry));
         }
 
-        if (hls->flags & HLS_ROUND_DURATIONS)
-            avio_printf(out, "#EXTINF:%ld,\n",  lrint(en->duration));
-        else
-            avio_printf(out, "#EXTINF:%f,\n", en->duration);
-        if (byterange_mode)
-             avio_printf(out, "#EXT-X-BYTERANGE:%"PRIi64"@%"PRIi64"\n",
-                         en->size, en->pos);
-        if (hls->flags & HLS_PROGRAM_DATE_TIME) {
-            time_t tt, wrongsecs;
-            int milli;
-            struct tm *tm, tmpbuf;
-            char buf0[128], buf1[128];
-            tt = (int64_t)prog_date_time;
-            milli = av_clip(lrint(1000*(prog_date_time - tt)), 0, 999);
-            tm = localtime_r(&tt, &tmpbuf);
-            strftime(buf0, sizeof(buf0), "%Y-%m-%dT%H:%M:%S", tm);
-            if (!strftime(buf1, sizeof(buf1), "%z", tm) || buf1[1]<'0' ||buf1[1]>'2') {
-                int tz_min, dst = tm->tm_isdst;
-                tm = gmtime_r(&tt, &tmpbuf);
-                tm->tm_isdst = dst;
-                wrongsecs = mktime(tm);
-                tz_min = (abs(wrongsecs - tt) + 30) / 60;
-                snprintf(buf1, sizeof(buf1),
-                         "%c%02d%02d",
-                         wrongsecs <= tt ? '+' : '-',
-                         tz_min / 60,
-                         tz_min % 60);
-            }
-            avio_printf(out, "#EXT-X-PROGRAM-DATE-TIME:%s.%03d%s\n", buf0, milli, buf1);
-            prog_date_time += en->duration;
+        av_freep(&hls->playlist_head);
+        hls->playlist_head_size = avio_close_dyn_buf(head, &hls->playlist_head);
+        write_sub = 1;
+    }
+    avio_write(out, hls->playlist_head, hls->playlist_head_size);
+
+    if (!last && hls->nb_parts) {
+        const char *filename = hls->use_localtime_mkdir ? hls->avf->filename :
+                               av_basename(hls->avf->filename);
+        for (i = 0; i < hls->nb_parts; i++) {
+            HLSPart *part = &hls->parts[i];
+            avio_printf(out, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\",BYTERANGE=\"%"PRIi64"@%"PRIi64"\"%s\n",
+                        part->duration, hls->baseurl ? hls->baseurl : "", filename,
+                        part->size, part->pos, part->independent ? ",INDEPENDENT=YES" : "");
         }
-        if (hls->baseurl)
-            avio_printf(out, "%s", hls->baseurl);
-        avio_printf(out, "%s\n", en->filename);
     }
 
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         avio_printf(out, "#EXT-X-ENDLIST\n");
 
-    if( hls->vtt_m3u8_name ) {
+    if (hls->vtt_m3u8_name && write_sub) {
         if ((ret = s->io_open(s, &sub_out, hls->vtt_m3u8_name, AVIO_FLAG_WRITE, &options)) < 0)
             goto fail;
         write_m3u8_head_block(hls, sub_out, version, target_duration, sequence);
@@ -1260,8 +1344,20 @@ static int hls_write_header(AVFormatContext *s)
     hls->sequence       = hls->start_sequence;
     hls->recording_time = (hls->init_time ? hls->init_time : hls->time) * AV_TIME_BASE;
     hls->start_pts      = AV_NOPTS_VALUE;
+    hls->part_start_pts = AV_NOPTS_VALUE;
     hls->current_segment_final_filename_fmt[0] = '\0';
 
+    if (hls->part_time > 0 &&
+        (hls->encrypt || hls->key_info_file ||
+         hls->flags & (HLS_TEMP_FILE | HLS_SECOND_LEVEL_SEGMENT_DURATION |
+                       HLS_SECOND_LEVEL_SEGMENT_SIZE))) {
+        av_log(s, AV_LOG_WARNING, "Partial segments are not supported with "
+               "encryption or segment files renamed when complete, "
+               "hls_part_time has no effect\n");
+        hls->part_time = 0;
+    }
+    hls->part_target = hls->part_time;
+
     if (hls->flags & HLS_PROGRAM_DATE_TIME) {
         time_t now0;
         time(&now0);
@@ -1440,6 +1536,44 @@ fail:
     return ret;
 }
 
+/**
+ * End the current part of the segment being written before pkt, and
+ * announce it in the playlist.
+ */
+static int hls_cut_part(AVFormatContext *s, AVPacket *pkt, int independent)
+{
+    HLSContext *hls = s->priv_data;
+    AVStream *st = s->streams[pkt->stream_index];
+    HLSPart *part;
+    int64_t pos;
+
+    av_write_frame(hls->avf, NULL); /* Flush any buffered data */
+    avio_flush(hls->avf->pb);
+    pos = avio_tell(hls->avf->pb);
+    if (pos > hls->part_start_pos) {
+        part = av_fast_realloc(hls->parts, &hls->parts_size,
+                               (hls->nb_parts + 1) * sizeof(*hls->parts));
+        if (!part)
+            return AVERROR(ENOMEM);
+        hls->parts = part;
+        part = &hls->parts[hls->nb_parts++];
+        part->duration    = (double)(pkt->pts - hls->part_start_pts) * st->time_base.num / st->time_base.den;
+        part->pos         = hls->part_start_pos;
+        part->size        = pos - hls->part_start_pos;
+        part->independent = hls->part_independent;
+        /* a single packet may be longer than part_time */
+        if (part->duration > hls->part_target) {
+            hls->part_target = part->duration;
+            av_freep(&hls->playlist_head);
+        }
+    }
+    hls->part_start_pos   = pos;
+    hls->part_start_pts   = pkt->pts;
+    hls->part_independent = independent;
+
+    return hls->nb_parts ? hls_window(s, 0) : 0;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -1447,7 +1581,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVStream *st = s->streams[pkt->stream_index];
     int64_t end_pts = hls->recording_time * hls->number;
     int is_ref_pkt = 1;
-    int ret, can_split = 1;
+    int ret, can_split = 1, independent;
     int stream_index = 0;
 
     if (hls->sequence - hls->nb_entries > hls->start_sequence && hls->init_time > 0) {
@@ -1477,6 +1611,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     if (pkt->pts == AV_NOPTS_VALUE)
         is_ref_pkt = can_split = 0;
+    independent = !hls->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
 
     if (is_ref_pkt) {
         if (hls->new_start) {
@@ -1555,10 +1690,25 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+        hls->nb_parts         = 0;
+        hls->part_start_pts   = pkt->pts;
+        hls->part_start_pos   = avio_tell(hls->avf->pb);
+        hls->part_independent = independent;
+
         if ((ret = hls_window(s, 0)) < 0) {
             av_free(old_filename);
             return ret;
         }
+    } else if (hls->part_time > 0 && is_ref_pkt) {
+        if (hls->part_start_pts == AV_NOPTS_VALUE) {
+            hls->part_start_pts   = pkt->pts;
+            hls->part_independent = independent;
+        } else if (av_compare_ts(pkt->pts + pkt->duration - hls->part_start_pts, st->time_base,
+                                 hls->part_time * AV_TIME_BASE, AV_TIME_BASE_Q) > 0) {
+            /* end the part before this packet makes it longer than part_time */
+            if ((ret = hls_cut_part(s, pkt, independent)) < 0)
+                return ret;
+        }
     }
 
     ret = ff_write_chained(oc, stream_index, pkt, s, 0);
@@ -1614,6 +1764,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
 
     hls_free_segments(hls->segments);
     hls_free_segments(hls->old_segments);
+    av_freep(&hls->parts);
+    av_freep(&hls->playlist_head);
     av_free(old_filename);
     return 0;
 }
@@ -1625,6 +1777,7 @@ static const AVOption options[] = {
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
+    {"hls_part_time", "set partial segment length in seconds, 0 to disable partial segments", OFFSET(part_time), AV_OPT_TYPE_FLOAT, {.dbl = 0}, 0, FLT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"hls_vtt_options","set hls vtt list of options for the container format used for hls", OFFSET(vtt_format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
 #if FF_API_HLS_WRAP
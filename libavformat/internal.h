@@ -191,6 +191,13 @@ struct AVStreamInternal {
      * Whether the internal avctx needs to be updated from codecpar (after a late change to codecpar)
      */
     int need_context_update;
+
+    /**
+     * Packed storage of the index, used instead of AVStream.index_entries
+     * for demuxers with AVFMT_GENERIC_INDEX, which must only access the
+     * index through the index functions.
+     */
+    struct FFPackedIndex *packed_index;
 };
 
 #ifdef __GNUC__
@@ -346,6 +353,11 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
+/**
+ * Add offset to the position of all the index entries of the stream.
+ */
+void ff_index_shift_pos(AVStream *st, int64_t offset);
+
 /**
  * Add a new chapter.
  *
@@ -564,6 +576,14 @@ int ff_alloc_extradata(AVCodecParameters *par, int size);
  */
 int ff_get_extradata(AVFormatContext *s, AVCodecParameters *par, AVIOContext *pb, int size);
 
+/**
+ * Like av_get_packet(), but the packet references the data of the protocol
+ * without copying it when possible, see ffio_read_buffer_ref(). The caller
+ * must not modify the packet data in place, and the padding after it is not
+ * zeroed in that case.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 /**
  * add frame for rfps calculation.
  *
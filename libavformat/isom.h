@@ -230,6 +230,9 @@ typedef struct MOVStreamContext {
     int start_pad;        ///< amount of samples to skip due to enc-dec delay
     unsigned int rap_group_count;
     MOVSbgp *rap_group;
+    int index_pending;    ///< index not built yet, see the lazy_index option
+    int64_t *rfps_dts;    ///< timestamps given to ff_rfps_add_frame(), kept for the index cache
+    int rfps_count;
 
     int nb_frames_for_fps;
     int64_t duration_for_fps;
@@ -336,6 +339,10 @@ typedef struct MOVContext {
     int decryption_key_len;
     int enable_drefs;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
+    char *index_cache_path; ///< sidecar file caching the sample index of the tracks
+    struct MOVIndexCache *index_cache; ///< state of the index cache, see movindex.h
+    int lazy_index;
+    int sample_tables_only; ///< only parse the atoms skipped for the index cache
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
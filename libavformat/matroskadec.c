@@ -106,6 +106,7 @@ typedef struct EbmlBin {
     int      size;
     uint8_t *data;
     int64_t  pos;
+    AVBufferRef *buf; ///< set if data references the protocol data instead of being allocated
 } EbmlBin;
 
 typedef struct Ebml {
@@ -961,8 +962,34 @@ static int ebml_read_ascii(AVIOContext *pb, int size, char **str)
  * Read the next element as binary data.
  * 0 is success, < 0 is failure.
  */
-static int ebml_read_binary(AVIOContext *pb, int length, EbmlBin *bin)
+static int ebml_read_binary(AVIOContext *pb, int length, EbmlBin *bin,
+                            int zero_copy)
 {
+    if (bin->buf) {
+        av_buffer_unref(&bin->buf);
+        bin->data = NULL;
+        bin->size = 0;
+    }
+
+    if (zero_copy) {
+        int64_t pos = avio_tell(pb);
+        AVBufferRef *buf;
+        int ret = ffio_read_buffer_ref(pb, &buf, length);
+        if (ret == length) {
+            av_freep(&bin->data);
+            bin->buf  = buf;
+            bin->data = buf->data;
+            bin->size = length;
+            bin->pos  = pos;
+            return 0;
+        }
+        if (ret != AVERROR(ENOSYS)) {
+            if (ret >= 0)
+                av_buffer_unref(&buf);
+            return AVERROR(EIO);
+        }
+    }
+
     av_fast_padded_malloc(&bin->data, &bin->size, length);
     if (!bin->data)
         return AVERROR(ENOMEM);
@@ -1209,7 +1236,9 @@ static int ebml_parse_elem(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, data);
+        res = ebml_read_binary(pb, length, data,
+                               syntax->id == MATROSKA_ID_BLOCK ||
+                               syntax->id == MATROSKA_ID_SIMPLEBLOCK);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
@@ -1253,7 +1282,11 @@ static void ebml_free(EbmlSyntax *syntax, void *data)
             av_freep(data_off);
             break;
         case EBML_BIN:
-            av_freep(&((EbmlBin *) data_off)->data);
+            if (((EbmlBin *) data_off)->buf) {
+                av_buffer_unref(&((EbmlBin *) data_off)->buf);
+                ((EbmlBin *) data_off)->data = NULL;
+            } else
+                av_freep(&((EbmlBin *) data_off)->data);
             break;
         case EBML_LEVEL1:
         case EBML_NEST:
@@ -3137,7 +3170,7 @@ static int matroska_parse_webvtt(MatroskaDemuxContext *matroska,
 
 static int matroska_parse_frame(MatroskaDemuxContext *matroska,
                                 MatroskaTrack *track, AVStream *st,
-                                uint8_t *data, int pkt_size,
+                                AVBufferRef *buf, uint8_t *data, int pkt_size,
                                 uint64_t timecode, uint64_t lace_duration,
                                 int64_t pos, int is_keyframe,
                                 uint8_t *additional, uint64_t additional_id, int additional_size,
@@ -3177,20 +3210,34 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
             av_freep(&pkt_data);
         return AVERROR(ENOMEM);
     }
-    /* XXX: prevent data copy... */
-    if (av_new_packet(pkt, pkt_size + offset) < 0) {
-        av_free(pkt);
-        res = AVERROR(ENOMEM);
-        goto fail;
-    }
+    if (buf && pkt_data == data && !offset &&
+        data + pkt_size == buf->data + buf->size) {
+        /* reference the end of the block read from the protocol, which is
+         * padded, without copying it */
+        av_init_packet(pkt);
+        pkt->buf = av_buffer_ref(buf);
+        if (!pkt->buf) {
+            av_free(pkt);
+            return AVERROR(ENOMEM);
+        }
+        pkt->data = data;
+        pkt->size = pkt_size;
+    } else {
+        /* XXX: prevent data copy... */
+        if (av_new_packet(pkt, pkt_size + offset) < 0) {
+            av_free(pkt);
+            res = AVERROR(ENOMEM);
+            goto fail;
+        }
 
-    if (st->codecpar->codec_id == AV_CODEC_ID_PRORES && offset == 8) {
-        uint8_t *buf = pkt->data;
-        bytestream_put_be32(&buf, pkt_size);
-        bytestream_put_be32(&buf, MKBETAG('i', 'c', 'p', 'f'));
-    }
+        if (st->codecpar->codec_id == AV_CODEC_ID_PRORES && offset == 8) {
+            uint8_t *p = pkt->data;
+            bytestream_put_be32(&p, pkt_size);
+            bytestream_put_be32(&p, MKBETAG('i', 'c', 'p', 'f'));
+        }
 
-    memcpy(pkt->data + offset, pkt_data, pkt_size);
+        memcpy(pkt->data + offset, pkt_data, pkt_size);
+    }
 
     if (pkt_data != data)
         av_freep(&pkt_data);
@@ -3256,8 +3303,8 @@ fail:
     return res;
 }
 
-static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
-                                int size, int64_t pos, uint64_t cluster_time,
+static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf,
+                                uint8_t *data, int size, int64_t pos, uint64_t cluster_time,
                                 uint64_t block_duration, int is_keyframe,
                                 uint8_t *additional, uint64_t additional_id, int additional_size,
                                 int64_t cluster_pos, int64_t discard_padding)
@@ -3374,7 +3421,7 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
             if (res)
                 goto end;
         } else {
-            res = matroska_parse_frame(matroska, track, st, data, lace_size[n],
+            res = matroska_parse_frame(matroska, track, st, buf, data, lace_size[n],
                                        timecode, lace_duration, pos,
                                        !n ? is_keyframe : 0,
                                        additional, additional_id, additional_size,
@@ -3438,7 +3485,7 @@ static int matroska_parse_cluster_incremental(MatroskaDemuxContext *matroska)
                                     blocks[i].additional.data : NULL;
             if (!blocks[i].non_simple)
                 blocks[i].duration = 0;
-            res = matroska_parse_block(matroska, blocks[i].bin.data,
+            res = matroska_parse_block(matroska, blocks[i].bin.buf, blocks[i].bin.data,
                                        blocks[i].bin.size, blocks[i].bin.pos,
                                        matroska->current_cluster.timecode,
                                        blocks[i].duration, is_keyframe,
@@ -3472,7 +3519,7 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
     for (i = 0; i < blocks_list->nb_elem; i++)
         if (blocks[i].bin.size > 0 && blocks[i].bin.data) {
             int is_keyframe = blocks[i].non_simple ? blocks[i].reference == INT64_MIN : -1;
-            res = matroska_parse_block(matroska, blocks[i].bin.data,
+            res = matroska_parse_block(matroska, blocks[i].bin.buf, blocks[i].bin.data,
                                        blocks[i].bin.size, blocks[i].bin.pos,
                                        cluster.timecode, blocks[i].duration,
                                        is_keyframe, NULL, 0, 0, pos,
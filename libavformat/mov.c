@@ -57,6 +57,7 @@
 #include "libavcodec/get_bits.h"
 #include "id3v1.h"
 #include "mov_chan.h"
+#include "movindex.h"
 #include "replaygain.h"
 
 #if CONFIG_ZLIB
@@ -1155,6 +1156,7 @@ static int mov_read_moov(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     }
 
+    ff_mov_index_cache_check_moov(c, avio_tell(pb), atom.size);
     if ((ret = mov_read_default(c, pb, atom)) < 0)
         return ret;
     /* we parsed the 'moov' atom, we can terminate the parsing as soon as we find the 'mdat' */
@@ -1775,6 +1777,10 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     if (!entries)
         return 0;
+    if (ff_mov_index_cache_has_track(c, st->index)) {
+        sc->chunk_count = entries;
+        return 0;
+    }
 
     if (sc->chunk_offsets)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated STCO atom\n");
@@ -2471,6 +2477,8 @@ static int mov_read_stps(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     avio_rb32(pb); // version + flags
 
     entries = avio_rb32(pb);
+    if (ff_mov_index_cache_has_track(c, st->index))
+        return 0;
     if (sc->stps_data)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated STPS atom\n");
     av_free(sc->stps_data);
@@ -2516,6 +2524,8 @@ static int mov_read_stss(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             st->need_parsing = AVSTREAM_PARSE_HEADERS;
         return 0;
     }
+    if (ff_mov_index_cache_has_track(c, st->index))
+        return 0;
     if (sc->keyframes)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated STSS atom\n");
     if (entries >= UINT_MAX / sizeof(int))
@@ -2571,7 +2581,7 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     av_log(c->fc, AV_LOG_TRACE, "sample_size = %u sample_count = %u\n", sc->sample_size, entries);
 
     sc->sample_count = entries;
-    if (sample_size)
+    if (sample_size || ff_mov_index_cache_has_track(c, st->index))
         return 0;
 
     if (field_size != 4 && field_size != 8 && field_size != 16 && field_size != 32) {
@@ -2721,7 +2731,7 @@ static int mov_read_ctts(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     av_log(c->fc, AV_LOG_TRACE, "track[%u].ctts.entries = %u\n", c->fc->nb_streams - 1, entries);
 
-    if (!entries)
+    if (!entries || ff_mov_index_cache_has_track(c, st->index))
         return 0;
     if (entries >= UINT_MAX / sizeof(*sc->ctts_data))
         return AVERROR_INVALIDDATA;
@@ -2791,7 +2801,7 @@ static int mov_read_sbgp(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         avio_rb32(pb); /* grouping_type_parameter */
 
     entries = avio_rb32(pb);
-    if (!entries)
+    if (!entries || ff_mov_index_cache_has_track(c, st->index))
         return 0;
     if (sc->rap_group)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated SBGP atom\n");
@@ -3377,6 +3387,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
+        if (mov->index_cache && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !sc->rfps_dts)
+            sc->rfps_dts = av_malloc_array(100, sizeof(*sc->rfps_dts));
         if (av_reallocp_array(&st->index_entries,
                               st->nb_index_entries + sc->sample_count,
                               sizeof(*st->index_entries)) < 0) {
@@ -3450,8 +3462,13 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
                             "size %u, distance %u, keyframe %d\n", st->index, current_sample,
                             current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100)
-                        ff_rfps_add_frame(mov->fc, st, current_dts);
+                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100) {
+                        /* the frame rate is guessed while reading the header only */
+                        if (!sc->index_pending)
+                            ff_rfps_add_frame(mov->fc, st, current_dts);
+                        if (sc->rfps_dts)
+                            sc->rfps_dts[sc->rfps_count++] = current_dts;
+                    }
                 }
 
                 current_offset += sample_size;
@@ -3593,6 +3610,93 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     }
 }
 
+static void mov_free_sample_tables(MOVStreamContext *sc)
+{
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->elst_data);
+    av_freep(&sc->rap_group);
+}
+
+/**
+ * @return 1 for the atoms containing the sample tables skipped when the
+ *         index of a track is read from the index cache
+ */
+static int mov_is_skipped_sample_table(uint32_t type)
+{
+    switch (type) {
+    case MKTAG('m','d','i','a'):
+    case MKTAG('m','i','n','f'):
+    case MKTAG('s','t','b','l'):
+    case MKTAG('s','t','c','o'):
+    case MKTAG('c','o','6','4'):
+    case MKTAG('s','t','s','z'):
+    case MKTAG('s','t','z','2'):
+    case MKTAG('s','t','s','s'):
+    case MKTAG('s','t','p','s'):
+    case MKTAG('c','t','t','s'):
+    case MKTAG('s','b','g','p'):
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Parse again the sample tables of the last track, skipped because its
+ * index was to be read from a cache that turned out not to match it.
+ */
+static int mov_read_skipped_sample_tables(MOVContext *c, AVIOContext *pb,
+                                          int64_t pos, MOVAtom atom)
+{
+    int64_t end = avio_tell(pb);
+    int ret;
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    c->trak_index = c->fc->nb_streams - 1;
+    c->sample_tables_only = 1;
+    ret = mov_read_default(c, pb, atom);
+    c->sample_tables_only = 0;
+    c->trak_index = -1;
+    if (avio_seek(pb, end, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    return ret;
+}
+
+static int mov_load_index(MOVContext *mov, AVStream *st)
+{
+    if (ff_mov_index_cache_has_track(mov, st->index))
+        return ff_mov_index_cache_read_index(mov, st);
+    mov_build_index(mov, st);
+    return 0;
+}
+
+/**
+ * Build the index of a track left to be built on demand by lazy_index.
+ */
+static int mov_build_pending_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int ret;
+
+    if (!sc->index_pending)
+        return 0;
+
+    ret = mov_load_index(mov, st);
+    sc->index_pending = 0;
+    mov_free_sample_tables(sc);
+    if (ret < 0)
+        return ret;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && st->codecpar->codec_id == AV_CODEC_ID_AAC)
+        st->skip_samples = sc->start_pad;
+    av_log(mov->fc, AV_LOG_DEBUG, "built the index of stream %d on demand\n", st->index);
+    return 0;
+}
+
 static int test_same_origin(const char *src, const char *ref) {
     char src_proto[64];
     char ref_proto[64];
@@ -3708,6 +3812,7 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     AVStream *st;
     MOVStreamContext *sc;
+    int64_t pos = avio_tell(pb);
     int ret;
 
     st = avformat_new_stream(c->fc, NULL);
@@ -3738,7 +3843,14 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     avpriv_set_pts_info(st, 64, 1, sc->time_scale);
 
-    mov_build_index(c, st);
+    if (ff_mov_index_cache_has_track(c, st->index) &&
+        ff_mov_index_cache_read_track_info(c, st) < 0 &&
+        (ret = mov_read_skipped_sample_tables(c, pb, pos, atom)) < 0)
+        return ret;
+    if (c->lazy_index)
+        sc->index_pending = 1;
+    else if ((ret = mov_load_index(c, st)) < 0)
+        return ret;
 
     if (sc->dref_id-1 < sc->drefs_count && sc->drefs[sc->dref_id-1].path) {
         MOVDref *dref = &sc->drefs[sc->dref_id - 1];
@@ -3809,13 +3921,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
     /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
-    av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
+    if (!sc->index_pending)
+        mov_free_sample_tables(sc);
 
     return 0;
 }
@@ -4251,6 +4358,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    /* the fragment samples go after those of the moov */
+    if ((err = mov_build_pending_index(c, st)) < 0)
+        return err;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -5483,6 +5593,9 @@ static int mov_read_default(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             parse = mov_read_keys;
         }
 
+        if (c->sample_tables_only && !mov_is_skipped_sample_table(a.type))
+            parse = NULL;
+
         if (!parse) { /* skip leaf atoms data */
             avio_skip(pb, a.size);
         } else {
@@ -5630,6 +5743,7 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        mov_build_pending_index(mov, st);
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -5728,6 +5842,7 @@ static int mov_read_rtmd_track(AVFormatContext *s, AVStream *st)
     int64_t cur_pos = avio_tell(sc->pb);
     int hh, mm, ss, ff, drop;
 
+    mov_build_pending_index(s->priv_data, st);
     if (!st->nb_index_entries)
         return -1;
 
@@ -5753,6 +5868,7 @@ static int mov_read_timecode_track(AVFormatContext *s, AVStream *st)
     int64_t cur_pos = avio_tell(sc->pb);
     uint32_t value;
 
+    mov_build_pending_index(s->priv_data, st);
     if (!st->nb_index_entries)
         return -1;
 
@@ -5809,6 +5925,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        av_freep(&sc->rfps_dts);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -5848,6 +5965,7 @@ static int mov_read_close(AVFormatContext *s)
 
     av_freep(&mov->aes_decrypt);
     av_freep(&mov->chapter_tracks);
+    ff_mov_index_cache_close(mov);
 
     return 0;
 }
@@ -6008,6 +6126,8 @@ static int mov_read_header(AVFormatContext *s)
 
     mov->fc = s;
     mov->trak_index = -1;
+    if (mov->index_cache_path && (err = ff_mov_index_cache_open(mov)) < 0)
+        return err;
     /* .mov and .mp4 aren't streamable anyway (only progressive download if moov is before mdat) */
     if (pb->seekable & AVIO_SEEKABLE_NORMAL)
         atom.size = avio_size(pb);
@@ -6175,6 +6295,13 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
+
+    if (ff_mov_index_cache_needs_update(mov)) {
+        for (i = 0; i < s->nb_streams; i++)
+            mov_build_pending_index(mov, s->streams[i]);
+        ff_mov_index_cache_write(mov);
+    }
+
     ff_configure_buffers_for_index(s, AV_TIME_BASE);
 
     return 0;
@@ -6188,6 +6315,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
+        if (msc->index_pending && avst->discard != AVDISCARD_ALL)
+            mov_build_pending_index(s->priv_data, avst);
         if (msc->pb && msc->current_sample < avst->nb_index_entries) {
             AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
@@ -6326,7 +6455,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             goto retry;
         }
 
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        /* the packet can reference the file data unless it is rewritten */
+        if ((mov->dv_demux && sc->dv_audio_container) || mov->aax_mode || sc->cenc.aes_ctr)
+            ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -6449,7 +6582,10 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     int sample, time_sample;
     int i;
 
-    int ret = mov_seek_fragment(s, st, timestamp);
+    int ret = mov_build_pending_index(s->priv_data, st);
+    if (ret < 0)
+        return ret;
+    ret = mov_seek_fragment(s, st, timestamp);
     if (ret < 0)
         return ret;
 
@@ -6517,6 +6653,9 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
             if (stream_index == i)
                 continue;
+            /* leave the index of discarded streams unbuilt */
+            if (sc->index_pending && st->discard == AVDISCARD_ALL)
+                continue;
 
             timestamp = av_rescale_q(seek_timestamp, s->streams[stream_index]->time_base, st->time_base);
             mov_seek_stream(s, st, timestamp, flags);
@@ -6585,6 +6724,10 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "index_cache", "File caching the sample index of the tracks between opens", OFFSET(index_cache_path),
+        AV_OPT_TYPE_STRING, { .str = NULL }, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "lazy_index", "Build the index of a track only when it is first needed", OFFSET(lazy_index),
+        AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
 
     { NULL },
 };
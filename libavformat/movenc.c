@@ -58,6 +58,7 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "expected_duration", "expected duration of the output, used by faststart to reserve space for the moov atom (negative for the stream durations)", offsetof(MOVMuxContext, expected_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, INT64_MIN, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -75,6 +76,7 @@ static const AVOption options[] = {
     { "write_gama", "Write deprecated gama atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_WRITE_GAMA}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "use_metadata_tags", "Use mdta atom for metadata.", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_USE_MDTA}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "skip_trailer", "Skip writing the mfra/tfra/mfro trailer for fragmented files", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SKIP_TRAILER}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "skip_sidx", "Skip writing the sidx atoms of the fragments with the dash flag", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SKIP_SIDX}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "iods_audio_profile", "iods audio profile atom.", offsetof(MOVMuxContext, iods_audio_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
@@ -4409,7 +4411,8 @@ static int mov_write_moof_tag(AVIOContext *pb, MOVMuxContext *mov, int tracks,
     mov_write_moof_tag_internal(avio_buf, mov, tracks, 0);
     moof_size = ffio_close_null_buf(avio_buf);
 
-    if (mov->flags & FF_MOV_FLAG_DASH && !(mov->flags & FF_MOV_FLAG_GLOBAL_SIDX))
+    if (mov->flags & FF_MOV_FLAG_DASH &&
+        !(mov->flags & (FF_MOV_FLAG_GLOBAL_SIDX | FF_MOV_FLAG_SKIP_SIDX)))
         mov_write_sidx_tags(pb, mov, tracks, moof_size + 8 + mdat_size);
 
     if (mov->flags & FF_MOV_FLAG_GLOBAL_SIDX ||
@@ -5198,7 +5201,8 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
              * the next fragment. This means the cts of the first sample must
              * be the same in all fragments, unless end_pts was updated by
              * the packet causing the fragment to be written. */
-            if ((mov->flags & FF_MOV_FLAG_DASH && !(mov->flags & FF_MOV_FLAG_GLOBAL_SIDX)) ||
+            if ((mov->flags & FF_MOV_FLAG_DASH &&
+                 !(mov->flags & (FF_MOV_FLAG_GLOBAL_SIDX | FF_MOV_FLAG_SKIP_SIDX))) ||
                 mov->mode == MODE_ISM)
                 pkt->pts = pkt->dts + trk->end_pts - trk->cluster[trk->entry].dts;
         } else {
@@ -5762,6 +5766,94 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+static double estimate_track_samples(AVStream *st, double seconds)
+{
+    AVRational rate = st->avg_frame_rate;
+
+    switch (st->codecpar->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (rate.num <= 0 || rate.den <= 0)
+            rate = st->r_frame_rate;
+        if (rate.num <= 0 || rate.den <= 0)
+            return -1;
+        return ceil(seconds * av_q2d(rate));
+    case AVMEDIA_TYPE_AUDIO:
+        if (st->codecpar->sample_rate <= 0)
+            return -1;
+        return ceil(seconds * st->codecpar->sample_rate /
+                    (st->codecpar->frame_size > 0 ? st->codecpar->frame_size : 1024));
+    default:
+        return ceil(seconds);
+    }
+}
+
+static int64_t estimate_metadata_size(AVDictionary *m)
+{
+    AVDictionaryEntry *t = NULL;
+    int64_t size = 0;
+
+    while ((t = av_dict_get(m, "", t, AV_DICT_IGNORE_SUFFIX)))
+        size += 32 + strlen(t->key) + strlen(t->value);
+    return size;
+}
+
+/*
+ * Estimate the size of the moov atom from the expected duration of the
+ * output and the stream parameters, for faststart to reserve that space
+ * before the mdat atom. The estimate errs on the large side, assuming one
+ * stsz entry per sample, plus a ctts entry for video with delay, and one
+ * co64 and stsc entry per chunk. Chunks end when the interleaving switches
+ * tracks, which happens at most once per sample of the stream with the
+ * lowest sample rate, or every 1 MiB for a single stream.
+ * Returns -1 if the information needed is missing.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t duration = mov->expected_duration;
+    double seconds, samples, min_samples = INT_MAX, size;
+    int i;
+
+    if (!duration)
+        return -1;
+    if (duration < 0) {
+        duration = 0;
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            if (st->duration > 0 && st->time_base.num > 0 && st->time_base.den > 0)
+                duration = FFMAX(duration, av_rescale_q(st->duration, st->time_base,
+                                                        AV_TIME_BASE_Q));
+        }
+    }
+    if (duration <= 0)
+        return -1;
+    seconds = duration / (double)AV_TIME_BASE;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        samples = estimate_track_samples(s->streams[i], seconds);
+        if (samples < 0)
+            return -1;
+        min_samples = FFMIN(min_samples, samples);
+    }
+    if (s->nb_streams == 1 && s->streams[0]->codecpar->bit_rate > 0)
+        min_samples = FFMIN(min_samples, ceil(seconds * s->streams[0]->codecpar->bit_rate /
+                                              (8 << 20)));
+
+    size = 1024 + estimate_metadata_size(s->metadata);
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        samples = estimate_track_samples(st, seconds);
+        size += 1024 + st->codecpar->extradata_size + estimate_metadata_size(st->metadata);
+        size += samples * (st->codecpar->video_delay ? 4 + 8 : 4);
+        size += FFMIN(samples, min_samples) * (8 + 12);
+    }
+    if (s->nb_chapters)
+        size += 1024 + s->nb_chapters * (64 + 4 + 8 + 8 + 12);
+
+    return size > INT_MAX ? -1 : (int)size;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5808,7 +5900,14 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-        mov->reserved_moov_size = -1;
+        if (!mov->reserved_moov_size && !(mov->flags & FF_MOV_FLAG_FRAGMENT))
+            mov->reserved_moov_size = estimate_moov_size(s);
+        if (mov->reserved_moov_size > 0) {
+            mov->reserved_moov_size = FFMAX(mov->reserved_moov_size, 8);
+            av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+                   mov->reserved_moov_size);
+        } else
+            mov->reserved_moov_size = -1;
     }
 
     if (mov->use_editlist < 0) {
@@ -6160,7 +6259,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6254,9 +6353,10 @@ static int get_sidx_size(AVFormatContext *s)
  * This function gets the moov size if moved to the top of the file: the chunk
  * offset table can switch between stco (32-bit entries) to co64 (64-bit
  * entries) when the moov is moved to the beginning, so the size of the moov
- * would change. It also updates the chunk offset tables.
+ * would change. It also updates the chunk offset tables. The data is already
+ * placed after the reserved bytes.
  */
-static int compute_moov_size(AVFormatContext *s)
+static int compute_moov_size(AVFormatContext *s, int reserved)
 {
     int i, moov_size, moov_size2;
     MOVMuxContext *mov = s->priv_data;
@@ -6266,7 +6366,7 @@ static int compute_moov_size(AVFormatContext *s)
         return moov_size;
 
     for (i = 0; i < mov->nb_streams; i++)
-        mov->tracks[i].data_offset += moov_size;
+        mov->tracks[i].data_offset += moov_size - reserved;
 
     moov_size2 = get_moov_size(s);
     if (moov_size2 < 0)
@@ -6296,7 +6396,11 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/*
+ * Shift the data following the reserved bytes at reserved_header_pos so
+ * that the moov (or sidx) atom fits before it.
+ */
+static int shift_data(AVFormatContext *s, int reserved)
 {
     int ret = 0, moov_size;
     MOVMuxContext *mov = s->priv_data;
@@ -6309,7 +6413,7 @@ static int shift_data(AVFormatContext *s)
     if (mov->flags & FF_MOV_FLAG_FRAGMENT)
         moov_size = compute_sidx_size(s);
     else
-        moov_size = compute_moov_size(s);
+        moov_size = compute_moov_size(s, reserved);
     if (moov_size < 0)
         return moov_size;
 
@@ -6335,8 +6439,9 @@ static int shift_data(AVFormatContext *s)
     pos_end = avio_tell(s->pb);
     avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
 
-    /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
+    /* start reading at where the new moov will be placed, the blocks are not
+     * smaller than the shift so they are read before being overwritten */
+    avio_seek(read_pb, mov->reserved_header_pos + reserved, SEEK_SET);
     pos = avio_tell(read_pb);
 
 #define READ_BLOCK do {                                                             \
@@ -6367,7 +6472,7 @@ static int mov_write_trailer(AVFormatContext *s)
     MOVMuxContext *mov = s->priv_data;
     AVIOContext *pb = s->pb;
     int res = 0;
-    int i;
+    int i, reserved = -1;
     int64_t moov_pos;
 
     if (mov->need_rewrite_extradata) {
@@ -6411,6 +6516,23 @@ static int mov_write_trailer(AVFormatContext *s)
     if (!(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
         moov_pos = avio_tell(pb);
 
+        /* Use the space reserved by faststart if the moov atom fits in it
+         * along with a free atom, otherwise shift the data after it. */
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (moov_size + 8 > mov->reserved_moov_size) {
+                av_log(s, AV_LOG_INFO, "The moov atom (%d bytes) does not fit "
+                       "in the %d bytes reserved for it\n",
+                       moov_size, mov->reserved_moov_size);
+                /* keep the last 8 reserved bytes for a free atom, so that
+                 * the data is always shifted forward */
+                reserved = mov->reserved_moov_size - 8;
+                mov->reserved_moov_size = -1;
+            }
+        }
+
         /* Write size of mdat tag */
         if (mov->mdat_size + 8 <= UINT32_MAX) {
             avio_seek(pb, mov->mdat_pos, SEEK_SET);
@@ -6426,14 +6548,18 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size <= 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
+            res = shift_data(s, FFMAX(reserved, 0));
             if (res < 0)
                 return res;
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
+            if (reserved >= 0) {
+                avio_wb32(pb, 8);
+                ffio_wfourcc(pb, "free");
+            }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -6459,7 +6585,7 @@ static int mov_write_trailer(AVFormatContext *s)
         if (mov->flags & FF_MOV_FLAG_GLOBAL_SIDX) {
             int64_t end;
             av_log(s, AV_LOG_INFO, "Starting second pass: inserting sidx atoms\n");
-            res = shift_data(s);
+            res = shift_data(s, 0);
             if (res < 0)
                 return res;
             end = avio_tell(pb);
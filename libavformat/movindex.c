@@ -0,0 +1,517 @@
+/*
+ * Sample index cache of the mov demuxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The sidecar file is made of little-endian fields, except for the index
+ * entries, ctts entries and index ranges which are stored in the layout of
+ * the structures of the build that wrote them, so that they are read with
+ * a single copy. The cache is local to a machine, a build with another
+ * layout just rebuilds it.
+ *
+ * header:
+ *   u32 tag 'FFMI', u32 version, u32 native layout, u32 flags (demuxer
+ *   options changing the index), u32 number of tracks, i64 input size,
+ *   i64 input modification time, i64 moov payload position,
+ *   i64 moov payload size, i64 position of each track record
+ * track record:
+ *   u32 track id, u32 sample count, u32 chunk count, i32 dts shift,
+ *   i64 data size (the track info, set from the skipped sample tables)
+ *   i64 time offset, i32 start pad, i32 skip samples, i64 duration,
+ *   i64 bit rate,
+ *   u32 count + i64 timestamps of the first frames for the frame rate guess,
+ *   u32 count + AVIndexEntry array,
+ *   u32 count + MOVStts array,
+ *   u32 count + MOVIndexRange array, including the terminator
+ */
+
+#include <sys/stat.h>
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+#include "avformat.h"
+#include "internal.h"
+#include "isom.h"
+#include "movindex.h"
+#include "os_support.h"
+
+#define INDEX_CACHE_TAG         MKTAG('F','F','M','I')
+#define INDEX_CACHE_VERSION     1
+#define INDEX_CACHE_HEADER_SIZE 52
+#define TRACK_INFO_SIZE         24
+
+#define INDEX_CACHE_LAYOUT (sizeof(AVIndexEntry) | sizeof(MOVStts) << 8 | \
+                            sizeof(MOVIndexRange) << 16 | HAVE_BIGENDIAN << 24)
+
+typedef struct MOVIndexCache {
+    AVIOContext *pb;        ///< valid cache being read, NULL if there is none
+    int disabled;           ///< the input cannot be identified, do not write
+    int64_t file_size;
+    int64_t mtime;
+    int64_t moov_pos;
+    int64_t moov_size;
+    unsigned nb_tracks;
+    int64_t *track_pos;
+} MOVIndexCache;
+
+static unsigned index_cache_flags(MOVContext *mov)
+{
+    return !!mov->advanced_editlist | !!mov->ignore_editlist << 1;
+}
+
+static int get_file_key(AVFormatContext *s, int64_t *size, int64_t *mtime)
+{
+    const char *filename = s->filename;
+    const char *proto = avio_find_protocol_name(filename);
+    struct stat st;
+
+    if (!proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    av_strstart(filename, "file:", &filename);
+    if (stat(filename, &st) < 0)
+        return AVERROR(errno);
+    *size  = st.st_size;
+    *mtime = st.st_mtime;
+    return 0;
+}
+
+static void drop_cache(MOVContext *mov, const char *reason)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    av_log(mov->fc, AV_LOG_VERBOSE, "Index cache %s %s, rebuilding it\n",
+           mov->index_cache_path, reason);
+    ff_format_io_close(mov->fc, &cache->pb);
+    av_freep(&cache->track_pos);
+    cache->nb_tracks = 0;
+}
+
+/**
+ * Stop reading the cache from the track index on. The previous tracks
+ * matched it and may still read their index from it.
+ */
+static void drop_tracks(MOVContext *mov, int index, const char *reason)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    av_log(mov->fc, AV_LOG_WARNING, "Index cache %s %s track %d, rebuilding it\n",
+           mov->index_cache_path, reason, index);
+    cache->nb_tracks = FFMIN(cache->nb_tracks, index);
+}
+
+static int check_index_range(const MOVIndexRange *range, unsigned nb_entries)
+{
+    return range->start >= 0 && range->start < range->end &&
+           range->end <= nb_entries;
+}
+
+/**
+ * Check that the record of a track, after its track info, fits in the
+ * cache and that its index ranges are within its index.
+ */
+static int check_track(AVIOContext *pb)
+{
+    int64_t size = avio_size(pb);
+    unsigned i, count, nb_entries;
+
+    if (avio_skip(pb, 32) < 0)
+        return AVERROR_INVALIDDATA;
+    count = avio_rl32(pb);
+    if (count > 100 || avio_skip(pb, 8 * count) < 0)
+        return AVERROR_INVALIDDATA;
+    nb_entries = avio_rl32(pb);
+    if (avio_skip(pb, sizeof(AVIndexEntry) * (int64_t)nb_entries) < 0)
+        return AVERROR_INVALIDDATA;
+    count = avio_rl32(pb);
+    if (avio_skip(pb, sizeof(MOVStts) * (int64_t)count) < 0)
+        return AVERROR_INVALIDDATA;
+    count = avio_rl32(pb);
+    for (i = 0; i + 1 < count; i++) {
+        MOVIndexRange range;
+        if (avio_read(pb, (uint8_t *)&range, sizeof(range)) != sizeof(range) ||
+            !check_index_range(&range, nb_entries))
+            return AVERROR_INVALIDDATA;
+    }
+    if (count && avio_skip(pb, sizeof(MOVIndexRange)) < 0)
+        return AVERROR_INVALIDDATA;
+    if (pb->eof_reached || pb->error || size < 0 || avio_tell(pb) > size)
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+int ff_mov_index_cache_open(MOVContext *mov)
+{
+    AVFormatContext *s = mov->fc;
+    MOVIndexCache *cache;
+    AVDictionary *opts = NULL;
+    AVIOContext *pb;
+    unsigned i;
+    int ret;
+
+    cache = av_mallocz(sizeof(*cache));
+    if (!cache)
+        return AVERROR(ENOMEM);
+    mov->index_cache = cache;
+
+    ret = get_file_key(s, &cache->file_size, &cache->mtime);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot cache the index of %s: %s\n",
+               s->filename, av_err2str(ret));
+        cache->disabled = 1;
+        return 0;
+    }
+
+    /* read the cache through a mapping if the protocol can */
+    av_dict_set(&opts, "mmap", "1", 0);
+    ret = s->io_open(s, &cache->pb, mov->index_cache_path, AVIO_FLAG_READ, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(s, AV_LOG_VERBOSE, "No index cache in %s\n", mov->index_cache_path);
+        return 0;
+    }
+    pb = cache->pb;
+
+    if (avio_rl32(pb) != INDEX_CACHE_TAG ||
+        avio_rl32(pb) != INDEX_CACHE_VERSION ||
+        avio_rl32(pb) != INDEX_CACHE_LAYOUT) {
+        drop_cache(mov, "has an unsupported format");
+        return 0;
+    }
+    if (avio_rl32(pb) != index_cache_flags(mov)) {
+        drop_cache(mov, "was built with other options");
+        return 0;
+    }
+    cache->nb_tracks = avio_rl32(pb);
+    if (avio_rl64(pb) != cache->file_size ||
+        avio_rl64(pb) != cache->mtime) {
+        drop_cache(mov, "is stale");
+        return 0;
+    }
+    cache->moov_pos  = avio_rl64(pb);
+    cache->moov_size = avio_rl64(pb);
+
+    if (cache->nb_tracks > INT_MAX / sizeof(*cache->track_pos)) {
+        drop_cache(mov, "is invalid");
+        return 0;
+    }
+    cache->track_pos = av_malloc_array(cache->nb_tracks, sizeof(*cache->track_pos));
+    if (!cache->track_pos && cache->nb_tracks) {
+        drop_cache(mov, "cannot be read");
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < cache->nb_tracks; i++)
+        cache->track_pos[i] = avio_rl64(pb);
+    if (pb->eof_reached || pb->error)
+        drop_cache(mov, "is truncated");
+    else
+        av_log(s, AV_LOG_VERBOSE, "Reading the index from %s\n", mov->index_cache_path);
+    return 0;
+}
+
+void ff_mov_index_cache_check_moov(MOVContext *mov, int64_t pos, int64_t size)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    if (!cache)
+        return;
+    if (cache->pb && (cache->moov_pos != pos || cache->moov_size != size))
+        drop_cache(mov, "is for another moov atom");
+    cache->moov_pos  = pos;
+    cache->moov_size = size;
+}
+
+int ff_mov_index_cache_has_track(MOVContext *mov, int index)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    return cache && cache->pb && index < cache->nb_tracks;
+}
+
+int ff_mov_index_cache_read_track_info(MOVContext *mov, AVStream *st)
+{
+    MOVIndexCache *cache = mov->index_cache;
+    MOVStreamContext *sc = st->priv_data;
+    AVIOContext *pb = cache->pb;
+    int dts_shift;
+    int64_t data_size;
+
+    if (avio_seek(pb, cache->track_pos[st->index], SEEK_SET) < 0 ||
+        avio_rl32(pb) != st->id ||
+        avio_rl32(pb) != sc->sample_count ||
+        avio_rl32(pb) != sc->chunk_count || pb->eof_reached) {
+        drop_tracks(mov, st->index, "does not match");
+        return AVERROR_INVALIDDATA;
+    }
+    dts_shift = (int32_t)avio_rl32(pb);
+    data_size = avio_rl64(pb);
+    if (check_track(pb) < 0) {
+        drop_tracks(mov, st->index, "is invalid for");
+        return AVERROR_INVALIDDATA;
+    }
+    sc->dts_shift = dts_shift;
+    sc->data_size = data_size;
+    return 0;
+}
+
+static int read_array(AVIOContext *pb, void *array, unsigned count, size_t size)
+{
+    int64_t len = (int64_t)count * size;
+
+    while (len > 0) {
+        int ret = avio_read(pb, array, FFMIN(len, INT_MAX));
+        if (ret <= 0)
+            return AVERROR_INVALIDDATA;
+        array = (uint8_t *)array + ret;
+        len  -= ret;
+    }
+    return 0;
+}
+
+int ff_mov_index_cache_read_index(MOVContext *mov, AVStream *st)
+{
+    MOVIndexCache *cache = mov->index_cache;
+    MOVStreamContext *sc = st->priv_data;
+    AVIOContext *pb = cache->pb;
+    unsigned i, count;
+
+    /* the record was checked by ff_mov_index_cache_read_track_info() */
+    if (avio_seek(pb, cache->track_pos[st->index] + TRACK_INFO_SIZE, SEEK_SET) < 0)
+        return AVERROR(EIO);
+
+    sc->time_offset  = avio_rl64(pb);
+    sc->start_pad    = (int32_t)avio_rl32(pb);
+    st->skip_samples = (int32_t)avio_rl32(pb);
+    st->duration     = avio_rl64(pb);
+    st->codecpar->bit_rate = avio_rl64(pb);
+
+    count = avio_rl32(pb);
+    if (count > 100)
+        goto fail;
+    /* kept in case the cache is rewritten for the next tracks */
+    av_freep(&sc->rfps_dts);
+    sc->rfps_count = 0;
+    if (count && !(sc->rfps_dts = av_malloc_array(count, sizeof(*sc->rfps_dts))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < count && !pb->eof_reached; i++) {
+        int64_t dts = avio_rl64(pb);
+        /* like mov_build_index(), which does not do it for lazy indexes */
+        if (!sc->index_pending)
+            ff_rfps_add_frame(mov->fc, st, dts);
+        sc->rfps_dts[sc->rfps_count++] = dts;
+    }
+
+    count = avio_rl32(pb);
+    if (count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
+        goto fail;
+    if (av_reallocp_array(&st->index_entries, count, sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        return AVERROR(ENOMEM);
+    }
+    st->index_entries_allocated_size = count * sizeof(*st->index_entries);
+    st->nb_index_entries = count;
+    if (read_array(pb, st->index_entries, count, sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        goto fail;
+    }
+
+    count = avio_rl32(pb);
+    if (count >= UINT_MAX / sizeof(*sc->ctts_data))
+        goto fail;
+    av_freep(&sc->ctts_data);
+    sc->ctts_count = 0;
+    if (count) {
+        sc->ctts_data = av_malloc_array(count, sizeof(*sc->ctts_data));
+        if (!sc->ctts_data)
+            return AVERROR(ENOMEM);
+        if (read_array(pb, sc->ctts_data, count, sizeof(*sc->ctts_data)) < 0)
+            goto fail;
+        sc->ctts_count = count;
+    }
+
+    count = avio_rl32(pb);
+    if (count >= UINT_MAX / sizeof(*sc->index_ranges))
+        goto fail;
+    if (count) {
+        av_freep(&sc->index_ranges);
+        sc->index_ranges = av_malloc_array(count, sizeof(*sc->index_ranges));
+        if (!sc->index_ranges)
+            return AVERROR(ENOMEM);
+        if (read_array(pb, sc->index_ranges, count, sizeof(*sc->index_ranges)) < 0)
+            goto fail;
+        for (i = 0; i + 1 < count; i++)
+            if (!check_index_range(&sc->index_ranges[i], st->nb_index_entries))
+                goto fail;
+        sc->index_ranges[count - 1].start = 0;
+        sc->index_ranges[count - 1].end   = 0;
+        sc->current_index_range = sc->index_ranges;
+        sc->current_index       = sc->index_ranges[0].start;
+    }
+
+    if (!pb->eof_reached && !pb->error)
+        return 0;
+fail:
+    av_log(mov->fc, AV_LOG_ERROR, "Index cache %s is invalid for track %d, "
+           "remove it\n", mov->index_cache_path, st->index);
+    return AVERROR_INVALIDDATA;
+}
+
+int ff_mov_index_cache_needs_update(MOVContext *mov)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    /* fragments add to the index while the file is read */
+    return cache && !cache->disabled && cache->moov_size > 0 && !mov->trex_data &&
+           (!cache->pb || cache->nb_tracks != mov->fc->nb_streams);
+}
+
+static unsigned count_index_ranges(MOVStreamContext *sc)
+{
+    unsigned count = 0;
+
+    if (!sc->index_ranges)
+        return 0;
+    while (sc->index_ranges[count].end)
+        count++;
+    return count + 1;
+}
+
+static int64_t track_record_size(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    return TRACK_INFO_SIZE + 32 +
+           4 + 8 * sc->rfps_count +
+           4 + sizeof(*st->index_entries) * (int64_t)st->nb_index_entries +
+           4 + sizeof(*sc->ctts_data) * (int64_t)sc->ctts_count +
+           4 + sizeof(*sc->index_ranges) * count_index_ranges(sc);
+}
+
+static void write_array(AVIOContext *pb, const void *array, unsigned count,
+                        size_t size)
+{
+    int64_t len = (int64_t)count * size;
+
+    while (len > 0) {
+        int chunk = FFMIN(len, INT_MAX);
+        avio_write(pb, array, chunk);
+        array = (const uint8_t *)array + chunk;
+        len  -= chunk;
+    }
+}
+
+static void write_track(AVIOContext *pb, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned i, count;
+
+    avio_wl32(pb, st->id);
+    avio_wl32(pb, sc->sample_count);
+    avio_wl32(pb, sc->chunk_count);
+    avio_wl32(pb, sc->dts_shift);
+    avio_wl64(pb, sc->data_size);
+
+    avio_wl64(pb, sc->time_offset);
+    avio_wl32(pb, sc->start_pad);
+    avio_wl32(pb, st->skip_samples);
+    avio_wl64(pb, st->duration);
+    avio_wl64(pb, st->codecpar->bit_rate);
+
+    avio_wl32(pb, sc->rfps_count);
+    for (i = 0; i < sc->rfps_count; i++)
+        avio_wl64(pb, sc->rfps_dts[i]);
+
+    avio_wl32(pb, st->nb_index_entries);
+    write_array(pb, st->index_entries, st->nb_index_entries,
+                sizeof(*st->index_entries));
+
+    avio_wl32(pb, sc->ctts_count);
+    write_array(pb, sc->ctts_data, sc->ctts_count, sizeof(*sc->ctts_data));
+
+    count = count_index_ranges(sc);
+    avio_wl32(pb, count);
+    write_array(pb, sc->index_ranges, count, sizeof(*sc->index_ranges));
+}
+
+int ff_mov_index_cache_write(MOVContext *mov)
+{
+    AVFormatContext *s = mov->fc;
+    MOVIndexCache *cache = mov->index_cache;
+    AVIOContext *pb;
+    char *tmp;
+    int64_t pos;
+    int i, ret;
+
+    /* write to a temporary file first, so that readers never see a
+     * partial cache */
+    tmp = av_asprintf("%s.%08"PRIx32".tmp", mov->index_cache_path,
+                      av_get_random_seed());
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL);
+    if (ret < 0)
+        goto end;
+
+    avio_wl32(pb, INDEX_CACHE_TAG);
+    avio_wl32(pb, INDEX_CACHE_VERSION);
+    avio_wl32(pb, INDEX_CACHE_LAYOUT);
+    avio_wl32(pb, index_cache_flags(mov));
+    avio_wl32(pb, s->nb_streams);
+    avio_wl64(pb, cache->file_size);
+    avio_wl64(pb, cache->mtime);
+    avio_wl64(pb, cache->moov_pos);
+    avio_wl64(pb, cache->moov_size);
+    pos = INDEX_CACHE_HEADER_SIZE + 8 * s->nb_streams;
+    for (i = 0; i < s->nb_streams; i++) {
+        avio_wl64(pb, pos);
+        pos += track_record_size(s->streams[i]);
+    }
+    for (i = 0; i < s->nb_streams; i++)
+        write_track(pb, s->streams[i]);
+
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+    if (ret >= 0)
+        ret = avpriv_io_move(tmp, mov->index_cache_path);
+    if (ret < 0)
+        avpriv_io_delete(tmp);
+    else
+        av_log(s, AV_LOG_VERBOSE, "Wrote index cache %s\n", mov->index_cache_path);
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Cannot write index cache %s: %s\n",
+               mov->index_cache_path, av_err2str(ret));
+    av_free(tmp);
+    return ret;
+}
+
+void ff_mov_index_cache_close(MOVContext *mov)
+{
+    MOVIndexCache *cache = mov->index_cache;
+
+    if (!cache)
+        return;
+    ff_format_io_close(mov->fc, &cache->pb);
+    av_freep(&cache->track_pos);
+    av_freep(&mov->index_cache);
+}
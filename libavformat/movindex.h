@@ -0,0 +1,86 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sample index cache of the mov demuxer.
+ *
+ * The index built from the sample tables of each track is stored in a
+ * sidecar file, valid as long as the size and modification time of the
+ * input and the position of its moov atom do not change. When it is valid,
+ * the sample tables which are only needed to build the index are skipped
+ * and the index is read from the sidecar instead.
+ */
+
+#ifndef AVFORMAT_MOVINDEX_H
+#define AVFORMAT_MOVINDEX_H
+
+#include "avformat.h"
+#include "isom.h"
+
+/**
+ * Set up the index cache of MOVContext.index_cache_path, reading its
+ * header if it is valid for the input.
+ *
+ * @return 0 if the cache is valid, stale or missing, < 0 on allocation
+ *         failure
+ */
+int ff_mov_index_cache_open(MOVContext *mov);
+
+/**
+ * Check the position and size of the moov atom payload against the cache
+ * before the atom is parsed, dropping the cache if they differ.
+ */
+void ff_mov_index_cache_check_moov(MOVContext *mov, int64_t pos, int64_t size);
+
+/**
+ * @return 1 if the index of the stream is read from the cache, so that its
+ *         sample tables can be skipped, 0 otherwise
+ */
+int ff_mov_index_cache_has_track(MOVContext *mov, int index);
+
+/**
+ * Check the counts read from the headers of the skipped sample tables of
+ * the track and its record in the cache, and set the fields computed from
+ * their data.
+ *
+ * @return 0 on success, < 0 if the cache does not match the track, which
+ *         then is no longer read from the cache, nor are the next ones
+ */
+int ff_mov_index_cache_read_track_info(MOVContext *mov, AVStream *st);
+
+/**
+ * Read the index of the track, replacing mov_build_index().
+ */
+int ff_mov_index_cache_read_index(MOVContext *mov, AVStream *st);
+
+/**
+ * @return 1 if the cache is missing, stale or does not match all the tracks
+ *         and can be written, which needs the index of all the tracks to be
+ *         built
+ */
+int ff_mov_index_cache_needs_update(MOVContext *mov);
+
+/**
+ * Write the cache, replacing the previous one atomically.
+ */
+int ff_mov_index_cache_write(MOVContext *mov);
+
+void ff_mov_index_cache_close(MOVContext *mov);
+
+#endif /* AVFORMAT_MOVINDEX_H */
@@ -415,8 +415,7 @@ static int mp3_read_header(AVFormatContext *s)
     }
 
     // the seek index is relative to the end of the xing vbr headers
-    for (i = 0; i < st->nb_index_entries; i++)
-        st->index_entries[i].pos += avio_tell(s->pb);
+    ff_index_shift_pos(st, avio_tell(s->pb));
 
     /* the parameters will be extracted from the compressed bitstream */
     return 0;
@@ -529,7 +528,8 @@ static int mp3_seek(AVFormatContext *s, int stream_index, int64_t timestamp,
                     int flags)
 {
     MP3DecContext *mp3 = s->priv_data;
-    AVIndexEntry *ie, ie1;
+    const AVIndexEntry *ie;
+    AVIndexEntry ie1;
     AVStream *st = s->streams[0];
     int64_t best_pos;
     int fast_seek = s->flags & AVFMT_FLAG_FAST_SEEK;
@@ -551,15 +551,15 @@ static int mp3_seek(AVFormatContext *s, int stream_index, int64_t timestamp,
         if (ret < 0)
             return ret;
 
-        ie = &st->index_entries[ret];
+        ie = avformat_index_get_entry(st, ret);
     } else if (fast_seek && st->duration > 0 && filesize > 0) {
         if (!mp3->is_cbr)
             av_log(s, AV_LOG_WARNING, "Using scaling to seek VBR MP3; may be imprecise.\n");
 
         ie = &ie1;
         timestamp = av_clip64(timestamp, 0, st->duration);
-        ie->timestamp = timestamp;
-        ie->pos       = av_rescale(timestamp, filesize, st->duration) + s->internal->data_offset;
+        ie1.timestamp = timestamp;
+        ie1.pos       = av_rescale(timestamp, filesize, st->duration) + s->internal->data_offset;
     } else {
         return -1; // generic index code
     }
@@ -159,6 +159,14 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** pids to discard, built by update_discarded_pids() */
+    uint8_t discarded_pids[NB_PID_MAX / 8];
+    int discarded_pids_valid;
+    /** AVDISCARD_ALL state of the programs when discarded_pids was built */
+    uint8_t *prg_discarded;
+    unsigned int prg_discarded_size;
+    int nb_prg_discarded;
 };
 
 #define MPEGTS_OPTIONS \
@@ -281,12 +289,14 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
             ts->prg[i].nb_pids = 0;
             ts->prg[i].pmt_found = 0;
         }
+    ts->discarded_pids_valid = 0;
 }
 
 static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->discarded_pids_valid = 0;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -301,6 +311,7 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->nb_pids = 0;
     p->pmt_found = 0;
     ts->nb_prg++;
+    ts->discarded_pids_valid = 0;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
@@ -319,6 +330,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->discarded_pids_valid = 0;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -342,45 +354,71 @@ static void set_pcr_pid(AVFormatContext *s, unsigned int programid, unsigned int
 }
 
 /**
- * @brief discard_pid() decides if the pid is to be discarded according
- *                      to caller's programs selection
- * @param ts    : - TS context
- * @param pid   : - pid
- * @return 1 if the pid is only comprised in programs that have .discard=AVDISCARD_ALL
- *         0 otherwise
+ * @brief update_discarded_pids() decides which pids are to be discarded
+ *        according to caller's programs selection, when the programs or
+ *        their selection changed
+ *
+ * A pid is discarded if it is only comprised in programs that have
+ * .discard=AVDISCARD_ALL.
  */
-static int discard_pid(MpegTSContext *ts, unsigned int pid)
+static void update_discarded_pids(MpegTSContext *ts)
 {
+    AVFormatContext *s = ts->stream;
+    uint8_t used[NB_PID_MAX / 8] = { 0 };
     int i, j, k;
-    int used = 0, discarded = 0;
-    struct Program *p;
 
-    /* If none of the programs have .discard=AVDISCARD_ALL then there's
-     * no way we have to discard this packet */
-    for (k = 0; k < ts->stream->nb_programs; k++)
-        if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-            break;
-    if (k == ts->stream->nb_programs)
-        return 0;
+    if (ts->discarded_pids_valid && ts->nb_prg_discarded == s->nb_programs) {
+        for (k = 0; k < s->nb_programs; k++)
+            if (ts->prg_discarded[k] != (s->programs[k]->discard == AVDISCARD_ALL))
+                break;
+        if (k == s->nb_programs)
+            return;
+    }
+
+    memset(ts->discarded_pids, 0, sizeof(ts->discarded_pids));
+    ts->discarded_pids_valid = 0;
+    if (s->nb_programs) {
+        av_fast_malloc(&ts->prg_discarded, &ts->prg_discarded_size, s->nb_programs);
+        if (!ts->prg_discarded) {
+            ts->nb_prg_discarded = 0;
+            return;
+        }
+    }
+    for (k = 0; k < s->nb_programs; k++)
+        ts->prg_discarded[k] = s->programs[k]->discard == AVDISCARD_ALL;
+    ts->nb_prg_discarded = s->nb_programs;
 
     for (i = 0; i < ts->nb_prg; i++) {
-        p = &ts->prg[i];
-        for (j = 0; j < p->nb_pids; j++) {
-            if (p->pids[j] != pid)
-                continue;
-            // is program with id p->id set to be discarded?
-            for (k = 0; k < ts->stream->nb_programs; k++) {
-                if (ts->stream->programs[k]->id == p->id) {
-                    if (ts->stream->programs[k]->discard == AVDISCARD_ALL)
-                        discarded++;
-                    else
-                        used++;
-                }
+        struct Program *p = &ts->prg[i];
+        int used_prg = 0, discarded_prg = 0;
+
+        // is program with id p->id set to be discarded?
+        for (k = 0; k < s->nb_programs; k++) {
+            if (s->programs[k]->id == p->id) {
+                if (ts->prg_discarded[k])
+                    discarded_prg = 1;
+                else
+                    used_prg = 1;
             }
         }
+        for (j = 0; j < p->nb_pids; j++) {
+            unsigned int pid = p->pids[j];
+            if (used_prg)
+                used[pid >> 3] |= 1 << (pid & 7);
+            if (discarded_prg)
+                ts->discarded_pids[pid >> 3] |= 1 << (pid & 7);
+        }
     }
+    for (i = 0; i < NB_PID_MAX / 8; i++)
+        ts->discarded_pids[i] &= ~used[i];
+    ts->discarded_pids_valid = 1;
+}
 
-    return !used && discarded;
+static av_always_inline int discard_pid(MpegTSContext *ts, unsigned int pid)
+{
+    if (!ts->discarded_pids_valid)
+        update_discarded_pids(ts);
+    return ts->discarded_pids[pid >> 3] >> (pid & 7) & 1;
 }
 
 /**
@@ -2477,6 +2515,36 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Skip the packets available in the I/O buffer that handle_packet() would
+ * ignore, i.e. those of discarded pids and of pids without a filter, so
+ * that they are dropped without being read one by one.
+ *
+ * @return the number of skipped packets
+ */
+static int64_t skip_ignored_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const int raw_packet_size = ts->raw_packet_size;
+    const uint8_t *p = pb->buf_ptr;
+    int64_t n = 0;
+
+    if (pb->write_flag)
+        return 0;
+    while (n < max_packets && pb->buf_end - p >= raw_packet_size && p[0] == 0x47) {
+        unsigned int pid = AV_RB16(p + 1) & 0x1fff;
+
+        if (!(pid && discard_pid(ts, pid)) &&
+            (ts->pids[pid] || (ts->auto_guess && p[1] & 0x40)))
+            break;
+        p += raw_packet_size;
+        n++;
+    }
+    if (n)
+        avio_skip(pb, p - pb->buf_ptr);
+    return n;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -2505,6 +2573,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    update_discarded_pids(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -2518,6 +2588,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        packet_num += skip_ignored_packets(ts, nb_packets ? nb_packets - 1 - packet_num
+                                                          : INT64_MAX);
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -2798,6 +2870,7 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->prg_discarded);
 
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
@@ -2908,6 +2981,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    update_discarded_pids(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
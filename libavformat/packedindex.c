@@ -0,0 +1,450 @@
+/*
+ * Compact storage of a stream index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each entry is packed as 4 LEB128 numbers, relative to the previous entry
+ * of the block, or to the first timestamp and position of the block with a
+ * size of 0 for the first entry:
+ *   timestamp - previous timestamp (entries are sorted),
+ *   zigzag(pos - (previous pos + previous size)), 0 for contiguous samples,
+ *   size << 2 | flags,
+ *   zigzag(min_distance)
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+#include "packedindex.h"
+
+#define MAX_PACKED_ENTRY_SIZE (10 + 10 + 5 + 5)
+
+static uint8_t *put_leb(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static const uint8_t *get_leb(const uint8_t *p, uint64_t *v)
+{
+    uint64_t val = 0;
+    int shift = 0;
+
+    while (*p & 0x80) {
+        val   |= (uint64_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *v = val | (uint64_t)*p++ << shift;
+    return p;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return (uint64_t)v << 1 ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint8_t *pack_entry(uint8_t *p, const AVIndexEntry *prev,
+                           const AVIndexEntry *e)
+{
+    uint64_t prev_end = (uint64_t)prev->pos + prev->size;
+
+    p = put_leb(p, (uint64_t)e->timestamp - prev->timestamp);
+    p = put_leb(p, zigzag((int64_t)((uint64_t)e->pos - prev_end)));
+    p = put_leb(p, (unsigned)e->size << 2 | (e->flags & 3));
+    p = put_leb(p, zigzag(e->min_distance));
+    return p;
+}
+
+static const uint8_t *unpack_entry(const uint8_t *p, const AVIndexEntry *prev,
+                                   AVIndexEntry *e)
+{
+    uint64_t prev_end = (uint64_t)prev->pos + prev->size;
+    uint64_t v;
+
+    p = get_leb(p, &v);
+    e->timestamp    = (uint64_t)prev->timestamp + v;
+    p = get_leb(p, &v);
+    e->pos          = prev_end + unzigzag(v);
+    p = get_leb(p, &v);
+    e->size         = v >> 2;
+    e->flags        = v & 3;
+    p = get_leb(p, &v);
+    e->min_distance = unzigzag(v);
+    return p;
+}
+
+static void block_start(const PackedIndexBlock *b, AVIndexEntry *prev)
+{
+    memset(prev, 0, sizeof(*prev));
+    prev->pos       = b->first_pos;
+    prev->timestamp = b->first_timestamp;
+}
+
+static void unpack_block(FFPackedIndex *pi, int k)
+{
+    const PackedIndexBlock *b = &pi->blocks[k];
+    const uint8_t *p = b->data;
+    AVIndexEntry prev;
+    int i;
+
+    block_start(b, &prev);
+    for (i = 0; i < b->nb_entries; i++) {
+        p    = unpack_entry(p, &prev, &pi->cache[i]);
+        prev = pi->cache[i];
+    }
+    pi->cached_block = k;
+}
+
+static int realloc_block_data(FFPackedIndex *pi, PackedIndexBlock *b, unsigned size)
+{
+    uint8_t *data = av_realloc(b->data, size);
+
+    if (!data)
+        return AVERROR(ENOMEM);
+    pi->data_size = pi->data_size - b->data_allocated_size + size;
+    b->data                = data;
+    b->data_allocated_size = size;
+    return 0;
+}
+
+/* replace the entries of block k */
+static int pack_block(FFPackedIndex *pi, int k, const AVIndexEntry *entries, int nb)
+{
+    PackedIndexBlock *b = &pi->blocks[k];
+    uint8_t buf[(PACKED_INDEX_BLOCK_SIZE + 1) * MAX_PACKED_ENTRY_SIZE];
+    uint8_t *p = buf;
+    AVIndexEntry prev;
+    int i, ret;
+
+    av_assert0(nb > 0 && nb <= PACKED_INDEX_BLOCK_SIZE + 1);
+    b->first_timestamp = entries[0].timestamp;
+    b->first_pos       = entries[0].pos;
+    block_start(b, &prev);
+    for (i = 0; i < nb; i++) {
+        p    = pack_entry(p, &prev, &entries[i]);
+        prev = entries[i];
+    }
+    if (b->data_allocated_size != p - buf &&
+        (ret = realloc_block_data(pi, b, p - buf)) < 0)
+        return ret;
+    memcpy(b->data, buf, p - buf);
+    b->data_size  = p - buf;
+    b->nb_entries = nb;
+    return 0;
+}
+
+/* insert an empty block at k */
+static int insert_block(FFPackedIndex *pi, int k)
+{
+    PackedIndexBlock *blocks;
+
+    if (pi->nb_blocks >= INT_MAX / sizeof(*blocks) - 1)
+        return AVERROR(ENOMEM);
+    blocks = av_fast_realloc(pi->blocks, &pi->blocks_allocated_size,
+                             (pi->nb_blocks + 1) * sizeof(*blocks));
+    if (!blocks)
+        return AVERROR(ENOMEM);
+    pi->blocks = blocks;
+    memmove(blocks + k + 1, blocks + k, (pi->nb_blocks - k) * sizeof(*blocks));
+    memset(&blocks[k], 0, sizeof(*blocks));
+    pi->nb_blocks++;
+    if (pi->cached_block >= k)
+        pi->cached_block++;
+    return 0;
+}
+
+static int append_entry(FFPackedIndex *pi, const AVIndexEntry *e)
+{
+    PackedIndexBlock *b;
+    AVIndexEntry prev;
+    int k = pi->nb_blocks - 1, ret;
+
+    if (k < 0 || pi->blocks[k].nb_entries >= PACKED_INDEX_BLOCK_SIZE) {
+        if ((ret = insert_block(pi, ++k)) < 0)
+            return ret;
+        b = &pi->blocks[k];
+        b->first_timestamp = e->timestamp;
+        b->first_pos       = e->pos;
+        b->first_index     = pi->nb_entries;
+        block_start(b, &prev);
+    } else {
+        b    = &pi->blocks[k];
+        prev = pi->last;
+    }
+
+    if (b->data_allocated_size < b->data_size + MAX_PACKED_ENTRY_SIZE) {
+        unsigned size = FFMAX(b->data_allocated_size * 2, 8 * MAX_PACKED_ENTRY_SIZE);
+        if ((ret = realloc_block_data(pi, b, size)) < 0) {
+            /* drop the block created above */
+            if (!b->nb_entries)
+                pi->nb_blocks--;
+            return ret;
+        }
+    }
+    b->data_size = pack_entry(b->data + b->data_size, &prev, e) - b->data;
+    if (pi->cached_block == k)
+        pi->cache[b->nb_entries] = *e;
+    b->nb_entries++;
+    pi->last = *e;
+
+    /* a full block does not grow anymore, failing to shrink it is harmless */
+    if (b->nb_entries == PACKED_INDEX_BLOCK_SIZE)
+        realloc_block_data(pi, b, b->data_size);
+
+    return pi->nb_entries++;
+}
+
+/* last block starting at or before timestamp, -1 if there is none */
+static int find_block_by_timestamp(const FFPackedIndex *pi, int64_t timestamp)
+{
+    int a = -1, b = pi->nb_blocks;
+
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (pi->blocks[m].first_timestamp <= timestamp)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int find_block_by_index(const FFPackedIndex *pi, int idx)
+{
+    int k = pi->cached_block, a = -1, b = pi->nb_blocks;
+
+    /* entries are mostly accessed in order */
+    for (; k >= 0 && k < pi->nb_blocks && k <= pi->cached_block + 1; k++)
+        if (idx >= pi->blocks[k].first_index &&
+            idx <  pi->blocks[k].first_index + pi->blocks[k].nb_entries)
+            return k;
+
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (pi->blocks[m].first_index <= idx)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+FFPackedIndex *ff_packed_index_alloc(void)
+{
+    FFPackedIndex *pi = av_mallocz(sizeof(*pi));
+
+    if (pi)
+        pi->cached_block = -1;
+    return pi;
+}
+
+void ff_packed_index_free(FFPackedIndex **ppi)
+{
+    FFPackedIndex *pi = *ppi;
+    int i;
+
+    if (!pi)
+        return;
+    for (i = 0; i < pi->nb_blocks; i++)
+        av_free(pi->blocks[i].data);
+    av_free(pi->blocks);
+    av_freep(ppi);
+}
+
+int ff_packed_index_add(FFPackedIndex *pi, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags)
+{
+    AVIndexEntry e = { 0 };
+    int k, i, nb, old_nb, split, ret;
+
+    if (pi->nb_entries >= INT_MAX - 1)
+        return -1;
+
+    if (timestamp == AV_NOPTS_VALUE)
+        return AVERROR(EINVAL);
+
+    if (size < 0 || size > 0x3FFFFFFF)
+        return AVERROR(EINVAL);
+
+    e.pos          = pos;
+    e.timestamp    = timestamp;
+    e.flags        = flags;
+    e.size         = size;
+    e.min_distance = distance;
+
+    if (!pi->nb_entries || pi->last.timestamp < timestamp)
+        return append_entry(pi, &e);
+
+    /* insert into or update the block where the entry belongs */
+    k = FFMAX(find_block_by_timestamp(pi, timestamp), 0);
+    if (pi->cached_block != k)
+        unpack_block(pi, k);
+    nb = old_nb = pi->blocks[k].nb_entries;
+    for (i = 0; i < nb && pi->cache[i].timestamp < timestamp; i++)
+        ;
+    if (i < nb && pi->cache[i].timestamp == timestamp) {
+        if (pi->cache[i].pos == pos && distance < pi->cache[i].min_distance)
+            // do not reduce the distance
+            e.min_distance = pi->cache[i].min_distance;
+    } else {
+        memmove(pi->cache + i + 1, pi->cache + i, (nb - i) * sizeof(*pi->cache));
+        nb++;
+    }
+    pi->cache[i] = e;
+
+    split = nb > PACKED_INDEX_BLOCK_SIZE;
+    if (split) {
+        int half = nb / 2;
+        if ((ret = insert_block(pi, k + 1)) < 0)
+            goto fail;
+        pi->blocks[k + 1].first_index = pi->blocks[k].first_index + half;
+        if ((ret = pack_block(pi, k + 1, pi->cache + half, nb - half)) < 0 ||
+            (ret = pack_block(pi, k, pi->cache, half)) < 0)
+            goto fail;
+    } else if ((ret = pack_block(pi, k, pi->cache, nb)) < 0)
+        goto fail;
+
+    if (nb > old_nb) {
+        int j;
+        for (j = k + 1 + split; j < pi->nb_blocks; j++)
+            pi->blocks[j].first_index++;
+        pi->nb_entries++;
+    }
+    if (i == nb - 1 && k + 1 + split == pi->nb_blocks)
+        pi->last = e;
+
+    return pi->blocks[k].first_index + i;
+fail:
+    /* the block cannot be trusted anymore, drop the whole index */
+    for (i = 0; i < pi->nb_blocks; i++)
+        av_freep(&pi->blocks[i].data);
+    pi->nb_blocks    = pi->nb_entries = 0;
+    pi->data_size    = 0;
+    pi->cached_block = -1;
+    return ret;
+}
+
+AVIndexEntry *ff_packed_index_get(FFPackedIndex *pi, int idx)
+{
+    int k;
+
+    if (idx < 0 || idx >= pi->nb_entries)
+        return NULL;
+    k = find_block_by_index(pi, idx);
+    if (pi->cached_block != k)
+        unpack_block(pi, k);
+    return &pi->cache[idx - pi->blocks[k].first_index];
+}
+
+int ff_packed_index_search(FFPackedIndex *pi, int64_t wanted_timestamp, int flags)
+{
+    int nb_entries = pi->nb_entries;
+    int a = -1, b = 0, m;
+
+    if (nb_entries && pi->last.timestamp < wanted_timestamp) {
+        a = nb_entries - 1;
+        b = nb_entries;
+    } else {
+        int k = find_block_by_timestamp(pi, wanted_timestamp);
+        if (k >= 0) {
+            const PackedIndexBlock *blk = &pi->blocks[k];
+            int lo = 0, hi = blk->nb_entries;
+
+            if (pi->cached_block != k)
+                unpack_block(pi, k);
+            /* last entry of the block at or before the timestamp */
+            while (hi - lo > 1) {
+                m = (lo + hi) >> 1;
+                if (pi->cache[m].timestamp <= wanted_timestamp)
+                    lo = m;
+                else
+                    hi = m;
+            }
+            a = blk->first_index + lo;
+            b = pi->cache[lo].timestamp == wanted_timestamp ? a : a + 1;
+        }
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb_entries &&
+               !(ff_packed_index_get(pi, m)->flags & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
+int ff_packed_index_halve(FFPackedIndex *pi)
+{
+    FFPackedIndex *dst = ff_packed_index_alloc();
+    int i, k, ret = 0;
+
+    if (!dst)
+        return AVERROR(ENOMEM);
+    for (k = 0; k < pi->nb_blocks && ret >= 0; k++) {
+        const PackedIndexBlock *b = &pi->blocks[k];
+        unpack_block(pi, k);
+        for (i = b->first_index & 1; i < b->nb_entries && ret >= 0; i += 2)
+            ret = append_entry(dst, &pi->cache[i]);
+    }
+    if (ret < 0) {
+        ff_packed_index_free(&dst);
+        return ret;
+    }
+
+    for (i = 0; i < pi->nb_blocks; i++)
+        av_free(pi->blocks[i].data);
+    av_free(pi->blocks);
+    pi->blocks                = dst->blocks;
+    pi->nb_blocks             = dst->nb_blocks;
+    pi->blocks_allocated_size = dst->blocks_allocated_size;
+    pi->nb_entries            = dst->nb_entries;
+    pi->data_size             = dst->data_size;
+    pi->last                  = dst->last;
+    pi->cached_block          = -1;
+    av_free(dst);
+    return 0;
+}
+
+void ff_packed_index_shift_pos(FFPackedIndex *pi, int64_t offset)
+{
+    int i;
+
+    for (i = 0; i < pi->nb_blocks; i++)
+        pi->blocks[i].first_pos += offset;
+    pi->last.pos += offset;
+    if (pi->cached_block >= 0)
+        for (i = 0; i < pi->blocks[pi->cached_block].nb_entries; i++)
+            pi->cache[i].pos += offset;
+}
+
+size_t ff_packed_index_size(const FFPackedIndex *pi)
+{
+    return pi->blocks_allocated_size + pi->data_size;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Compact storage of a stream index.
+ *
+ * The entries are split in blocks of at most PACKED_INDEX_BLOCK_SIZE
+ * entries. Each entry of a block is stored as variable length deltas to the
+ * previous one, the first timestamp and position of each block are kept
+ * unpacked so that timestamps are searched block by block. One block at a
+ * time is unpacked to access its entries.
+ */
+
+#ifndef AVFORMAT_PACKEDINDEX_H
+#define AVFORMAT_PACKEDINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "avformat.h"
+
+#define PACKED_INDEX_BLOCK_SIZE 64
+
+typedef struct PackedIndexBlock {
+    int64_t first_timestamp;
+    int64_t first_pos;
+    int first_index;            ///< index of the first entry in the whole index
+    int nb_entries;
+    uint8_t *data;
+    unsigned data_size;
+    unsigned data_allocated_size;
+} PackedIndexBlock;
+
+typedef struct FFPackedIndex {
+    PackedIndexBlock *blocks;
+    int nb_blocks;
+    unsigned blocks_allocated_size;
+    int nb_entries;
+    size_t data_size;           ///< allocated size of the data of all the blocks
+
+    AVIndexEntry last;          ///< last entry of the index, entries are appended after it
+
+    /**
+     * Unpacked entries of the block cached_block, one more than a block
+     * holds for insertions.
+     */
+    AVIndexEntry cache[PACKED_INDEX_BLOCK_SIZE + 1];
+    int cached_block;
+} FFPackedIndex;
+
+FFPackedIndex *ff_packed_index_alloc(void);
+
+void ff_packed_index_free(FFPackedIndex **pi);
+
+/**
+ * Add an entry, with the semantics of ff_add_index_entry().
+ *
+ * @return the index of the entry, < 0 on error
+ */
+int ff_packed_index_add(FFPackedIndex *pi, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags);
+
+/**
+ * Get an entry. The returned pointer is valid until the next call on the
+ * index.
+ *
+ * @return the entry, NULL if idx is out of range
+ */
+AVIndexEntry *ff_packed_index_get(FFPackedIndex *pi, int idx);
+
+/**
+ * Find an entry, with the semantics of ff_index_search_timestamp() for
+ * entries without AVINDEX_DISCARD_FRAME.
+ */
+int ff_packed_index_search(FFPackedIndex *pi, int64_t wanted_timestamp, int flags);
+
+/**
+ * Keep one entry out of two, like ff_reduce_index().
+ */
+int ff_packed_index_halve(FFPackedIndex *pi);
+
+/**
+ * Add offset to the position of all the entries.
+ */
+void ff_packed_index_shift_pos(FFPackedIndex *pi, int64_t offset);
+
+/**
+ * @return the memory used by the entries, in bytes
+ */
+size_t ff_packed_index_size(const FFPackedIndex *pi);
+
+#endif /* AVFORMAT_PACKEDINDEX_H */
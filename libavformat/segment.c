@@ -119,6 +119,7 @@ typedef struct SegmentContext {
     int   reference_stream_index;
     int   break_non_keyframes;
     int   write_empty;
+    int   async_write_size;
 
     int use_rename;
     char temp_list_filename[1024];
@@ -226,6 +227,19 @@ static int set_segment_filename(AVFormatContext *s)
     return 0;
 }
 
+static int open_segment_file(AVFormatContext *s, const char *filename)
+{
+    SegmentContext *seg = s->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    if (seg->async_write_size)
+        av_dict_set_int(&options, "async_write_size", seg->async_write_size, 0);
+    ret = s->io_open(s, &seg->avf->pb, filename, AVIO_FLAG_WRITE, &options);
+    av_dict_free(&options);
+    return ret;
+}
+
 static int segment_start(AVFormatContext *s, int write_header)
 {
     SegmentContext *seg = s->priv_data;
@@ -247,7 +261,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->filename, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = open_segment_file(s, oc->filename)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->filename);
         return err;
     }
@@ -357,8 +371,13 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         return AVERROR(EINVAL);
 
     av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
-    if (write_trailer)
+    if (write_trailer) {
         ret = av_write_trailer(oc);
+    } else {
+        /* report the errors of the asynchronous writes */
+        avio_flush(oc->pb);
+        ret = oc->pb->error;
+    }
 
     if (ret < 0)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
@@ -746,9 +765,8 @@ static int seg_init(AVFormatContext *s)
     oc = seg->avf;
 
     if (seg->write_header_trailer) {
-        if ((ret = s->io_open(s, &oc->pb,
-                              seg->header_filename ? seg->header_filename : oc->filename,
-                              AVIO_FLAG_WRITE, NULL)) < 0) {
+        if ((ret = open_segment_file(s, seg->header_filename ? seg->header_filename
+                                                             : oc->filename)) < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->filename);
             return ret;
         }
@@ -832,7 +850,7 @@ static int seg_write_header(AVFormatContext *s)
         } else {
             close_null_ctxp(&oc->pb);
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->filename, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = open_segment_file(s, oc->filename)) < 0)
             return ret;
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
@@ -1057,6 +1075,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the begin of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "async_write_size", "write the segments from a separate thread, buffering up to this number of bytes", OFFSET(async_write_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
     { NULL },
 };
 
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -76,6 +77,15 @@
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH_SIZE 1024
+
+#define HAVE_UDP_BATCH (HAVE_PTHREAD_CANCEL && (HAVE_RECVMMSG || HAVE_SENDMMSG))
+
+#if HAVE_UDP_BATCH
+/* room for a SCM_TIMESTAMPNS and a SO_RXQ_OVFL message */
+#define UDP_CONTROL_SIZE (CMSG_SPACE(sizeof(struct timespec)) + \
+                          CMSG_SPACE(sizeof(uint32_t)))
+#endif
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -113,6 +123,25 @@ typedef struct UDPContext {
     struct sockaddr_storage local_addr_storage;
     char *sources;
     char *block;
+
+    int batch_size;
+    int timestamps;
+#if HAVE_UDP_BATCH
+    /* datagrams received or sent at once by the circular buffer thread */
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    uint8_t *batch_buf;
+    uint8_t *control_buf;
+    int slot_size;
+#endif
+
+    /* statistics of the receiving circular buffer thread */
+    uint64_t nb_datagrams;
+    uint64_t nb_calls;
+    uint64_t nb_overruns;
+    uint32_t kernel_drops;
+    int64_t total_latency;
+    int64_t max_latency;
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -137,6 +166,8 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Max number of datagrams received or sent per system call by the circular buffer thread", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, UDP_MAX_BATCH_SIZE, .flags = D|E },
+    { "timestamps",     "Measure the receive latency with kernel timestamps", OFFSET(timestamps),  AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
     { NULL }
 };
 
@@ -495,7 +526,115 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_UDP_BATCH
+static int udp_alloc_batch(UDPContext *s, int is_output)
+{
+    int i;
+
+    s->slot_size   = s->pkt_size > 0 ? FFMIN(s->pkt_size, UDP_MAX_PKT_SIZE) : UDP_MAX_PKT_SIZE;
+    s->msgs        = av_mallocz_array(s->batch_size, sizeof(*s->msgs));
+    s->iovs        = av_mallocz_array(s->batch_size, sizeof(*s->iovs));
+    s->batch_buf   = av_malloc_array(s->batch_size, s->slot_size);
+    s->control_buf = is_output ? NULL : av_mallocz_array(s->batch_size, UDP_CONTROL_SIZE);
+    if (!s->msgs || !s->iovs || !s->batch_buf || (!is_output && !s->control_buf))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->batch_size; i++) {
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        s->iovs[i].iov_base = s->batch_buf + i * s->slot_size;
+        s->iovs[i].iov_len  = s->slot_size;
+        hdr->msg_iov        = &s->iovs[i];
+        hdr->msg_iovlen     = 1;
+        if (is_output && !s->is_connected) {
+            hdr->msg_name    = &s->dest_addr;
+            hdr->msg_namelen = s->dest_addr_len;
+        }
+    }
+    return 0;
+}
+
+static void udp_free_batch(UDPContext *s)
+{
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+    av_freep(&s->batch_buf);
+    av_freep(&s->control_buf);
+}
+
+static void udp_enable_control(URLContext *h, UDPContext *s)
+{
+    int one = 1;
+
+#ifdef SO_RXQ_OVFL
+    if (setsockopt(s->udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+        log_net_error(h, AV_LOG_VERBOSE, "setsockopt(SO_RXQ_OVFL)");
+#endif
+    if (s->timestamps) {
+#ifdef SO_TIMESTAMPNS
+        if (setsockopt(s->udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+            log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TIMESTAMPNS)");
+#else
+        av_log(h, AV_LOG_WARNING, "Kernel timestamps are not supported on this system\n");
+#endif
+    }
+}
+
+static void udp_parse_control(UDPContext *s, struct msghdr *hdr, int64_t now)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SCM_TIMESTAMPNS
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            int64_t latency;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            latency = now - (ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000);
+            s->total_latency += latency;
+            s->max_latency    = FFMAX(s->max_latency, latency);
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_type == SO_RXQ_OVFL)
+            memcpy(&s->kernel_drops, CMSG_DATA(cmsg), sizeof(s->kernel_drops));
+#endif
+    }
+}
+#endif
+
 #if HAVE_PTHREAD_CANCEL
+/* called with the mutex locked */
+static int circular_buffer_write(URLContext *h, const uint8_t *buf, int len)
+{
+    UDPContext *s = h->priv_data;
+    uint8_t tmp[4];
+
+    if(av_fifo_space(s->fifo) < len + 4) {
+        /* No Space left */
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            s->nb_overruns++;
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            s->circular_buffer_error = AVERROR(EIO);
+            return AVERROR(EIO);
+        }
+    }
+    AV_WL32(tmp, len);
+    av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+    av_fifo_generic_write(s->fifo, (uint8_t *)buf, len, NULL);
+    s->nb_datagrams++;
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -517,6 +656,17 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_UDP_BATCH && HAVE_RECVMMSG
+        if (s->msgs) {
+            int i;
+            for (i = 0; i < s->batch_size; i++) {
+                s->msgs[i].msg_hdr.msg_control    = s->control_buf + i * UDP_CONTROL_SIZE;
+                s->msgs[i].msg_hdr.msg_controllen = UDP_CONTROL_SIZE;
+            }
+            /* wait for one datagram, then take all those already queued */
+            len = recvmmsg(s->udp_fd, s->msgs, s->batch_size, MSG_WAITFORONE, NULL);
+        } else
+#endif
         len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -527,23 +677,28 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
-        AV_WL32(s->tmp, len);
-
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+        s->nb_calls++;
+
+#if HAVE_UDP_BATCH && HAVE_RECVMMSG
+        if (s->msgs) {
+            int64_t now = av_gettime();
+            int i;
+
+            for (i = 0; i < len; i++) {
+                struct mmsghdr *msg = &s->msgs[i];
+
+                udp_parse_control(s, &msg->msg_hdr, now);
+                if (msg->msg_hdr.msg_flags & MSG_TRUNC)
+                    av_log(h, AV_LOG_WARNING, "Datagram truncated to %d bytes, "
+                           "increase pkt_size\n", s->slot_size);
+                if (circular_buffer_write(h, msg->msg_hdr.msg_iov->iov_base,
+                                          msg->msg_len) < 0)
+                    goto end;
             }
-        }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
+        } else
+#endif
+        if (circular_buffer_write(h, s->tmp + 4, len) < 0)
+            goto end;
         pthread_cond_signal(&s->cond);
     }
 
@@ -553,6 +708,25 @@ end:
     return NULL;
 }
 
+#if HAVE_UDP_BATCH && HAVE_SENDMMSG
+static int udp_send_batch(UDPContext *s, int nb_msgs)
+{
+    int i = 0;
+
+    while (i < nb_msgs) {
+        int ret = sendmmsg(s->udp_fd, s->msgs + i, nb_msgs - i, 0);
+        if (ret >= 0) {
+            i += ret;
+        } else {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+    }
+    return 0;
+}
+#endif
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -574,10 +748,10 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
+        int len, nb_msgs = 0;
         const uint8_t *p;
         uint8_t tmp[4];
-        int64_t timestamp;
+        int64_t timestamp, delay = 0;
 
         len=av_fifo_size(s->fifo);
 
@@ -590,37 +764,78 @@ static void *circular_buffer_task_tx( void *_URLContext)
             len=av_fifo_size(s->fifo);
         }
 
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len=AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
-
-        pthread_mutex_unlock(&s->mutex);
-        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-
         if (s->bitrate) {
             timestamp = av_gettime_relative();
             if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
+                delay = target_timestamp - timestamp;
                 if (delay > max_delay) {
                     delay = max_delay;
                     start_timestamp = timestamp + delay;
                     sent_bits = 0;
                 }
-                av_usleep(delay);
             } else {
                 if (timestamp - burst_interval > target_timestamp) {
                     start_timestamp = timestamp - burst_interval;
                     sent_bits = 0;
                 }
             }
+        }
+
+#if HAVE_UDP_BATCH && HAVE_SENDMMSG
+        /* take as many queued datagrams as fit in a batch, and with a
+         * bitrate, only those that are due once the first one is sent */
+        if (s->msgs) {
+            len = 0;
+            while (nb_msgs < s->batch_size && av_fifo_size(s->fifo) >= 4) {
+                int size;
+
+                if (nb_msgs && s->bitrate &&
+                    start_timestamp + (sent_bits + len * 8) * 1000000 / s->bitrate >
+                    timestamp + delay)
+                    break;
+                av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+                size = AV_RL32(tmp);
+                if (size > s->slot_size)
+                    break;
+                av_fifo_drain(s->fifo, 4);
+                av_fifo_generic_read(s->fifo, s->iovs[nb_msgs].iov_base, size, NULL);
+                s->iovs[nb_msgs++].iov_len = size;
+                len += size;
+            }
+        }
+#endif
+        if (!nb_msgs) {
+            av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+            len=AV_RL32(tmp);
+
+            av_assert0(len >= 0);
+            av_assert0(len <= sizeof(s->tmp));
+
+            av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+        }
+
+        pthread_mutex_unlock(&s->mutex);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+
+        if (s->bitrate) {
+            if (delay)
+                av_usleep(delay);
             sent_bits += len * 8;
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
+#if HAVE_UDP_BATCH && HAVE_SENDMMSG
+        if (nb_msgs) {
+            int ret = udp_send_batch(s, nb_msgs);
+            if (ret < 0) {
+                pthread_mutex_lock(&s->mutex);
+                s->circular_buffer_error = ret;
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
+            }
+            len = 0;
+        }
+#endif
         p = s->tmp;
         while (len) {
             int ret;
@@ -788,6 +1003,10 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         }
         if (!is_output && av_find_info_tag(buf, sizeof(buf), "timeout", p))
             s->timeout = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p))
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH_SIZE);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "timestamps", p))
+            s->timestamps = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
     }
@@ -958,6 +1177,11 @@ static int udp_open(URLContext *h, const char *uri, int flags)
       2. Output and bitrate and circular_buffer_size is set
     */
 
+    if ((s->batch_size > 1 || s->timestamps) &&
+        (is_output ? !s->bitrate || !s->circular_buffer_size : !s->circular_buffer_size))
+        av_log(h, AV_LOG_WARNING, "'batch_size' and 'timestamps' options are "
+               "only used with the circular buffer\n");
+
     if (is_output && s->bitrate && !s->circular_buffer_size) {
         /* Warn user in case of 'circular_buffer_size' is not set */
         av_log(h, AV_LOG_WARNING,"'bitrate' option was set but 'circular_buffer_size' is not, but required\n");
@@ -966,6 +1190,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
         int ret;
 
+#if HAVE_UDP_BATCH
+        if (is_output ? HAVE_SENDMMSG && s->batch_size > 1 :
+                        HAVE_RECVMMSG && (s->batch_size > 1 || s->timestamps)) {
+            if (udp_alloc_batch(s, is_output) < 0)
+                goto fail;
+            if (!is_output)
+                udp_enable_control(h, s);
+        } else
+#endif
+        if (s->batch_size > 1 || s->timestamps)
+            av_log(h, AV_LOG_WARNING, "'batch_size' or 'timestamps' option was "
+                   "set but it is not supported on this build (recvmmsg() or "
+                   "sendmmsg() is required)\n");
+
         /* start the task going */
         s->fifo = av_fifo_alloc(s->circular_buffer_size);
         ret = pthread_mutex_init(&s->mutex, NULL);
@@ -998,6 +1236,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_UDP_BATCH
+    udp_free_batch(s);
+#endif
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -1151,10 +1392,26 @@ static int udp_close(URLContext *h)
             av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
+
+        if (h->flags & AVIO_FLAG_READ) {
+            uint64_t nb_received = s->nb_datagrams + s->nb_overruns;
+
+            av_log(h, AV_LOG_VERBOSE, "%"PRIu64" datagrams received in %"PRIu64
+                   " calls, %"PRIu64" dropped on circular buffer overrun, "
+                   "%"PRIu32" dropped by the kernel\n", nb_received, s->nb_calls,
+                   s->nb_overruns, s->kernel_drops);
+            if (s->timestamps && nb_received)
+                av_log(h, AV_LOG_VERBOSE, "Receive latency %"PRId64" us average, "
+                       "%"PRId64" us max\n", s->total_latency / (int64_t)nb_received,
+                       s->max_latency);
+        }
     }
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_UDP_BATCH
+    udp_free_batch(s);
+#endif
     return 0;
 }
 
@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -66,6 +67,7 @@ typedef struct URLContext {
     int64_t rw_timeout;         /**< maximum time to wait for (network) read/write operation completion, in mcs */
     const char *protocol_whitelist;
     const char *protocol_blacklist;
+    int async_write_size;       /**< if non zero, the AVIOContext writes through a thread, buffering up to this size */
 } URLContext;
 
 //ÿЭ飨rtprtmpfileȣӦһURLProtocol
@@ -121,6 +123,14 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    /**
+     * Get size bytes of the resource at pos in a buffer followed by
+     * AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes, referencing the data
+     * without copying it where possible, for protocols which have the
+     * whole resource mapped in memory. Does not change the read position.
+     * @return number of bytes returned, 0 at the end of the resource
+     */
+    int (*url_get_buffer)(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     int priv_data_size;
     const AVClass *priv_data_class;
@@ -292,6 +302,15 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Get padded data of the resource, referenced without copying it where
+ * possible, see URLProtocol.url_get_buffer.
+ *
+ * @return number of bytes returned, 0 at the end of the resource, or
+ *         AVERROR(ENOSYS) if the protocol does not support it
+ */
+int ffurl_get_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
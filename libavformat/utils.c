@@ -48,6 +48,7 @@
 #include "metadata.h"
 #if CONFIG_NETWORK
 #include "network.h"
+#include "packedindex.h"
 #endif
 #include "riff.h"
 #include "url.h"
@@ -297,6 +298,33 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf = NULL;
+    int64_t pos = avio_tell(s);
+    int ret;
+
+    if (size <= 0)
+        return av_get_packet(s, pkt, size);
+    ret = ffio_read_buffer_ref(s, &buf, size);
+    if (ret == AVERROR(ENOSYS))
+        return av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = 0;
+    pkt->pos  = pos;
+    if (ret <= 0)
+        return ret ? ret : AVERROR_EOF;
+
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = ret;
+    if (ret < size)
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+    return ret;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -2083,9 +2111,14 @@ void ff_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timestamp)
 void ff_reduce_index(AVFormatContext *s, int stream_index)
 {
     AVStream *st             = s->streams[stream_index];
+    FFPackedIndex *pi        = st->internal->packed_index;
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
-    if ((unsigned) st->nb_index_entries >= max_entries) {
+    if (pi) {
+        if (ff_packed_index_size(pi) >= s->max_index_size &&
+            ff_packed_index_halve(pi) >= 0)
+            st->nb_index_entries = pi->nb_entries;
+    } else if ((unsigned) st->nb_index_entries >= max_entries) {
         int i;
         for (i = 0; 2 * i < st->nb_index_entries; i++)
             st->index_entries[i] = st->index_entries[2 * i];
@@ -2156,11 +2189,33 @@ int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                        int size, int distance, int flags)
 {
     timestamp = wrap_timestamp(st, timestamp);
+    if (st->internal->packed_index) {
+        FFPackedIndex *pi = st->internal->packed_index;
+        int ret;
+
+        if (is_relative(timestamp))
+            timestamp -= RELATIVE_TS_BASE;
+        ret = ff_packed_index_add(pi, pos, timestamp, size, distance, flags);
+        st->nb_index_entries = pi->nb_entries;
+        return ret;
+    }
     return ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
                               &st->index_entries_allocated_size, pos,
                               timestamp, size, distance, flags);
 }
 
+void ff_index_shift_pos(AVStream *st, int64_t offset)
+{
+    int i;
+
+    if (st->internal->packed_index) {
+        ff_packed_index_shift_pos(st->internal->packed_index, offset);
+        return;
+    }
+    for (i = 0; i < st->nb_index_entries; i++)
+        st->index_entries[i].pos += offset;
+}
+
 int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
                               int64_t wanted_timestamp, int flags)
 {
@@ -2232,12 +2287,12 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
                 continue;
 
             for (i1 = i2 = 0; i1 < st1->nb_index_entries; i1++) {
-                AVIndexEntry *e1 = &st1->index_entries[i1];
+                const AVIndexEntry *e1 = avformat_index_get_entry(st1, i1);
                 int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
 
                 skip = FFMAX(skip, e1->size);
                 for (; i2 < st2->nb_index_entries; i2++) {
-                    AVIndexEntry *e2 = &st2->index_entries[i2];
+                    const AVIndexEntry *e2 = avformat_index_get_entry(st2, i2);
                     int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
                     if (e2_pts - e1_pts < time_tolerance)
                         continue;
@@ -2263,10 +2318,35 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
+    if (st->internal->packed_index)
+        return ff_packed_index_search(st->internal->packed_index,
+                                      wanted_timestamp, flags);
     return ff_index_search_timestamp(st->index_entries, st->nb_index_entries,
                                      wanted_timestamp, flags);
 }
 
+int avformat_index_get_entries_count(const AVStream *st)
+{
+    return st->nb_index_entries;
+}
+
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
+{
+    if (st->internal->packed_index)
+        return ff_packed_index_get(st->internal->packed_index, idx);
+    if (idx < 0 || idx >= st->nb_index_entries)
+        return NULL;
+    return &st->index_entries[idx];
+}
+
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags)
+{
+    return avformat_index_get_entry(st,
+               av_index_search_timestamp(st, wanted_timestamp, flags));
+}
+
 static int64_t ff_read_timestamp(AVFormatContext *s, int stream_index, int64_t *ppos, int64_t pos_limit,
                                  int64_t (*read_timestamp)(struct AVFormatContext *, int , int64_t *, int64_t ))
 {
@@ -2296,15 +2376,15 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
     pos_limit = -1; // GCC falsely says it may be uninitialized.
 
     st = s->streams[stream_index];
-    if (st->index_entries) {
-        AVIndexEntry *e;
+    if (st->nb_index_entries) {
+        const AVIndexEntry *e;
 
         /* FIXME: Whole function must be checked for non-keyframe entries in
          * index case, especially read_timestamp(). */
         index = av_index_search_timestamp(st, target_ts,
                                           flags | AVSEEK_FLAG_BACKWARD);
         index = FFMAX(index, 0);
-        e     = &st->index_entries[index];
+        e     = avformat_index_get_entry(st, index);
 
         if (e->timestamp <= target_ts || e->pos == e->min_distance) {
             pos_min = e->pos;
@@ -2319,7 +2399,7 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
                                           flags & ~AVSEEK_FLAG_BACKWARD);
         av_assert0(index < st->nb_index_entries);
         if (index >= 0) {
-            e = &st->index_entries[index];
+            e = avformat_index_get_entry(st, index);
             av_assert1(e->timestamp >= target_ts);
             pos_max   = e->pos;
             ts_max    = e->timestamp;
@@ -2514,14 +2594,14 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     int index;
     int64_t ret;
     AVStream *st;
-    AVIndexEntry *ie;
+    const AVIndexEntry *ie;
 
     st = s->streams[stream_index];
 
     index = av_index_search_timestamp(st, timestamp, flags);
 
     if (index < 0 && st->nb_index_entries &&
-        timestamp < st->index_entries[0].timestamp)
+        timestamp < avformat_index_get_entry(st, 0)->timestamp)
         return -1;
 
     if (index < 0 || index == st->nb_index_entries - 1) {
@@ -2529,8 +2609,8 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
         int nonkey = 0;
 
         if (st->nb_index_entries) {
-            av_assert0(st->index_entries);
-            ie = &st->index_entries[st->nb_index_entries - 1];
+            ie = avformat_index_get_entry(st, st->nb_index_entries - 1);
+            av_assert0(ie);
             if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
                 return ret;
             ff_update_cur_dts(s, st, ie->timestamp);
@@ -2567,7 +2647,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     if (s->iformat->read_seek)
         if (s->iformat->read_seek(s, stream_index, timestamp, flags) >= 0)
             return 0;
-    ie = &st->index_entries[index];
+    ie = avformat_index_get_entry(st, index);
     if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
         return ret;
     ff_update_cur_dts(s, st, ie->timestamp);
@@ -4514,6 +4594,7 @@ static void free_stream(AVStream **pst)
         }
         av_bsf_free(&st->internal->extract_extradata.bsf);
         av_packet_free(&st->internal->extract_extradata.pkt);
+        ff_packed_index_free(&st->internal->packed_index);
     }
     av_freep(&st->internal);
 
@@ -4710,6 +4791,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * timestamps have their first few packets buffered and the
          * timestamps corrected before they are returned to the user */
         st->cur_dts = RELATIVE_TS_BASE;
+
+        /* demuxers using the generic index only access it through the
+         * index functions, so it can be packed */
+        if (s->iformat->flags & AVFMT_GENERIC_INDEX) {
+            st->internal->packed_index = ff_packed_index_alloc();
+            if (!st->internal->packed_index)
+                goto fail;
+        }
     } else {
         st->cur_dts = AV_NOPTS_VALUE;
     }
@@ -215,6 +215,10 @@ int av_buffer_realloc(AVBufferRef **pbuf, int size)
     return 0;
 }
 
+/* without 64-bit atomics the free list head has no counter and the free
+ * list has to be locked */
+#define POOL_LOCK_FREE (HAVE_THREADS && HAVE_ATOMIC_CAS64)
+
 AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque))
@@ -230,6 +234,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     pool->alloc2    = alloc;
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->free_head, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -246,24 +251,34 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->free_head, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
 }
 
+static BufferPoolEntry *pool_get_entry(AVBufferPool *pool, unsigned index)
+{
+    unsigned n   = index + (1 << POOL_SEGMENT0_BITS);
+    int segment  = av_log2(n) - POOL_SEGMENT0_BITS;
+
+    return &pool->segments[segment][n - (1U << (segment + POOL_SEGMENT0_BITS))];
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    unsigned i;
 
+    for (i = 0; i < pool->nb_entries; i++) {
+        BufferPoolEntry *buf = pool_get_entry(pool, i);
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
     }
+    for (i = 0; i < POOL_MAX_SEGMENTS; i++)
+        av_freep(&pool->segments[i]);
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -285,6 +300,56 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+/* the high bits of the free list head count its changes */
+#define FREE_HEAD(index, prev) ((uint64_t)(index) | \
+                                ((((uint64_t)(prev) >> 32) + 1) << 32))
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    PoolHead head;
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_lock(&pool->mutex);
+
+    head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&buf->next, (uint32_t)head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head,
+                                                    FREE_HEAD(buf->index + 1, head),
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_unlock(&pool->mutex);
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf = NULL;
+    PoolHead head;
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_lock(&pool->mutex);
+
+    /* The next index read here may be stale if the entry was popped by
+     * another thread in the meantime, but then the head has changed and
+     * the compare-and-swap fails. */
+    head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    while ((uint32_t)head) {
+        buf = pool_get_entry(pool, (uint32_t)head - 1);
+        if (atomic_compare_exchange_weak_explicit(&pool->free_head, &head,
+                FREE_HEAD(atomic_load_explicit(&buf->next, memory_order_relaxed), head),
+                memory_order_acquire, memory_order_acquire))
+            break;
+        buf = NULL;
+    }
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_unlock(&pool->mutex);
+
+    return buf;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -293,10 +358,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_add_explicit(&pool->refcount, -1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -308,27 +370,42 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
+    int segment;
+
+    ff_mutex_lock(&pool->mutex);
+
+    segment = av_log2(pool->nb_entries + (1 << POOL_SEGMENT0_BITS)) - POOL_SEGMENT0_BITS;
+    if (segment >= POOL_MAX_SEGMENTS)
+        goto fail;
+    if (!pool->segments[segment]) {
+        pool->segments[segment] = av_mallocz_array(1 << (segment + POOL_SEGMENT0_BITS),
+                                                   sizeof(*pool->segments[segment]));
+        if (!pool->segments[segment])
+            goto fail;
+    }
 
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
     if (!ret)
-        return NULL;
-
-    buf = av_mallocz(sizeof(*buf));
-    if (!buf) {
-        av_buffer_unref(&ret);
-        return NULL;
-    }
+        goto fail;
 
+    buf = pool_get_entry(pool, pool->nb_entries);
     buf->data   = ret->buffer->data;
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    buf->index  = pool->nb_entries++;
+    atomic_init(&buf->next, 0);
+
+    ff_mutex_unlock(&pool->mutex);
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
     return ret;
+fail:
+    ff_mutex_unlock(&pool->mutex);
+    return NULL;
 }
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
@@ -336,19 +413,15 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
+        if (!ret)
+            pool_push(pool, buf);
     } else {
         ret = pool_alloc_buffer(pool);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -22,6 +22,7 @@
 #include <stdatomic.h>
 #include <stdint.h>
 
+#include "config.h"
 #include "buffer.h"
 #include "thread.h"
 
@@ -59,6 +60,13 @@ struct AVBuffer {
     int flags;
 };
 
+/**
+ * log2 of the number of entries in the first segment of a pool, each
+ * following segment is twice as large as the previous one.
+ */
+#define POOL_SEGMENT0_BITS 4
+#define POOL_MAX_SEGMENTS  24
+
 typedef struct BufferPoolEntry {
     uint8_t *data;
 
@@ -70,12 +78,44 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /* index of this entry in the pool */
+    uint32_t index;
+
+    /* index + 1 of the next free entry, 0 for none */
+    atomic_uint next;
 } BufferPoolEntry;
 
+#if HAVE_ATOMIC_CAS64
+typedef uint_least64_t PoolHead;
+typedef atomic_uint_least64_t AtomicPoolHead;
+#else
+typedef unsigned int PoolHead;
+typedef atomic_uint AtomicPoolHead;
+#endif
+
 struct AVBufferPool {
+    /*
+     * Serializes the allocation of new buffers, and the accesses to the free
+     * list when 64-bit atomics are not available.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /*
+     * Head of the free list: index + 1 of the first free entry in the low
+     * 32 bits, and in the high bits a counter incremented on every change
+     * so that a compare-and-swap does not succeed on a head that was popped
+     * and pushed back in the meantime (the ABA problem). Without 64-bit
+     * atomics, only the index is kept and the free list is locked.
+     */
+    AtomicPoolHead free_head;
+
+    /*
+     * The entries are allocated in segments that are never moved, so that
+     * they can be looked up from their index without locking.
+     */
+    BufferPoolEntry *segments[POOL_MAX_SEGMENTS];
+    unsigned nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -0,0 +1,145 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Stress a buffer pool shared by several threads, checking that a buffer is
+ * never handed out twice at the same time. With -bench, report the number
+ * of buffers got from and returned to the pool per second for 1 to N threads.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUFFER_SIZE 1024
+#define MAX_HELD    4
+
+typedef struct ThreadData {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadData;
+
+static void *thread_main(void *arg)
+{
+    ThreadData *td = arg;
+    AVBufferRef *bufs[MAX_HELD];
+    int i, j;
+
+    for (i = 0; i < td->iterations; i++) {
+        int held = 1 + i % MAX_HELD;
+
+        for (j = 0; j < held; j++) {
+            bufs[j] = av_buffer_pool_get(td->pool);
+            if (!bufs[j]) {
+                td->errors++;
+                held = j;
+                break;
+            }
+            AV_WN32(bufs[j]->data, td->id);
+            AV_WN32(bufs[j]->data + BUFFER_SIZE - 4, i);
+        }
+        for (j = 0; j < held; j++) {
+            if (AV_RN32(bufs[j]->data)                   != td->id ||
+                AV_RN32(bufs[j]->data + BUFFER_SIZE - 4) != i)
+                td->errors++;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static int run_test(int nb_threads, int iterations, int bench)
+{
+    AVBufferPool *pool = av_buffer_pool_init(BUFFER_SIZE, NULL);
+    ThreadData td[64];
+    pthread_t threads[64];
+    int64_t t;
+    int i, ret, errors = 0;
+
+    if (!pool)
+        return 1;
+
+    t = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        td[i].pool       = pool;
+        td[i].id         = i;
+        td[i].iterations = iterations;
+        td[i].errors     = 0;
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &td[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            nb_threads = i;
+            errors++;
+            break;
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += td[i].errors;
+    }
+    t = av_gettime_relative() - t;
+
+    av_buffer_pool_uninit(&pool);
+
+    if (bench) {
+        /* one get and one unref per held buffer */
+        int64_t allocs = (int64_t)nb_threads * iterations * (MAX_HELD + 1) / 2;
+        printf("threads %2d: %10"PRId64" allocations/s, %8"PRId64" per thread\n",
+               nb_threads, allocs * 1000000 / FFMAX(t, 1),
+               allocs * 1000000 / FFMAX(t, 1) / nb_threads);
+    }
+    if (errors)
+        fprintf(stderr, "threads %d: %d errors\n", nb_threads, errors);
+
+    return errors != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = 4, iterations = 20000, bench = 0;
+    int i, ret = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-bench")) {
+            bench       = 1;
+            max_threads = av_cpu_count();
+            iterations  = 1000000;
+        } else if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-bench] [-threads <max threads>]\n", argv[0]);
+            return 1;
+        }
+    }
+    max_threads = av_clip(max_threads, 1, 64);
+
+    for (i = 1; i <= max_threads; i++)
+        ret |= run_test(i, iterations, bench);
+
+    return ret;
+}
@@ -0,0 +1,283 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Libswscale multithreading support
+ *
+ * The destination picture is cut into horizontal bands, one per thread.
+ * Every band is scaled with sws_scale_dst_slice() from its own copy of
+ * the scaler context, so the workers share nothing but the read-only
+ * source picture.
+ */
+
+#include "config.h"
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+
+#include "swscale.h"
+#include "swscale_internal.h"
+
+/* sws_scale_dst_slice() needs slices aligned to this many lines */
+#define SLICE_ALIGN 8
+
+typedef struct SwsThreadContext {
+    SwsContext *sws;
+
+    int nb_threads;
+    pthread_t *workers;
+
+    /* per-execute parameters */
+    const uint8_t *const *src;
+    const int *src_stride;
+    uint8_t *const *dst;
+    const int *dst_stride;
+    int *rets;
+    int nb_jobs;
+
+    pthread_cond_t last_job_cond;
+    pthread_cond_t current_job_cond;
+    pthread_mutex_t current_job_lock;
+    int current_job;
+    unsigned int current_execute;
+    int done;
+} SwsThreadContext;
+
+static int scale_job(SwsThreadContext *c, int jobnr, int nb_jobs)
+{
+    SwsContext *sws = jobnr ? c->sws->slice_ctx[jobnr - 1] : c->sws;
+    const int dstH  = c->sws->dstH;
+    const int slice_start = (dstH *  jobnr     ) / nb_jobs / SLICE_ALIGN * SLICE_ALIGN;
+    const int slice_end   = jobnr == nb_jobs - 1 ? dstH :
+                            (dstH * (jobnr + 1)) / nb_jobs / SLICE_ALIGN * SLICE_ALIGN;
+
+    return sws_scale_dst_slice(sws, c->src, c->src_stride, c->dst, c->dst_stride,
+                               slice_start, slice_end - slice_start);
+}
+
+static void* attribute_align_arg worker(void *v)
+{
+    SwsThreadContext *c = v;
+    int our_job      = c->nb_jobs;
+    int nb_threads   = c->nb_threads;
+    unsigned int last_execute = 0;
+    int ret, self_id;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    self_id = c->current_job++;
+
+    for (;;) {
+        while (our_job >= c->nb_jobs) {
+            if (c->current_job == nb_threads + c->nb_jobs)
+                pthread_cond_signal(&c->last_job_cond);
+
+            while (last_execute == c->current_execute && !c->done)
+                pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
+            last_execute = c->current_execute;
+            our_job = self_id;
+
+            if (c->done) {
+                pthread_mutex_unlock(&c->current_job_lock);
+                return NULL;
+            }
+        }
+        pthread_mutex_unlock(&c->current_job_lock);
+
+        ret = scale_job(c, our_job, c->nb_jobs);
+        c->rets[our_job % c->nb_jobs] = ret;
+
+        pthread_mutex_lock(&c->current_job_lock);
+        our_job = c->current_job++;
+    }
+}
+
+static void slice_thread_uninit(SwsThreadContext *c)
+{
+    int i;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    c->done = 1;
+    pthread_cond_broadcast(&c->current_job_cond);
+    pthread_mutex_unlock(&c->current_job_lock);
+
+    for (i = 0; i < c->nb_threads; i++)
+         pthread_join(c->workers[i], NULL);
+
+    pthread_mutex_destroy(&c->current_job_lock);
+    pthread_cond_destroy(&c->current_job_cond);
+    pthread_cond_destroy(&c->last_job_cond);
+    av_freep(&c->workers);
+    av_freep(&c->rets);
+}
+
+static void slice_thread_park_workers(SwsThreadContext *c)
+{
+    while (c->current_job != c->nb_threads + c->nb_jobs)
+        pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
+    pthread_mutex_unlock(&c->current_job_lock);
+}
+
+static int thread_init_internal(SwsThreadContext *c, int nb_threads)
+{
+    int i, ret;
+
+    c->nb_threads = nb_threads;
+    c->workers = av_mallocz_array(sizeof(*c->workers), nb_threads);
+    c->rets    = av_mallocz_array(sizeof(*c->rets),    nb_threads);
+    if (!c->workers || !c->rets) {
+        av_freep(&c->workers);
+        av_freep(&c->rets);
+        return AVERROR(ENOMEM);
+    }
+
+    c->current_job = 0;
+    c->nb_jobs     = 0;
+    c->done        = 0;
+
+    pthread_cond_init(&c->current_job_cond, NULL);
+    pthread_cond_init(&c->last_job_cond,    NULL);
+
+    pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_lock(&c->current_job_lock);
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&c->workers[i], NULL, worker, c);
+        if (ret) {
+           pthread_mutex_unlock(&c->current_job_lock);
+           c->nb_threads = i;
+           slice_thread_uninit(c);
+           return AVERROR(ret);
+        }
+    }
+
+    slice_thread_park_workers(c);
+
+    return c->nb_threads;
+}
+
+int ff_sws_thread_scale(SwsContext *sws, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[])
+{
+    SwsThreadContext *c = sws->thread;
+    int i, ret;
+
+    /* the colorspace details may have been changed into something that
+     * cannot be split since initialization */
+    ret = sws_scale_dst_slice(sws, NULL, NULL, NULL, NULL, 0, 0);
+    if (ret < 0)
+        return ret;
+
+    pthread_mutex_lock(&c->current_job_lock);
+
+    c->current_job = c->nb_threads;
+    c->nb_jobs     = c->nb_threads;
+    c->src         = src;
+    c->src_stride  = srcStride;
+    c->dst         = dst;
+    c->dst_stride  = dstStride;
+    c->current_execute++;
+
+    pthread_cond_broadcast(&c->current_job_cond);
+
+    slice_thread_park_workers(c);
+
+    for (i = 0; i < c->nb_jobs; i++)
+        if (c->rets[i] < 0)
+            return c->rets[i];
+
+    return sws->dstH;
+}
+
+av_cold int ff_sws_thread_init(SwsContext *c, SwsFilter *srcFilter,
+                               SwsFilter *dstFilter)
+{
+    int nb_threads = c->nb_threads;
+    int i, ret;
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+    nb_threads = FFMIN(nb_threads, c->dstH / SLICE_ALIGN);
+    if (nb_threads <= 1)
+        return 0;
+
+    /* The slice contexts are set up from the options as given by the user,
+     * before the main context is initialized and modifies some of them. */
+    c->slice_ctx = av_mallocz_array(nb_threads - 1, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads - 1; i++) {
+        SwsContext *s = c->slice_ctx[i] = sws_alloc_context();
+        if (!s) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        c->nb_slice_ctx++;
+
+        if ((ret = av_opt_copy(s, c)) < 0)
+            goto fail;
+        s->nb_threads = 1;
+
+        if ((ret = sws_init_context(s, srcFilter, dstFilter)) < 0)
+            goto fail;
+    }
+
+    if (sws_scale_dst_slice(c->slice_ctx[0], NULL, NULL, NULL, NULL, 0, 0) < 0) {
+        av_log(c, AV_LOG_VERBOSE, "Conversion cannot be split into slices, "
+               "not using threads\n");
+        ff_sws_thread_free(c);
+        return 0;
+    }
+
+    c->thread = av_mallocz(sizeof(SwsThreadContext));
+    if (!c->thread) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->thread->sws = c;
+
+    ret = thread_init_internal(c->thread, nb_threads);
+    if (ret < 0) {
+        av_freep(&c->thread);
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    ff_sws_thread_free(c);
+    return ret;
+}
+
+av_cold void ff_sws_thread_free(SwsContext *c)
+{
+    int i;
+
+    if (c->thread)
+        slice_thread_uninit(c->thread);
+    av_freep(&c->thread);
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
@@ -226,6 +226,41 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
               const int srcStride[], int srcSliceY, int srcSliceH,
               uint8_t *const dst[], const int dstStride[]);
 
+/**
+ * Scale the complete image in src and put the destination rows
+ * [dstSliceY, dstSliceY + dstSliceH) of the result in the image in dst.
+ *
+ * Unlike sws_scale(), this function does not depend on the slices
+ * processed by previous calls, so disjoint destination slices of the same
+ * image can be scaled concurrently, each from a separate SwsContext
+ * initialized with the same parameters. The output is identical to what
+ * sws_scale() produces for the same rows.
+ *
+ * dstSliceY and, unless the slice ends at the bottom of the image,
+ * dstSliceH must be multiples of 8.
+ *
+ * @param c          the scaling context previously created with
+ *                   sws_getContext()
+ * @param src        the array containing the pointers to the planes of
+ *                   the complete source image
+ * @param srcStride  the array containing the strides for each plane of
+ *                   the source image
+ * @param dst        the array containing the pointers to the planes of
+ *                   the destination image
+ * @param dstStride  the array containing the strides for each plane of
+ *                   the destination image
+ * @param dstSliceY  the first row of the destination slice
+ * @param dstSliceH  the height of the destination slice
+ * @return           the height of the output slice, AVERROR(ENOSYS) if the
+ *                   conversion can only be done on the whole image with
+ *                   sws_scale(), or another negative error code on failure.
+ *                   A call with dstSliceH set to 0 may be used to check
+ *                   for support without scaling anything.
+ */
+int sws_scale_dst_slice(struct SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[], int dstSliceY, int dstSliceH);
+
 /**
  * @param dstRange flag indicating the while-black range of the output (1=jpeg / 0=mpeg)
  * @param srcRange flag indicating the while-black range of the input (1=jpeg / 0=mpeg)
@@ -22,6 +22,7 @@
 #define SWSCALE_SWSCALE_INTERNAL_H
 
 #include "config.h"
+#include "swscale.h"
 #include "version.h"
 
 #include "libavutil/avassert.h"
@@ -657,6 +658,11 @@ typedef struct SwsContext {
     SwsDither dither;
 
     SwsAlphaBlend alphablend;
+
+    int nb_threads;               ///< Number of threads requested by the user, 0 for automatic.
+    struct SwsContext **slice_ctx; ///< Copies of this context scaling the other slices in threaded mode.
+    int nb_slice_ctx;
+    struct SwsThreadContext *thread;
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -672,6 +678,12 @@ void ff_updateMMXDitherTables(SwsContext *c, int dstY, int lumBufIndex, int chrB
 
 av_cold void ff_sws_init_range_convert(SwsContext *c);
 
+int ff_sws_thread_init(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter);
+void ff_sws_thread_free(SwsContext *c);
+int ff_sws_thread_scale(SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[]);
+
 SwsFunc ff_yuv2rgb_init_x86(SwsContext *c);
 SwsFunc ff_yuv2rgb_init_ppc(SwsContext *c);
 
@@ -0,0 +1,167 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that threaded scaling is bitexact with the single threaded path.
+ * With -bench, measure the scaling efficiency instead: the time per frame
+ * is reported for 1 to N threads along with speedup / number of threads.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#include "libswscale/swscale.h"
+
+static const struct {
+    enum AVPixelFormat src_fmt;
+    int src_w, src_h;
+    enum AVPixelFormat dst_fmt;
+    int dst_w, dst_h;
+    int flags;
+} tests[] = {
+    { AV_PIX_FMT_YUV420P,     1280,  720, AV_PIX_FMT_RGB24,       1280,  720, SWS_BILINEAR },
+    { AV_PIX_FMT_RGB24,       1280,  720, AV_PIX_FMT_YUV420P,     1280,  720, SWS_BILINEAR },
+    { AV_PIX_FMT_BGRA,        1280,  720, AV_PIX_FMT_YUV420P,      640,  360, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV420P,     1920, 1080, AV_PIX_FMT_YUV420P,      640,  360, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV420P,     1920, 1080, AV_PIX_FMT_YUV420P,     1280,  720, SWS_LANCZOS  },
+    { AV_PIX_FMT_YUV420P,      720,  576, AV_PIX_FMT_YUV420P,     1920, 1080, SWS_BICUBIC  },
+    { AV_PIX_FMT_YUV422P10LE, 1920, 1080, AV_PIX_FMT_YUV420P,     1280,  720, SWS_BICUBIC  },
+    { AV_PIX_FMT_NV12,        1920, 1080, AV_PIX_FMT_YUV420P,     1920, 1080, SWS_BICUBIC  },
+};
+
+static struct SwsContext *alloc_context(int i, int threads)
+{
+    struct SwsContext *sws = sws_alloc_context();
+
+    if (!sws)
+        return NULL;
+
+    av_opt_set_int(sws, "srcw",       tests[i].src_w,   0);
+    av_opt_set_int(sws, "srch",       tests[i].src_h,   0);
+    av_opt_set_int(sws, "src_format", tests[i].src_fmt, 0);
+    av_opt_set_int(sws, "dstw",       tests[i].dst_w,   0);
+    av_opt_set_int(sws, "dsth",       tests[i].dst_h,   0);
+    av_opt_set_int(sws, "dst_format", tests[i].dst_fmt, 0);
+    av_opt_set_int(sws, "sws_flags",  tests[i].flags,   0);
+    av_opt_set_int(sws, "threads",    threads,          0);
+
+    if (sws_init_context(sws, NULL, NULL) < 0) {
+        sws_freeContext(sws);
+        return NULL;
+    }
+
+    return sws;
+}
+
+static int run_test(int i, int max_threads, int bench)
+{
+    uint8_t *src[4], *ref[4], *dst[4];
+    int src_stride[4], dst_stride[4];
+    int src_size, dst_size, threads, n, ret = 0;
+    int64_t t1 = 0;
+    AVLFG lfg;
+
+    src_size = av_image_alloc(src, src_stride, tests[i].src_w, tests[i].src_h,
+                              tests[i].src_fmt, 16);
+    dst_size = av_image_alloc(ref, dst_stride, tests[i].dst_w, tests[i].dst_h,
+                              tests[i].dst_fmt, 16);
+    if (src_size < 0 || dst_size < 0 ||
+        av_image_alloc(dst, dst_stride, tests[i].dst_w, tests[i].dst_h,
+                       tests[i].dst_fmt, 16) < 0)
+        return AVERROR(ENOMEM);
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    for (n = 0; n < src_size; n++)
+        src[0][n] = av_lfg_get(&lfg) >> 24;
+
+    for (threads = 1; threads <= max_threads; threads++) {
+        struct SwsContext *sws = alloc_context(i, threads);
+        int iterations = bench ? 20 : 1;
+        int64_t t;
+
+        if (!sws) {
+            ret = AVERROR(EINVAL);
+            break;
+        }
+
+        memset(dst[0], 0, dst_size);
+        t = av_gettime_relative();
+        for (n = 0; n < iterations; n++)
+            sws_scale(sws, (const uint8_t * const *)src, src_stride, 0,
+                      tests[i].src_h, threads == 1 ? ref : dst, dst_stride);
+        t = (av_gettime_relative() - t) / iterations;
+        sws_freeContext(sws);
+
+        if (threads == 1) {
+            t1 = t;
+        } else if (memcmp(ref[0], dst[0], dst_size)) {
+            ret = 1;
+        }
+
+        if (bench || threads > 1)
+            printf("%s %dx%d -> %s %dx%d threads %d: ",
+                   av_get_pix_fmt_name(tests[i].src_fmt), tests[i].src_w, tests[i].src_h,
+                   av_get_pix_fmt_name(tests[i].dst_fmt), tests[i].dst_w, tests[i].dst_h,
+                   threads);
+        if (bench)
+            printf("%8"PRId64" us/frame, efficiency %3d%%", t,
+                   (int)(100 * t1 / FFMAX(t * threads, 1)));
+        if (threads > 1)
+            printf(bench ? " %s" : "%s", ret ? "MISMATCH" : "ok");
+        if (bench || threads > 1)
+            printf("\n");
+    }
+
+    av_freep(&src[0]);
+    av_freep(&ref[0]);
+    av_freep(&dst[0]);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = 4, bench = 0;
+    int i, ret = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-bench")) {
+            bench = 1;
+            max_threads = av_cpu_count();
+        } else if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-bench] [-threads <max threads>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++)
+        ret |= run_test(i, max_threads, bench);
+
+    return ret != 0;
+}
@@ -870,6 +870,15 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i, ret;
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        ret = sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange,
+                                       table, dstRange,
+                                       brightness, contrast, saturation);
+        if (ret < 0)
+            return ret;
+    }
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -1180,8 +1189,8 @@ sws_init_context()
 7.	ҪĻff_get_unscaled_swscale()ضתָ븳ֵSwsContextеswscaleָ롣
 8.	ҪĻff_getSwsFunc()ͨõswscale()ֵSwsContextеswscaleָ루طеƣȷʵģ
 */
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int context_init(SwsContext *c, SwsFilter *srcFilter,
+                                SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -2359,12 +2368,46 @@ void sws_freeFilter(SwsFilter *filter)
     av_free(filter);
 }
 
+#if !HAVE_THREADS
+int ff_sws_thread_init(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    return 0;
+}
+
+void ff_sws_thread_free(SwsContext *c)
+{
+}
+
+int ff_sws_thread_scale(SwsContext *c, const uint8_t *const src[],
+                        const int srcStride[], uint8_t *const dst[],
+                        const int dstStride[])
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    int ret;
+
+    if (c->nb_threads != 1) {
+        ret = ff_sws_thread_init(c, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+    }
+
+    return context_init(c, srcFilter, dstFilter);
+}
+
 void sws_freeContext(SwsContext *c)
 {
     int i;
     if (!c)
         return;
 
+    ff_sws_thread_free(c);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
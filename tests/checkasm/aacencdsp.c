@@ -0,0 +1,105 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavcodec/aacenc.h"
+
+#include "checkasm.h"
+
+#define BUF_SIZE 1024
+
+/* band sizes are multiples of 4, from 4 up to a whole long window */
+static const int sizes[] = { 4, 12, 32, 1024 };
+
+#define randomize_buffer(buf)                                          \
+    do {                                                               \
+        int i;                                                         \
+        for (i = 0; i < BUF_SIZE; i++)                                 \
+            buf[i] = (float)rnd() / (UINT_MAX >> 13) - 4096.0f;        \
+    } while (0)
+
+static void check_abs_pow34(AACEncContext *s)
+{
+    LOCAL_ALIGNED_32(float, in,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(float, out0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(float, out1, [BUF_SIZE]);
+    int i;
+
+    declare_func(void, float *out, const float *in, const int size);
+
+    randomize_buffer(in);
+    for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        if (check_func(s->abs_pow34, "abs_pow34_%d", sizes[i])) {
+            memset(out0, 0, BUF_SIZE * sizeof(*out0));
+            memset(out1, 0, BUF_SIZE * sizeof(*out1));
+            call_ref(out0, in, sizes[i]);
+            call_new(out1, in, sizes[i]);
+            if (memcmp(out0, out1, BUF_SIZE * sizeof(*out0)))
+                fail();
+            bench_new(out1, in, sizes[i]);
+        }
+    }
+    report("abs_pow34");
+}
+
+static void check_quant_bands(AACEncContext *s)
+{
+    LOCAL_ALIGNED_32(float, in,     [BUF_SIZE]);
+    LOCAL_ALIGNED_32(float, scaled, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int,   out0,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int,   out1,   [BUF_SIZE]);
+    const float Q34 = 0.75f, rounding = 0.4054f;
+    int i, is_signed;
+
+    declare_func(void, int *out, const float *in, const float *scaled,
+                 int size, int is_signed, int maxval, const float Q34,
+                 const float rounding);
+
+    randomize_buffer(in);
+    for (i = 0; i < BUF_SIZE; i++)
+        scaled[i] = FFABS(in[i]) * 4;
+    for (is_signed = 0; is_signed < 2; is_signed++) {
+        for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+            if (check_func(s->quant_bands, "quant_bands_%s_%d",
+                           is_signed ? "signed" : "unsigned", sizes[i])) {
+                memset(out0, 0, BUF_SIZE * sizeof(*out0));
+                memset(out1, 0, BUF_SIZE * sizeof(*out1));
+                call_ref(out0, in, scaled, sizes[i], is_signed, 8191, Q34, rounding);
+                call_new(out1, in, scaled, sizes[i], is_signed, 8191, Q34, rounding);
+                if (memcmp(out0, out1, BUF_SIZE * sizeof(*out0)))
+                    fail();
+                bench_new(out1, in, scaled, sizes[i], is_signed, 8191, Q34, rounding);
+            }
+        }
+    }
+    report("quant_bands");
+}
+
+void checkasm_check_aacencdsp(void)
+{
+    static AACEncContext s;
+
+    ff_aac_dsp_init(&s);
+
+    check_abs_pow34(&s);
+    check_quant_bands(&s);
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "libavcodec/lossless_videoencdsp.h"
+
+#include "checkasm.h"
+
+#define MAX_WIDTH 4096
+
+#define randomize_buffers(buf, size)     \
+    do {                                 \
+        int j;                           \
+        for (j = 0; j < size; j++)       \
+            buf[j] = rnd() & 0xFF;       \
+    } while (0)
+
+static void check_sum_abs_int8(LLVidEncDSPContext *c)
+{
+    /* PNG rows are preceded by the filter type byte */
+    static const int widths[] = { 1, 15, 16, 3 * 1280 + 1, MAX_WIDTH };
+    uint8_t *src = av_malloc(MAX_WIDTH + 1);
+    int i;
+
+    declare_func(int, const uint8_t *src, intptr_t w);
+
+    if (!src) {
+        fail();
+        return;
+    }
+
+    randomize_buffers(src, MAX_WIDTH + 1);
+    /* the extremes */
+    src[0] = 0x80;
+    src[1] = 0x7f;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+        if (check_func(c->sum_abs_int8, "sum_abs_int8_%d", widths[i])) {
+            /* unaligned, like the rows of the PNG encoder */
+            if (call_ref(src + 1, widths[i]) != call_new(src + 1, widths[i]) ||
+                call_ref(src,     widths[i]) != call_new(src,     widths[i]))
+                fail();
+            bench_new(src + 1, widths[i]);
+        }
+    }
+
+    av_free(src);
+}
+
+void checkasm_check_llvidencdsp(void)
+{
+    LLVidEncDSPContext c;
+
+    ff_llvidencdsp_init(&c);
+
+    check_sum_abs_int8(&c);
+
+    report("sum_abs_int8");
+}
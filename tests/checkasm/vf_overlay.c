@@ -0,0 +1,117 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+#define WIDTH 256
+#define BUF_SIZE (WIDTH * 4)
+
+#define randomize_buffers(buf, size)          \
+    do {                                      \
+        int j;                                \
+        for (j = 0; j < size; j += 4)         \
+            AV_WN32A(buf + j, rnd());         \
+    } while (0)
+
+static const char *const format_names[] = { "yuv420", "yuv422", "yuv444", "rgb", "gbrp" };
+
+/**
+ * @param bpp bytes per pixel of the main and overlay rows
+ */
+static void check_blend_row(OverlayBlendRowFunc func, const char *name, int bpp)
+{
+    LOCAL_ALIGNED_32(uint8_t, orig,  [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0,  [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1,  [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, src,   [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, alpha, [BUF_SIZE * 2]);
+    /* odd widths and unaligned pointers, like in the middle of a picture */
+    static const int widths[] = { 1, 7, 33, WIDTH - 3 };
+    int i, j;
+
+    declare_func(int, uint8_t *d, const uint8_t *s, const uint8_t *a,
+                 int w, ptrdiff_t alinesize);
+
+    if (!check_func(func, "overlay_%s", name))
+        return;
+
+    randomize_buffers(src,   BUF_SIZE);
+    randomize_buffers(alpha, BUF_SIZE * 2);
+    /* the extremes of alpha, which the per-pixel code handles apart, in the
+     * alpha plane and in the first and last byte of the packed pixels */
+    for (i = 0; i < 16; i++)
+        alpha[2 + i] = src[1 + 4 * i] = src[4 + 4 * i] = i & 1 ? 0xff : 0;
+    for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+        int n0, n1;
+
+        randomize_buffers(orig, BUF_SIZE);
+        memcpy(dst0, orig, BUF_SIZE);
+        memcpy(dst1, orig, BUF_SIZE);
+        n0 = call_ref(dst0 + 1, src + 1, alpha + 2, widths[i], BUF_SIZE);
+        n1 = call_new(dst1 + 1, src + 1, alpha + 2, widths[i], BUF_SIZE);
+        /* the optimized versions may leave the end of the row to the caller */
+        if (n1 < 0 || n1 > n0) {
+            fail();
+            continue;
+        }
+        for (j = 0; j < BUF_SIZE; j++) {
+            if (dst1[j] != (j < 1 + n1 * bpp ? dst0[j] : orig[j])) {
+                fail();
+                break;
+            }
+        }
+    }
+    bench_new(dst1, src, alpha, WIDTH - 32, BUF_SIZE);
+}
+
+void checkasm_check_overlay(void)
+{
+    static const int alpha_formats[] = { OVERLAY_ALPHA_STRAIGHT, OVERLAY_ALPHA_PREMULTIPLIED };
+    int format, i, plane;
+
+    for (format = 0; format < OVERLAY_FORMAT_NB; format++) {
+        for (i = 0; i < FF_ARRAY_ELEMS(alpha_formats); i++) {
+            const char *mode = alpha_formats[i] == OVERLAY_ALPHA_PREMULTIPLIED ?
+                               "premul" : "straight";
+            OverlayDSPContext dsp;
+            char name[32];
+
+            if (format == OVERLAY_FORMAT_RGB) {
+                /* only premultiplied alpha for the argb and rgba layouts */
+                ff_overlay_init(&dsp, format, alpha_formats[i], 1, 0);
+                if (dsp.blend_row[0])
+                    check_blend_row(dsp.blend_row[0], "argb_premul", 4);
+                ff_overlay_init(&dsp, format, alpha_formats[i], 1, 3);
+                if (dsp.blend_row[0])
+                    check_blend_row(dsp.blend_row[0], "rgba_premul", 4);
+                continue;
+            }
+            ff_overlay_init(&dsp, format, alpha_formats[i], 0, -1);
+            for (plane = 0; plane < 2; plane++) {
+                snprintf(name, sizeof(name), "%s_%s_%d", format_names[format], mode, plane);
+                check_blend_row(dsp.blend_row[plane], name, 1);
+            }
+        }
+    }
+    report("blend_row");
+}
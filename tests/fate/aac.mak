@@ -257,9 +257,26 @@ $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS) += $(FATE_AAC_ENCODE)
 
+# 5.1 encoded with slice threads, the output is the same as with one thread
+FATE_AAC_ENCODE_THREADS += fate-aac-5.1-encode
+fate-aac-5.1-encode: OPTS = -b:a 384k
+fate-aac-5.1-encode: REF = bdb21b9e4fd5f13a2d2b544f81fcfac3
+
+FATE_AAC_ENCODE_THREADS += fate-aac-5.1-q-encode
+fate-aac-5.1-q-encode: OPTS = -q:a 2
+fate-aac-5.1-q-encode: REF = fa50838da081d1a96d9c5a6c270bc15e
+
+$(FATE_AAC_ENCODE_THREADS): tests/data/asynth-44100-2.wav
+$(FATE_AAC_ENCODE_THREADS): SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+$(FATE_AAC_ENCODE_THREADS): CMD = md5 -i $(SRC) -ss 1 -i $(SRC) -ss 2 -i $(SRC) -filter_complex amerge=inputs=3 -channel_layout 5.1 -threads 3 -thread_type slice -c:a aac $(OPTS) -fflags +bitexact -flags +bitexact -f adts
+$(FATE_AAC_ENCODE_THREADS): CMP = oneline
+
+FATE_AAC_ENCODE_THREADS-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER AMERGE_FILTER AAC_ENCODER ADTS_MUXER MD5_PROTOCOL) += $(FATE_AAC_ENCODE_THREADS)
+
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes) $(FATE_AAC_ENCODE_THREADS-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
@@ -1,4 +1,5 @@
-FATE_CHECKASM = fate-checkasm-alacdsp                                   \
+FATE_CHECKASM = fate-checkasm-aacencdsp                                 \
+                fate-checkasm-alacdsp                                   \
                 fate-checkasm-audiodsp                                  \
                 fate-checkasm-blockdsp                                  \
                 fate-checkasm-bswapdsp                                  \
@@ -12,11 +13,13 @@ FATE_CHECKASM = fate-checkasm-alacdsp                                   \
                 fate-checkasm-hevc_idct                                 \
                 fate-checkasm-jpeg2000dsp                               \
                 fate-checkasm-llviddsp                                  \
+                fate-checkasm-llvidencdsp                               \
                 fate-checkasm-pixblockdsp                               \
                 fate-checkasm-synth_filter                              \
                 fate-checkasm-v210enc                                   \
                 fate-checkasm-vf_blend                                  \
                 fate-checkasm-vf_colorspace                             \
+                fate-checkasm-vf_overlay                                \
                 fate-checkasm-videodsp                                  \
                 fate-checkasm-vp8dsp                                    \
                 fate-checkasm-vp9dsp                                    \
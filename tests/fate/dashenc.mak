@@ -0,0 +1,20 @@
+# segments of 2 seconds written in chunks of 0.5 seconds
+tests/data/dash-streaming.mpd: TAG = GEN
+tests/data/dash-streaming.mpd: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t)::d=6" -map 0 -flags +bitexact -codec:a mp2fixed \
+        -f dash -streaming 1 -frag_duration 500000 -min_seg_duration 2000000 -use_timeline 0 \
+        -init_seg_name dash-streaming-init.m4s -media_seg_name 'dash-streaming-$$Number$$.m4s' \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_DASHENC-$(call ALLYES, DASH_MUXER MP4_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-dashenc-streaming-mpd
+fate-dashenc-streaming-mpd: tests/data/dash-streaming.mpd
+fate-dashenc-streaming-mpd: CMD = cat $(TARGET_PATH)/tests/data/dash-streaming.mpd
+
+# the timestamps run on across the chunks and segments
+FATE_DASHENC-$(call ALLYES, DASH_MUXER MP4_MUXER MOV_DEMUXER CONCAT_PROTOCOL AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-dashenc-streaming
+fate-dashenc-streaming: tests/data/dash-streaming.mpd
+fate-dashenc-streaming: CMD = framecrc -flags +bitexact -i "concat:$(TARGET_PATH)/tests/data/dash-streaming-init.m4s|$(TARGET_PATH)/tests/data/dash-streaming-1.m4s|$(TARGET_PATH)/tests/data/dash-streaming-2.m4s|$(TARGET_PATH)/tests/data/dash-streaming-3.m4s" -c copy
+
+FATE_FFMPEG += $(FATE_DASHENC-yes)
+fate-dashenc: $(FATE_DASHENC-yes)
@@ -25,6 +25,17 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -idct simple -fflags +bitexact -flag
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+FATE_FFMPEG-$(call ALLYES, COLOR_FILTER SPLIT_FILTER SINE_FILTER) += fate-ffmpeg-enc_threads
+fate-ffmpeg-enc_threads: CMD = framecrc -filter_complex "color=s=64x48:d=1:r=25,split[v0][v1];sine=d=1[a]" -map "[v0]" -map "[v1]" -map "[a]" -enc_thread_queue_size 2 -fflags +bitexact
+
+FATE_FFMPEG-$(call ALLYES, IMAGE2_DEMUXER PGMYUV_DECODER FRAMEPACK_FILTER) += fate-ffmpeg-dec_threads
+fate-ffmpeg-dec_threads: $(VREF)
+fate-ffmpeg-dec_threads: CMD = framecrc -dec_thread_queue_size 2 -c:v pgmyuv -i $(TARGET_PATH)/tests/vsynth1/%02d.pgm -dec_thread_queue_size 2 -c:v pgmyuv -i $(TARGET_PATH)/tests/vsynth1/%02d.pgm -filter_complex framepack=sbs -frames 15
+
+FATE_FFMPEG-$(call ALLYES, IMAGE2_DEMUXER PGMYUV_DECODER SCALE_FILTER) += fate-ffmpeg-dec_threads-simple
+fate-ffmpeg-dec_threads-simple: $(VREF)
+fate-ffmpeg-dec_threads-simple: CMD = framecrc -dec_thread_queue_size 2 -c:v pgmyuv -i $(TARGET_PATH)/tests/vsynth1/%02d.pgm -vf scale=88:72 -frames 15
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -204,6 +204,44 @@ FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_F
 fate-filter-overlay_yuv444: tests/data/filtergraphs/overlay_yuv444
 fate-filter-overlay_yuv444: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv444
 
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER FORMAT_FILTER LUTYUV_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuva420
+fate-filter-overlay_yuva420: tests/data/filtergraphs/overlay_yuva420
+fate-filter-overlay_yuva420: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuva420
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER FORMAT_FILTER PREMULTIPLY_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_premultiplied
+fate-filter-overlay_premultiplied: tests/data/filtergraphs/overlay_premultiplied
+fate-filter-overlay_premultiplied: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_premultiplied
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuv420-threads
+fate-filter-overlay_yuv420-threads: tests/data/filtergraphs/overlay_yuv420
+fate-filter-overlay_yuv420-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv420 -filter_complex_threads 4
+fate-filter-overlay_yuv420-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_yuv420
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_FILTER) += fate-filter-overlay_rgb-threads
+fate-filter-overlay_rgb-threads: tests/data/filtergraphs/overlay_rgb
+fate-filter-overlay_rgb-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_rgb -filter_complex_threads 4
+fate-filter-overlay_rgb-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_rgb
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER FORMAT_FILTER LUTYUV_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuva420-threads
+fate-filter-overlay_yuva420-threads: tests/data/filtergraphs/overlay_yuva420
+fate-filter-overlay_yuva420-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuva420 -filter_complex_threads 4
+fate-filter-overlay_yuva420-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_yuva420
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER FORMAT_FILTER PREMULTIPLY_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_premultiplied-threads
+fate-filter-overlay_premultiplied-threads: tests/data/filtergraphs/overlay_premultiplied
+fate-filter-overlay_premultiplied-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_premultiplied -filter_complex_threads 4
+fate-filter-overlay_premultiplied-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_premultiplied
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuv420-parallel
+fate-filter-overlay_yuv420-parallel: tests/data/filtergraphs/overlay_yuv420
+fate-filter-overlay_yuv420-parallel: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv420 -filter_complex_threads 4 -filter_complex_parallel
+fate-filter-overlay_yuv420-parallel: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_yuv420
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_FILTER) += fate-filter-overlay_rgb-parallel
+fate-filter-overlay_rgb-parallel: tests/data/filtergraphs/overlay_rgb
+fate-filter-overlay_rgb-parallel: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_rgb -filter_complex_threads 4 -filter_complex_parallel
+fate-filter-overlay_rgb-parallel: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_rgb
+
 FATE_FILTER_VSYNTH-$(CONFIG_PHASE_FILTER) += fate-filter-phase
 fate-filter-phase: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf phase
 
@@ -413,6 +451,12 @@ fate-filter-scale200: CMD = video_filter "scale=w=200:h=200"
 FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale500
 fate-filter-scale500: CMD = video_filter "scale=w=500:h=500"
 
+FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale200-threads
+fate-filter-scale200-threads: CMD = video_filter "scale=w=200:h=200" -filter_threads 4
+
+FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scale500-threads
+fate-filter-scale500-threads: CMD = video_filter "scale=w=500:h=500" -filter_threads 4
+
 FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_v_chr_pos=33:out_h_chr_pos=151
@@ -447,6 +491,9 @@ fate-filter-idet: CMD = framecrc -flags bitexact -idct simple -i $(SRC) -vf idet
 FATE_FILTER_VSYNTH-$(CONFIG_PAD_FILTER) += fate-filter-pad
 fate-filter-pad: CMD = video_filter "pad=iw*1.5:ih*1.5:iw*0.3:ih*0.2"
 
+FATE_FILTER_VSYNTH-$(CONFIG_PAD_FILTER) += fate-filter-pad-inplace
+fate-filter-pad-inplace: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf pad=iw:ih+64:0:24:red
+
 FATE_FILTER_PP = fate-filter-pp fate-filter-pp1 fate-filter-pp2 fate-filter-pp3 fate-filter-pp4 fate-filter-pp5 fate-filter-pp6
 FATE_FILTER_VSYNTH-$(CONFIG_PP_FILTER) += $(FATE_FILTER_PP)
 $(FATE_FILTER_PP): fate-vsynth1-mpeg4-qprd
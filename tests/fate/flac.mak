@@ -28,5 +28,20 @@ fate-flac-%: FUZZ = 0
 
 FATE_FLAC-$(call ENCMUX, FLAC, FLAC) += $(FATE_FLAC)
 
+# 6 channels encoded with slice threads, the output is the same as with one thread
+FATE_FLACENC_THREADS = $(foreach L,0 5 8 12,fate-flacenc-threads-$(L))
+
+fate-flacenc-threads-%: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-flacenc-threads-%: CMD = md5 -i $(SRC) -ss 1 -i $(SRC) -ss 2 -i $(SRC) -filter_complex amerge=inputs=3 -threads 3 -thread_type slice -compression_level $(@:fate-flacenc-threads-%=%) -c:a flac -flags +bitexact -fflags +bitexact -f flac
+fate-flacenc-threads-%: CMP = oneline
+fate-flacenc-threads-0:  REF = 39b314eb15a1534b460576cce2b9e58e
+fate-flacenc-threads-5:  REF = 9f79c9c4b304880d0883af6fda8e873c
+fate-flacenc-threads-8:  REF = 73fad1737318f107905101e19342b7ec
+fate-flacenc-threads-12: REF = 383f44041a4857ae25f0e194c784aebd
+$(FATE_FLACENC_THREADS): tests/data/asynth-44100-2.wav
+
+FATE_FLACENC-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER AMERGE_FILTER FLAC_ENCODER FLAC_MUXER MD5_PROTOCOL) += $(FATE_FLACENC_THREADS)
+
 FATE_SAMPLES_AVCONV += $(FATE_FLAC-yes)
-fate-flac: $(FATE_FLAC)
+FATE_FFMPEG += $(FATE_FLACENC-yes)
+fate-flac: $(FATE_FLAC) $(FATE_FLACENC-yes)
@@ -222,6 +222,15 @@ $(foreach N,$(HEVC_SAMPLES_422_10BIN),$(eval $(call FATE_HEVC_TEST_422_10BIN,$(N
 $(foreach N,$(HEVC_SAMPLES_444_8BIT),$(eval $(call FATE_HEVC_TEST_444_8BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_444_12BIT),$(eval $(call FATE_HEVC_TEST_444_12BIT,$(N))))
 
+# frame threading with the CTB rows of each frame decoded in parallel
+define FATE_HEVC_WPP_THREADS_TEST
+FATE_HEVC += fate-hevc-wpp-threads-$(1)
+fate-hevc-wpp-threads-$(1): CMD = framecrc -flags unaligned -vsync drop -threads 3 -thread_type frame -wpp_threads 3 -i $(TARGET_SAMPLES)/hevc-conformance/WPP_$(1)_ericsson_MAIN_2.bit
+fate-hevc-wpp-threads-$(1): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-WPP_$(1)_ericsson_MAIN_2
+endef
+
+$(foreach N,A B C D E F,$(eval $(call FATE_HEVC_WPP_THREADS_TEST,$(N))))
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync 0 -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC += fate-hevc-paramchange-yuv420p-yuv420p10
 
@@ -0,0 +1,6 @@
+# every update of the playlist is written to the output, showing the parts
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MPEGTS_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER PIPE_PROTOCOL) += fate-hlsenc-parts
+fate-hlsenc-parts: CMD = ffmpeg -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t)::d=2" -map 0 -flags +bitexact -codec:a mp2fixed -f hls -hls_time 1 -hls_part_time 0.25 -hls_segment_filename $(TARGET_PATH)/tests/data/hls-parts-%03d.ts -y pipe:
+
+FATE_FFMPEG += $(FATE_HLSENC-yes)
+fate-hlsenc: $(FATE_HLSENC-yes)
@@ -310,6 +310,19 @@ FATE_PNG-$(call DEMDEC, IMAGE2, PNG) += $(FATE_PNG)
 FATE_IMAGE += $(FATE_PNG-yes)
 fate-png: $(FATE_PNG-yes)
 
+# rows split in slices and encoded with slice threads, the output is the same with one thread
+FATE_PNGENC_SLICES = $(foreach N,1 3,fate-pngenc-slices-$(N))
+
+fate-pngenc-slices-%: SRC = $(TARGET_PATH)/tests/data/vsynth1.yuv
+fate-pngenc-slices-%: CMD = md5 -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(SRC) -frames 5 -threads $(@:fate-pngenc-slices-%=%) -thread_type slice -pix_fmt rgb24 -c:v png -pred mixed -slices 4 -flags +bitexact -f image2pipe
+fate-pngenc-slices-%: CMP = oneline
+fate-pngenc-slices-%: REF = ff940a22950599d06a52aa61ea870723
+$(FATE_PNGENC_SLICES): tests/data/vsynth1.yuv
+
+FATE_PNGENC-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER SCALE_FILTER PNG_ENCODER IMAGE2PIPE_MUXER MD5_PROTOCOL) += $(FATE_PNGENC_SLICES)
+FATE_FFMPEG += $(FATE_PNGENC-yes)
+fate-pngenc: $(FATE_PNGENC-yes)
+
 FATE_IMAGE-$(call DEMDEC, IMAGE2, PTX) += fate-ptx
 fate-ptx: CMD = framecrc -i $(TARGET_SAMPLES)/ptx/_113kw_pic.ptx -pix_fmt rgb24
 
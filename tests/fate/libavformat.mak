@@ -6,6 +6,11 @@ FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy
 
+# no receiver, but the datagrams go through the paced and batched sender
+FATE_LIBAVFORMAT-$(call ALLYES, UDP_PROTOCOL PIPE_PROTOCOL TEE_MUXER MPEGTS_MUXER FRAMECRC_MUXER SINE_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-udp-batch
+fate-udp-batch: CMD = ffmpeg -f lavfi -i sine=d=2 -flags +bitexact -fflags +bitexact -codec:a mp2fixed -map 0 \
+        -f tee "[f=mpegts]udp://127.0.0.1:5678?pkt_size=1316&batch_size=8&bitrate=2000000|[f=framecrc]pipe:"
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh
@@ -0,0 +1,23 @@
+# a multiplex of 3 programs, the first one with 2 streams
+tests/data/mpegts-programs.ts: TAG = GEN
+tests/data/mpegts-programs.ts: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "sine=d=2" -f lavfi -i "sine=f=880:d=2" -map 0 -map 1 -map 0 -map 1 \
+        -flags +bitexact -fflags +bitexact -codec:a mp2fixed \
+        -program title=A:st=0:st=1 -program title=B:st=2 -program title=C:st=3 \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MPEGTS_PROGRAMS = fate-mpegts-programs-all   \
+                       fate-mpegts-programs-first \
+                       fate-mpegts-programs-last  \
+
+# the packets of the programs that are not mapped are skipped by the demuxer
+fate-mpegts-programs-all:   CMD = framecrc -i $(TARGET_PATH)/tests/data/mpegts-programs.ts -map 0 -c copy
+fate-mpegts-programs-first: CMD = framecrc -i $(TARGET_PATH)/tests/data/mpegts-programs.ts -map 0:p:1 -c copy
+fate-mpegts-programs-last:  CMD = framecrc -i $(TARGET_PATH)/tests/data/mpegts-programs.ts -map 0:p:3 -c copy
+$(FATE_MPEGTS_PROGRAMS): tests/data/mpegts-programs.ts
+
+FATE_MPEGTS-$(call ALLYES, SINE_FILTER LAVFI_INDEV MP2FIXED_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER FRAMECRC_MUXER) += $(FATE_MPEGTS_PROGRAMS)
+
+FATE_FFMPEG += $(FATE_MPEGTS-yes)
+fate-mpegts: $(FATE_MPEGTS-yes)
@@ -254,12 +254,27 @@ fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_
 
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# generated files
 
-$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
+# long enough for the generic index to span many blocks of the packed index
+tests/data/packedindex.ac3: TAG = GEN
+tests/data/packedindex.ac3: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+        -f lavfi -i "aevalsrc=sin(2*PI*(440+4*t)*t)::d=30" -flags +bitexact -fflags +bitexact \
+        -codec:a ac3_fixed -b:a 64k -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_SEEK_DATA-$(call ALLYES, AEVALSRC_FILTER LAVFI_INDEV AC3_FIXED_ENCODER AC3_MUXER AC3_DEMUXER AC3_DECODER) += fate-seek-packedindex-ac3
+fate-seek-packedindex-ac3: tests/data/packedindex.ac3
+fate-seek-packedindex-ac3: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/packedindex.ac3 -duration 30
+
+FATE_SEEK_DATA += $(FATE_SEEK_DATA-yes)
+
+
+$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_DATA): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_DATA)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_DATA)
@@ -317,6 +317,21 @@ fate-vsynth%-mpeg4-thread:       ENCOPTS = -b 500k -flags +mv4+aic         \
                                            -mbd bits -ps 200 -bf 2         \
                                            -threads 2 -slices 2
 
+# hierarchical motion estimation pre-pass, on the generated sequences
+FATE_ME_PYRAMID-$(call ENCDEC, MPEG2VIDEO, MPEG2VIDEO MPEGVIDEO) += mpeg2-pyramid mpeg2-ilace-pyramid
+FATE_ME_PYRAMID-$(call ENCDEC, MPEG4, AVI) += mpeg4-pyramid mpeg4-pyramid-thread
+FATE_ME_PYRAMID-$(call ENCDEC, H263, AVI)  += h263-pyramid
+
+fate-vsynth%-mpeg2-pyramid fate-vsynth%-mpeg2-ilace-pyramid: FMT   = mpeg2video
+fate-vsynth%-mpeg2-pyramid fate-vsynth%-mpeg2-ilace-pyramid: CODEC = mpeg2video
+
+fate-vsynth%-mpeg2-pyramid:        ENCOPTS = -qscale 10 -me_pyramid 3
+fate-vsynth%-mpeg2-ilace-pyramid:  ENCOPTS = -qscale 10 -flags +ildct+ilme -me_pyramid 2
+fate-vsynth%-mpeg4-pyramid:        ENCOPTS = -qscale 10 -flags +mv4 -me_pyramid 3
+fate-vsynth%-mpeg4-pyramid-thread: ENCOPTS = -qscale 10 -flags +mv4 -me_pyramid 3 \
+                                             -threads 3 -slices 3
+fate-vsynth%-h263-pyramid:         ENCOPTS = -qscale 10 -me_pyramid 1
+
 FATE_VCODEC-$(call ENCDEC, MSMPEG4V3, AVI) += msmpeg4
 fate-vsynth%-msmpeg4:            ENCOPTS = -qscale 10
 
@@ -429,6 +444,8 @@ FATE_VCODEC-$(call ENCDEC, ZLIB, AVI) += zlib
 FATE_VCODEC += $(FATE_VCODEC-yes)
 FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
+FATE_VSYNTH1 += $(FATE_ME_PYRAMID-yes:%=fate-vsynth1-%)
+FATE_VSYNTH2 += $(FATE_ME_PYRAMID-yes:%=fate-vsynth2-%)
 FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
 # Redundant tests because they just resize the input
 RESIZE_OFF   = dnxhd-720p dnxhd-720p-rd dnxhd-720p-10bit dnxhd-1080i \
@@ -151,6 +151,7 @@ $(eval $(call FATE_VP9_SUITE,parallelmode-akiyo))
 $(eval $(call FATE_VP9_SUITE,segmentation-aq-akiyo))
 $(eval $(call FATE_VP9_SUITE,segmentation-sf-akiyo))
 $(eval $(call FATE_VP9_SUITE,tiling-pedestrian))
+$(eval $(call FATE_VP9_SUITE,tiling-pedestrian,-slice,-thread_type slice -threads 3))
 $(eval $(call FATE_VP9_SUITE,trac3849))
 $(eval $(call FATE_VP9_SUITE,trac4359))
 endef
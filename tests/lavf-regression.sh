@@ -38,6 +38,26 @@ do_lavf_timecode()
     do_lavf $1 "" "$2"
 }
 
+do_lavf_mmap()
+{
+    do_lavf $1 "" "$2"
+    do_avconv_crc $file $DEC_OPTS -mmap 1 -i $target_path/$file
+}
+
+do_lavf_index_cache()
+{
+    do_lavf $1 "" "$2"
+    rm -f $target_path/$file.idx
+    do_avconv_crc $file $DEC_OPTS -index_cache $target_path/$file.idx -i $target_path/$file
+    do_avconv_crc $file $DEC_OPTS -index_cache $target_path/$file.idx -i $target_path/$file
+    do_avconv_crc $file $DEC_OPTS -index_cache $target_path/$file.idx -lazy_index 1 -i $target_path/$file
+    # change the sample count of the first track, the cache is rebuilt
+    printf '\377' | dd of=$target_path/$file.idx bs=1 seek=72 conv=notrunc 2>/dev/null
+    do_avconv_crc $file $DEC_OPTS -index_cache $target_path/$file.idx -lazy_index 1 -i $target_path/$file
+    do_avconv_crc $file $DEC_OPTS -index_cache $target_path/$file.idx -i $target_path/$file
+    rm -f $target_path/$file.idx
+}
+
 do_streamed_images()
 {
     file=${outfile}${1}pipe.$1
@@ -120,9 +140,14 @@ fi
 
 if [ -n "$do_mov" ] ; then
 mov_common_opt="-acodec pcm_alaw -vcodec mpeg4 -threads 1"
+do_lavf_mmap mov "-acodec pcm_s16le -vcodec rawvideo -pix_fmt uyvy422"
+do_lavf_index_cache mov "-bf 2 $mov_common_opt"
 do_lavf mov "" "-movflags +rtphint $mov_common_opt"
 do_lavf_timecode mov "-movflags +faststart $mov_common_opt"
+do_lavf mov "" "-movflags +faststart -async_write_size 4096 $mov_common_opt"
 do_lavf_timecode mp4 "-vcodec mpeg4 -an -threads 1"
+do_lavf mp4 "" "-movflags +faststart -expected_duration 1 -vcodec mpeg4 -an -threads 1"
+do_lavf mp4 "" "-movflags +faststart -moov_size 100 -vcodec mpeg4 -an -threads 1"
 fi
 
 if [ -n "$do_ismv" ] ; then
@@ -150,6 +175,7 @@ do_audio_only mka "" "-c:a tta"
 fi
 
 if [ -n "$do_mkv" ] ; then
+do_lavf_mmap mkv "-acodec pcm_s16le -vcodec rawvideo"
 do_lavf mkv "" "-acodec mp2 -ab 64k -vcodec mpeg4 \
  -attach ${raw_src%/*}/00.pgm -metadata:s:t mimetype=image/x-portable-greymap -threads 1"
 do_lavf mkv "" "-acodec mp2 -ab 64k -vcodec mpeg4 -ar 44100 -threads 1"